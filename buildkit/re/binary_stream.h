@@ -0,0 +1,222 @@
+/**
+ * @file re/binary_stream.h
+ * @brief Binary serialization helpers for on-disk caches
+ */
+
+#pragma once
+#include <re/fs.h>
+
+#include <ulib/yaml.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace re
+{
+    enum class BinaryYamlTag : std::uint8_t
+    {
+        Null,
+        Scalar,
+        Sequence,
+        Map
+    };
+
+    /**
+     * @brief Serializes plain values and YAML trees into a compact native-endian binary buffer.
+     *
+     * Only meant for caches which are thrown away whenever their format or the Re build changes.
+     */
+    class BinaryWriter
+    {
+    public:
+        void WriteRaw(const void *data, std::size_t size)
+        {
+            mData.append(static_cast<const char *>(data), size);
+        }
+
+        void WriteU8(std::uint8_t value)
+        {
+            WriteRaw(&value, sizeof value);
+        }
+
+        void WriteU64(std::uint64_t value)
+        {
+            WriteRaw(&value, sizeof value);
+        }
+
+        void WriteTag(BinaryYamlTag tag)
+        {
+            WriteU8(static_cast<std::uint8_t>(tag));
+        }
+
+        template <class S>
+        void WriteString(const S &value)
+        {
+            std::string str(value);
+
+            WriteU64(str.size());
+            WriteRaw(str.data(), str.size());
+        }
+
+        void WritePath(const fs::path &path)
+        {
+            WriteString(path.u8string());
+        }
+
+        void WriteYaml(const ulib::yaml &node)
+        {
+            switch (node.type())
+            {
+            case ulib::yaml::value_t::map: {
+                std::uint64_t count = 0;
+
+                for ([[maybe_unused]] const auto &kv : node.items())
+                    count++;
+
+                WriteTag(BinaryYamlTag::Map);
+                WriteU64(count);
+
+                for (const auto &kv : node.items())
+                {
+                    WriteString(kv.name());
+                    WriteYaml(kv.value());
+                }
+                break;
+            }
+            case ulib::yaml::value_t::sequence:
+                WriteTag(BinaryYamlTag::Sequence);
+                WriteU64(node.size());
+
+                for (std::size_t i = 0; i != node.size(); ++i)
+                    WriteYaml(node[i]);
+                break;
+            default:
+                if (node.is_null())
+                    WriteTag(BinaryYamlTag::Null);
+                else
+                {
+                    WriteTag(BinaryYamlTag::Scalar);
+                    WriteString(node.scalar());
+                }
+                break;
+            }
+        }
+
+        const std::string &GetData() const
+        {
+            return mData;
+        }
+
+    private:
+        std::string mData;
+    };
+
+    /**
+     * @brief Reads data written by BinaryWriter, throwing std::runtime_error on truncated or malformed input.
+     */
+    class BinaryReader
+    {
+    public:
+        /**
+         * @brief Construct a new BinaryReader object.
+         *
+         * @param data The data to read
+         * @param what What the data is, used in error messages
+         */
+        BinaryReader(std::string_view data, std::string_view what) : mData{data}, mWhat{what}
+        {
+        }
+
+        void ReadRaw(void *out, std::size_t size)
+        {
+            if (mData.size() - mOffset < size)
+                throw std::runtime_error("truncated " + mWhat);
+
+            std::memcpy(out, mData.data() + mOffset, size);
+            mOffset += size;
+        }
+
+        std::uint8_t ReadU8()
+        {
+            std::uint8_t value;
+            ReadRaw(&value, sizeof value);
+            return value;
+        }
+
+        std::uint64_t ReadU64()
+        {
+            std::uint64_t value;
+            ReadRaw(&value, sizeof value);
+            return value;
+        }
+
+        std::string_view ReadView(std::size_t size)
+        {
+            if (mData.size() - mOffset < size)
+                throw std::runtime_error("truncated " + mWhat);
+
+            auto result = mData.substr(mOffset, size);
+            mOffset += size;
+
+            return result;
+        }
+
+        std::string ReadString()
+        {
+            return std::string{ReadView(ReadU64())};
+        }
+
+        fs::path ReadPath()
+        {
+            return fs::u8path(ReadString());
+        }
+
+        ulib::yaml ReadYaml()
+        {
+            switch (static_cast<BinaryYamlTag>(ReadU8()))
+            {
+            case BinaryYamlTag::Null:
+                return ulib::yaml{ulib::yaml::value_t::null};
+            case BinaryYamlTag::Scalar: {
+                ulib::yaml node{ulib::yaml::value_t::null};
+                node = ReadString();
+                return node;
+            }
+            case BinaryYamlTag::Sequence: {
+                ulib::yaml node{ulib::yaml::value_t::sequence};
+
+                for (auto count = ReadU64(); count > 0; count--)
+                    node.push_back(ReadYaml());
+
+                return node;
+            }
+            case BinaryYamlTag::Map: {
+                ulib::yaml node{ulib::yaml::value_t::map};
+
+                for (auto count = ReadU64(); count > 0; count--)
+                {
+                    auto key = ReadString();
+                    node[key.c_str()] = ReadYaml();
+                }
+
+                return node;
+            }
+            default:
+                throw std::runtime_error("invalid YAML node in " + mWhat);
+            }
+        }
+
+        bool IsAtEnd() const
+        {
+            return mOffset == mData.size();
+        }
+
+    private:
+        std::string_view mData;
+        std::string mWhat;
+        std::size_t mOffset = 0;
+    };
+} // namespace re
@@ -0,0 +1,342 @@
+#include "build_watcher.h"
+
+#include <fmt/color.h>
+
+#include <csignal>
+
+#if !defined(WIN32)
+#include <pthread.h>
+#endif
+
+namespace re
+{
+    namespace
+    {
+        constexpr auto kEventPollTimeout = std::chrono::milliseconds{250};
+
+        std::atomic<bool> gQuitRequested{false};
+
+#if !defined(WIN32)
+        // Set right before the build thread is sent a SIGINT to cancel ninja, so that our own handler can tell a
+        // cancellation apart from the user pressing Ctrl+C.
+        std::atomic<bool> gCancelRequested{false};
+        pthread_t gBuildThread;
+
+        std::mutex gCancelMutex;
+
+        void OnWatchInterrupt(int)
+        {
+            if (gCancelRequested.exchange(false))
+                return;
+
+            gQuitRequested = true;
+        }
+#else
+        void OnWatchInterrupt(int)
+        {
+            gQuitRequested = true;
+        }
+#endif
+
+        bool IsConfigFileName(const std::string &name)
+        {
+            constexpr std::string_view kPartitionSuffix = ".re.yml";
+
+            return name == Target::kTargetConfigFilename ||
+                   (name.size() > kPartitionSuffix.size() &&
+                    name.compare(name.size() - kPartitionSuffix.size(), kPartitionSuffix.size(), kPartitionSuffix) ==
+                        0);
+        }
+    } // namespace
+
+    BuildWatcher::BuildWatcher(IUserOutput *pOut, const fs::path &root_path, ContextLoader loader)
+        : mOut{pOut}, mRootPath{fs::canonical(root_path)}, mLoader{std::move(loader)}
+    {
+    }
+
+    BuildWatcher::~BuildWatcher()
+    {
+        mStopping = true;
+
+        if (mEventThread.joinable())
+            mEventThread.join();
+    }
+
+    int BuildWatcher::Run()
+    {
+        const auto kInfoStyle = fmt::emphasis::bold | fg(fmt::color::aquamarine);
+        const auto kErrorStyle = fmt::emphasis::bold | fg(fmt::color::crimson);
+
+        auto working_dir = fs::current_path();
+
+#if !defined(WIN32)
+        gBuildThread = pthread_self();
+
+        struct sigaction action = {};
+        struct sigaction old_action = {};
+
+        action.sa_handler = OnWatchInterrupt;
+        sigemptyset(&action.sa_mask);
+
+        // Ninja installs its own SIGINT handler for the duration of a build and restores this one afterwards
+        sigaction(SIGINT, &action, &old_action);
+#else
+        auto old_handler = std::signal(SIGINT, OnWatchInterrupt);
+#endif
+
+        {
+            std::lock_guard lock{mWatcherMutex};
+            mFileWatcher.AddDirectory(mRootPath);
+        }
+
+        mEventThread = std::thread{&BuildWatcher::EventThreadMain, this};
+
+        std::unique_ptr<DefaultBuildContext> context;
+        NinjaBuildDesc desc;
+
+        auto action_to_take = WatchAction::Reload;
+
+        while (!gQuitRequested)
+        {
+            if (action_to_take == WatchAction::Reload)
+            {
+                desc = NinjaBuildDesc{};
+                context = nullptr;
+
+                try
+                {
+                    context = mLoader(desc);
+                    context->SetKeepNinjaState(true);
+                    context->SetCancellationFlag(&mBuildCancelled);
+
+                    WatchTargetTree(*desc.pRootTarget);
+                }
+                catch (const std::exception &e)
+                {
+                    mOut->Error(kErrorStyle, "\nerror: {}\n\n", e.what());
+                    context = nullptr;
+                }
+
+                fs::current_path(working_dir);
+            }
+
+            if (context)
+            {
+#if !defined(WIN32)
+                sigset_t sigint_set;
+                sigemptyset(&sigint_set);
+                sigaddset(&sigint_set, SIGINT);
+#endif
+
+                try
+                {
+                    mBuildCancelled = false;
+                    mBuilding = true;
+
+                    context->BuildTarget(desc);
+                }
+                catch (const std::exception &e)
+                {
+                    if (mBuildCancelled)
+                        mOut->Warn(fg(fmt::color::yellow), " - Build cancelled\n\n");
+                    else
+                        mOut->Error(kErrorStyle, "\nerror: {}\n\n", e.what());
+                }
+
+#if !defined(WIN32)
+                {
+                    // Nothing can send us a cancellation past this point. If one is still pending, our own handler
+                    // swallows it once SIGINT is unblocked; if ninja already handled it, forget about it.
+                    pthread_sigmask(SIG_BLOCK, &sigint_set, nullptr);
+
+                    {
+                        std::lock_guard lock{gCancelMutex};
+                        mBuilding = false;
+                    }
+
+                    sigset_t pending;
+                    sigpending(&pending);
+
+                    if (!sigismember(&pending, SIGINT))
+                        gCancelRequested = false;
+
+                    pthread_sigmask(SIG_UNBLOCK, &sigint_set, nullptr);
+                }
+#else
+                mBuilding = false;
+#endif
+
+                fs::current_path(working_dir);
+            }
+
+            if (gQuitRequested)
+                break;
+
+            mOut->Info(kInfoStyle, " - Watching for changes (press Ctrl+C to stop)...\n\n");
+            action_to_take = WaitForChanges();
+
+            if (action_to_take == WatchAction::Reload)
+                mOut->Info(kInfoStyle, " - Target configuration or file list changed, reloading\n\n");
+            else if (action_to_take == WatchAction::Rebuild)
+                mOut->Info(kInfoStyle, " - Sources changed, rebuilding\n\n");
+        }
+
+        mStopping = true;
+        mEventThread.join();
+
+#if !defined(WIN32)
+        sigaction(SIGINT, &old_action, nullptr);
+#else
+        std::signal(SIGINT, old_handler);
+#endif
+
+        return 0;
+    }
+
+    void BuildWatcher::EventThreadMain()
+    {
+        while (!mStopping)
+        {
+            std::vector<FileChange> changes;
+
+            {
+                std::lock_guard lock{mWatcherMutex};
+                mFileWatcher.ReadChanges(changes, kEventPollTimeout);
+            }
+
+            if (changes.empty())
+                continue;
+
+            std::lock_guard lock{mMutex};
+
+            if (mCancelObsoleteBuilds && mBuilding && ClassifyChanges(changes) != WatchAction::None)
+                CancelBuild();
+
+            mPendingChanges.insert(mPendingChanges.end(), changes.begin(), changes.end());
+            mLastChangeTime = std::chrono::steady_clock::now();
+
+            mChangesReady.notify_all();
+        }
+    }
+
+    void BuildWatcher::WatchTargetTree(const Target &target)
+    {
+        std::vector<fs::path> dirs;
+        std::unordered_set<std::string> sources;
+
+        auto collect = [&dirs, &sources](auto &self, const Target &target) -> void {
+            for (auto &stamp : target.load_stamps)
+                if (stamp.directory)
+                    dirs.push_back(stamp.path);
+
+            for (auto &source : target.sources)
+                sources.insert(source.path.u8string());
+
+            for (auto &child : target.children)
+                self(self, *child);
+        };
+
+        collect(collect, target);
+
+        // Directories are never unwatched: doing so could miss changes made while the targets were being reloaded.
+        // Changes in directories that are not part of the tree anymore are simply ignored.
+        {
+            std::lock_guard lock{mWatcherMutex};
+
+            for (auto &dir : dirs)
+                mFileWatcher.AddDirectory(dir);
+        }
+
+        std::lock_guard lock{mMutex};
+
+        mSourcePaths = std::move(sources);
+        mWatchedDirs.clear();
+
+        for (auto &dir : dirs)
+            mWatchedDirs.insert(dir.u8string());
+    }
+
+    BuildWatcher::WatchAction BuildWatcher::ClassifyChanges(const std::vector<FileChange> &changes) const
+    {
+        auto result = WatchAction::None;
+
+        for (auto &change : changes)
+        {
+            auto name = change.path.filename().u8string();
+            auto key = change.path.u8string();
+
+            if (name.empty())
+                continue;
+
+            if (IsConfigFileName(name))
+                return WatchAction::Reload;
+
+            // Re writes this one on its own while generating the build desc
+            if (name == "re-deps-lock.json")
+                continue;
+
+            auto is_known = mSourcePaths.find(key) != mSourcePaths.end();
+            auto is_watched_dir = mWatchedDirs.find(key) != mWatchedDirs.end();
+
+            if (is_known || is_watched_dir)
+            {
+                if (!fs::exists(change.path))
+                    return WatchAction::Reload;
+
+                if (is_known)
+                    result = WatchAction::Rebuild;
+            }
+            else if (change.kind == FileChangeKind::Created && name.front() != '.' && fs::exists(change.path))
+            {
+                // A new file or directory in the tree, which changes the source lists
+                if (mWatchedDirs.find(change.path.parent_path().u8string()) != mWatchedDirs.end())
+                    return WatchAction::Reload;
+            }
+        }
+
+        return result;
+    }
+
+    BuildWatcher::WatchAction BuildWatcher::WaitForChanges()
+    {
+        std::unique_lock lock{mMutex};
+
+        while (!gQuitRequested)
+        {
+            if (!mPendingChanges.empty() && std::chrono::steady_clock::now() - mLastChangeTime >= mDebounceDelay)
+            {
+                auto changes = std::move(mPendingChanges);
+                mPendingChanges.clear();
+
+                auto action = ClassifyChanges(changes);
+
+                if (action != WatchAction::None)
+                    return action;
+
+                continue;
+            }
+
+            // Wake up periodically to notice Ctrl+C and the end of the debounce delay
+            mChangesReady.wait_for(lock, std::chrono::milliseconds{50});
+        }
+
+        return WatchAction::None;
+    }
+
+    void BuildWatcher::CancelBuild()
+    {
+#if !defined(WIN32)
+        std::lock_guard lock{gCancelMutex};
+
+        if (!mBuilding || gCancelRequested.exchange(true))
+            return;
+
+        mBuildCancelled = true;
+        mOut->Info(fg(fmt::color::yellow), "\n - Sources changed during the build, cancelling\n\n");
+
+        // Ninja only notices SIGINT while waiting for its subprocesses, which is what interrupts the build there.
+        // Anywhere else our own handler swallows it and the context checks mBuildCancelled between build phases.
+        pthread_kill(gBuildThread, SIGINT);
+#endif
+    }
+} // namespace re
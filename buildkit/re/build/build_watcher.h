@@ -0,0 +1,111 @@
+#pragma once
+#include "default_build_context.h"
+#include "file_watcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief Keeps a build context loaded and rebuilds its target whenever the watched target tree changes.
+     *
+     * Edits to existing source files only rerun the (kept) ninja state of the current context, so that ninja rebuilds
+     * just the affected edges. Config edits and added or removed files reload the whole context from scratch: targets,
+     * dependencies and the build desc are all resolved again.
+     *
+     * Bursts of changes are debounced, and builds made obsolete by a relevant change are cancelled on POSIX systems.
+     */
+    class BuildWatcher
+    {
+    public:
+        /**
+         * @brief Creates a fresh build context, loads the root target and generates the build desc to watch.
+         */
+        using ContextLoader = std::function<std::unique_ptr<DefaultBuildContext>(NinjaBuildDesc &desc)>;
+
+        /**
+         * @brief Construct a new BuildWatcher object.
+         *
+         * @param pOut The output interface to use
+         * @param root_path The root target's path, watched even if loading the target fails
+         * @param loader The context loader to use
+         */
+        BuildWatcher(IUserOutput *pOut, const fs::path &root_path, ContextLoader loader);
+        ~BuildWatcher();
+
+        /**
+         * @brief Sets how long the tree has to stay unchanged before a rebuild starts.
+         *
+         * @param delay The delay to use
+         */
+        void SetDebounceDelay(std::chrono::milliseconds delay)
+        {
+            mDebounceDelay = delay;
+        }
+
+        /**
+         * @brief Sets whether in-flight builds should be cancelled once a relevant change comes in.
+         *
+         * @param cancel Whether to cancel obsolete builds
+         */
+        void SetCancelObsoleteBuilds(bool cancel)
+        {
+            mCancelObsoleteBuilds = cancel;
+        }
+
+        /**
+         * @brief Builds and rebuilds the target until interrupted with SIGINT.
+         *
+         * @return int The exit code to use
+         */
+        int Run();
+
+    private:
+        enum class WatchAction
+        {
+            None,
+            Rebuild,
+            Reload
+        };
+
+        IUserOutput *mOut;
+        fs::path mRootPath;
+        ContextLoader mLoader;
+
+        std::chrono::milliseconds mDebounceDelay{200};
+        bool mCancelObsoleteBuilds = true;
+
+        std::mutex mWatcherMutex;
+        FileWatcher mFileWatcher;
+        std::thread mEventThread;
+
+        std::mutex mMutex;
+        std::condition_variable mChangesReady;
+        std::vector<FileChange> mPendingChanges;
+        std::chrono::steady_clock::time_point mLastChangeTime;
+
+        std::unordered_set<std::string> mSourcePaths;
+        std::unordered_set<std::string> mWatchedDirs;
+
+        std::atomic<bool> mBuilding{false};
+        std::atomic<bool> mBuildCancelled{false};
+        std::atomic<bool> mStopping{false};
+
+        void EventThreadMain();
+        void WatchTargetTree(const Target &target);
+
+        WatchAction ClassifyChanges(const std::vector<FileChange> &changes) const;
+        WatchAction WaitForChanges();
+
+        void CancelBuild();
+    };
+} // namespace re
@@ -22,18 +22,25 @@
 #include <re/langs/cmake/cmake_target_load_middleware.h>
 
 #include <re/deps/arch_coerced_dep_resolver.h>
+#include <re/deps/archive_dep_resolver.h>
 #include <re/deps/conan_dep_resolver.h>
 #include <re/deps/fs_dep_resolver.h>
 #include <re/deps/git_dep_resolver.h>
 #include <re/deps/github_dep_resolver.h>
 #include <re/deps/vcpkg_dep_resolver.h>
 
+#include <re/dep_store.h>
+#include <re/dep_version_solver.h>
 #include <re/deps_version_cache.h>
 
+#include <ninja/disk_interface.h>
 #include <ninja/manifest_parser.h>
 #include <ninja/tool_main.h>
 
 #include <re/debug.h>
+#include <re/dir_enumerator.h>
+#include <re/source_tree_scanner.h>
+#include <re/yaml_parse_cache.h>
 
 #include <fmt/color.h>
 #include <fmt/format.h>
@@ -80,6 +87,40 @@ namespace re
         mVars.SetVar("generate-build-meta", "false");
         mVars.SetVar("auto-load-uncached-deps", "true");
 
+        // 0 means one scanner thread per hardware thread
+        mVars.SetVar("source-scan-threads", "0");
+
+        // Rehydrate loaded targets from .re-cache/graph.bin when nothing has changed on disk
+        mVars.SetVar("graph-snapshot", "true");
+
+        // Keep parsed YAML documents in the dynamic data directory between runs
+        mVars.SetVar("yaml-parse-cache", "true");
+
+        // Partial builds only load the targets they need instead of the whole tree
+        mVars.SetVar("lazy-target-load", "true");
+
+        // Fetch independent external dependencies concurrently, at most this many at once (0 = one per hardware thread)
+        mVars.SetVar("parallel-dep-fetch", "true");
+        mVars.SetVar("dep-fetch-jobs", "8");
+
+        // Seconds the tags listed from git remotes for version ranges stay valid in .re-cache/git-tag-index.json
+        mVars.SetVar("git-tag-index-ttl", "3600");
+
+        // Pick a single version for every package that several targets depend on with different version ranges
+        mVars.SetVar("unify-dep-versions", "true");
+
+        // Build every target of CMake dependencies instead of only those Re targets link against
+        mVars.SetVar("cmake-build-all-targets", "false");
+
+        // Only check out the subdirectory of git dependencies with a cutout filter (`[/subdir]`)
+        mVars.SetVar("git-sparse-checkout", "true");
+
+        // Share git snapshots and Conan installs between all checkouts on this machine through the dependency store
+        mVars.SetVar("dep-store", "false");
+
+        // Local directory vcpkg and Conan keep prebuilt binaries in, so that fresh checkouts don't rebuild packages
+        mVars.SetVar("dep-binary-cache", "");
+
         mVars.SetVar("msg-level", "info");
         mVars.SetVar("colors", "true");
 
@@ -93,6 +134,9 @@ namespace re
         mDataPath = data_path;
         LoadCachedParams(mDataPath / "data");
 
+        if (mVars.GetVar("yaml-parse-cache").value_or("false") == "true")
+            YamlParseCache::Get().SetStoragePath(dynamic_data_path / "cache" / "yaml-parse-cache.bin");
+
         mEnv = std::make_unique<BuildEnv>(mVars, this);
 
         auto &cxx =
@@ -103,13 +147,18 @@ namespace re
         fs::create_directories(vcpkg_deps_path);
 
         auto vcpkg_resolver = std::make_unique<VcpkgDepResolver>(vcpkg_deps_path, this);
-        auto git_resolver = std::make_unique<GitDepResolver>(mEnv.get(), this);
+        // Only used by targets that opt into it with the dep-store var
+        mDepStore = std::make_unique<DepStore>(dynamic_data_path / "store");
+
+        auto git_resolver = std::make_unique<GitDepResolver>(mEnv.get(), this, mDepStore.get());
         auto github_resolver = std::make_unique<GithubDepResolver>(git_resolver.get());
 
         auto ac_resolver = std::make_unique<ArchCoercedDepResolver>(mEnv.get());
         auto fs_resolver = std::make_unique<FsDepResolver>(mEnv.get());
 
-        auto conan_resolver = std::make_unique<ConanDepResolver>(this);
+        auto conan_resolver = std::make_unique<ConanDepResolver>(this, mDepStore.get());
+
+        auto archive_resolver = std::make_unique<ArchiveDepResolver>(mEnv.get(), this);
 
         mEnv->AddDepResolver("vcpkg", vcpkg_resolver.get());
         mEnv->AddDepResolver("vcpkg-dep", vcpkg_resolver.get());
@@ -123,11 +172,16 @@ namespace re
 
         mEnv->AddDepResolver("conan", conan_resolver.get());
 
+        mEnv->AddDepResolver("archive", archive_resolver.get());
+        mEnv->AddDepResolver("http", archive_resolver.get());
+        mEnv->AddDepResolver("https", archive_resolver.get());
+
         mDepResolvers.emplace_back(std::move(vcpkg_resolver));
         mDepResolvers.emplace_back(std::move(git_resolver));
         mDepResolvers.emplace_back(std::move(github_resolver));
         mDepResolvers.emplace_back(std::move(ac_resolver));
         mDepResolvers.emplace_back(std::move(conan_resolver));
+        mDepResolvers.emplace_back(std::move(archive_resolver));
 
         auto global_deps_path = dynamic_data_path / "deps" / "installed";
         fs::create_directories(global_deps_path);
@@ -162,11 +216,22 @@ namespace re
         mVars.SetVar("re-data-path", mDataPath.generic_u8string());
     }
 
-    Target &DefaultBuildContext::LoadTarget(const fs::path &path)
+    Target &DefaultBuildContext::LoadTarget(const fs::path &path, bool partial_build)
     {
         re::PerfProfile _{fmt::format(R"({}("{}"))", __FUNCTION__, path.u8string())};
 
-        auto &target = mEnv->LoadTarget(path);
+        if (auto threads = mVars.GetVar("source-scan-threads"))
+            SetSourceScanThreadCount(ParseIntegerVar("source-scan-threads", *threads, 1));
+
+        auto lazy = partial_build && mVars.GetVar("lazy-target-load").value_or("false") == "true";
+        auto &target = mEnv->LoadTarget(path, lazy);
+
+        auto stats = GetDirEnumerationStats();
+
+        Debug(fg(fmt::color::dim_gray),
+              "\n- Source scan: {} directories, {} entries, {} stat calls\n", stats.directories, stats.entries,
+              stats.stat_calls);
+
         return target;
     }
 
@@ -200,51 +265,60 @@ namespace re
     {
         re::PerfProfile _{fmt::format(R"({}("{}"))", __FUNCTION__, pRootTarget->module)};
 
-        while (true)
-        {
-            bool has_unresolved_deps = false;
-
-            struct WantedDependency
-            {
-                Target *target;
-                TargetDependency *dep;
-            };
+        DepVersionSolver solver{*mDepsVersionCache, [this](const Target &target, const TargetDependency &dep) {
+                                    auto resolver = mEnv->GetDepResolver(dep.ns);
+                                    return resolver ? resolver->GetAvailableVersions(target, dep) : std::nullopt;
+                                }};
 
-            std::unordered_map<std::string, std::vector<WantedDependency>> wanted_deps;
+        // Loaded dependencies bring in requirements of their own, which can in turn change the versions picked for
+        // packages that were already loaded: keep going until the graph stops changing
+        constexpr auto kMaxRounds = 16;
 
-            auto targets = mEnv->GetSingleTargetLocalDepSet(pRootTarget);
+        std::size_t last_requirement_count = 0;
 
-            for (auto &target : targets)
-            {
+        for (auto round = 0;; round++)
+        {
+            for (auto &target : mEnv->GetSingleTargetLocalDepSet(pRootTarget))
                 for (auto &dep : target->dependencies)
-                {
-                    auto id = fmt::format("{}:{}", dep.ns.empty() ? "local" : dep.ns, dep.name);
-                    wanted_deps[id].push_back({target, &dep});
+                    solver.AddRequirement(*target, dep);
 
-                    if (dep.resolved.empty())
-                    {
-                        has_unresolved_deps = true;
-                    }
-                }
-            }
+            auto requirement_count = solver.GetRequirementCount();
+            auto changed = solver.Solve();
+
+            if (round > 0 && changed.empty() && requirement_count == last_requirement_count)
+                break;
 
-            for (auto &[id, wants] : wanted_deps)
+            if (round == kMaxRounds)
+                RE_THROW TargetDependencyException(pRootTarget, "dependency versions did not settle after {} rounds",
+                                                   kMaxRounds);
+
+            std::vector<std::pair<TargetDependency *, std::unordered_set<const Target *>>> previous;
+
+            for (auto dep : changed)
             {
-                fmt::print(fmt::emphasis::bold, "{}:\n", id);
+                auto &[_, packages] = previous.emplace_back(dep, std::unordered_set<const Target *>{});
 
-                for (auto &want : wants)
-                {
-                    fmt::print("    wanted by {} ({}{})\n", want.target->module, want.dep->version_kind_str,
-                               want.dep->version);
-                    fmt::print("\n");
-                }
-            }
+                for (auto target : dep->resolved)
+                    packages.insert(target->root);
 
-            has_unresolved_deps = false;
+                mEnv->UnresolveDependency(*dep);
+            }
 
-            if (!has_unresolved_deps)
-                break;
+            mEnv->GetSingleTargetDepSet(pRootTarget);
+            last_requirement_count = requirement_count;
+
+            // A resolver that hands out the package it loaded before the version changed would silently build the
+            // wrong version
+            for (auto &[dep, packages] : previous)
+                for (auto target : dep->resolved)
+                    if (packages.find(target->root) != packages.end())
+                        RE_THROW TargetDependencyException(
+                            pRootTarget, "'{}' still resolves to '{}' after its version changed to {}", dep->raw,
+                            target->module, mDepsVersionCache->GetLockedVersion(*dep).value_or("?"));
         }
+
+        // Packages that were replaced by other versions may have brought requirements that nothing has anymore
+        solver.DropStalePins();
     }
 
     NinjaBuildDesc DefaultBuildContext::GenerateBuildDescForTarget(Target &root_target, Target *build_target)
@@ -255,11 +329,10 @@ namespace re
         NinjaBuildDesc desc;
         desc.pRootTarget = &root_target;
         desc.pBuildTarget = build_target ? build_target : desc.pRootTarget;
+        desc.pDependencyGraph = &mEnv->GetDependencyGraph();
 
         auto &target = *desc.pBuildTarget;
 
-        // ResolveAllTargetDependencies(desc.pBuildTarget);
-
         auto version_cache_path = target.root->path / "re-deps-lock.json";
 
         {
@@ -318,6 +391,10 @@ namespace re
             }
         }
 
+        // Every version is picked before anything gets loaded, so that each package is only fetched and built once
+        if (mVars.GetVar("unify-dep-versions").value_or("false") == "true")
+            ResolveAllTargetDependencies(desc.pBuildTarget);
+
         auto deps = mEnv->GetSingleTargetDepSet(desc.pBuildTarget);
 
         for (auto dep : deps)
@@ -342,7 +419,9 @@ namespace re
             mEnv->InitializeTargetLinkEnv(&root_target, desc);
         }
 
-        deps = mEnv->GetSingleTargetDepSet(desc.pBuildTarget);
+        // Initializing the link environments was the last thing that could change the dependency set:
+        // every stage from here on uses the frozen closure
+        mEnv->FreezeBuildClosure(desc);
 
         mEnv->PopulateBuildDescWithDeps(desc.pBuildTarget, desc);
 
@@ -374,7 +453,7 @@ namespace re
 
         LocalVarScope artifact_scope{nullptr, "artifact", nullptr, ""};
 
-        for (auto &dep : deps)
+        for (auto &dep : desc.closure)
         {
             if (!dep->build_var_scope)
                 continue;
@@ -433,20 +512,31 @@ namespace re
 
             for (auto &src : dep->unused_sources)
                 unused_sources.push_back(src.path.generic_u8string());
+
+            auto &excluded_paths = (meta["excluded-paths"] = nlohmann::json::array());
+
+            for (auto &path : dep->excluded_paths)
+                excluded_paths.push_back(path.generic_u8string());
         }
 
-        for (auto &dep : deps)
+        // `target/<module>` namespaces get looked up on demand: populating them for every pair of targets is quadratic
+        auto closure_scopes = std::make_shared<std::unordered_map<std::string, const IVarNamespace *>>();
+
+        for (auto &dep : desc.closure)
+            if (dep->build_var_scope)
+                closure_scopes->emplace(dep->module, &*dep->build_var_scope);
+
+        auto resolve_target_ns = [closure_scopes](ulib::string_view module) -> const IVarNamespace * {
+            auto it = closure_scopes->find(std::string{module.data(), module.size()});
+            return it != closure_scopes->end() ? it->second : nullptr;
+        };
+
+        for (auto &dep : desc.closure)
         {
             if (!dep->build_var_scope)
                 continue;
 
-            for (auto &other_dep : deps)
-            {
-                if (!other_dep->build_var_scope)
-                    continue;
-
-                dep->build_var_scope->AddNamespace("target/" + other_dep->module, &*other_dep->build_var_scope);
-            }
+            dep->build_var_scope->GetContext()->SetNamespaceResolver("target/", resolve_target_ns);
 
             dep->build_var_scope->AddNamespace("this", &*dep->build_var_scope);
             dep->build_var_scope->AddNamespace("re", &mVars);
@@ -498,7 +588,7 @@ namespace re
         file << desc.meta.dump();
         file.close();
 
-        for (auto &dep : mEnv->GetSingleTargetDepSet(desc.pBuildTarget))
+        for (auto &dep : desc.closure)
         {
             mEnv->RunActionsCategorized(dep, &desc, "meta-available");
             mEnv->RunAutomaticStructuredTasks(dep, &desc, "meta-available");
@@ -513,6 +603,8 @@ namespace re
 
         auto style = fmt::emphasis::bold | fg(fmt::color::aquamarine);
 
+        ThrowIfCancelled(desc.pBuildTarget);
+
         Info(style, " - Generating build files\n");
 
         re::GenerateNinjaBuildFile(desc, desc.out_dir);
@@ -520,21 +612,23 @@ namespace re
         if (mVars.GetVarNoRecurse("no-meta").value_or("false") != "true")
             SaveTargetMeta(desc);
 
+        ThrowIfCancelled(desc.pBuildTarget);
+
         Info(style, " - Running pre-build actions\n");
 
-        for (auto &dep : mEnv->GetSingleTargetDepSet(desc.pBuildTarget))
+        for (auto &dep : desc.closure)
         {
             mEnv->RunActionsCategorized(dep, &desc, "pre-source-translate");
             mEnv->RunAutomaticStructuredTasks(dep, &desc, "pre-source-translate");
         }
 
-        for (auto &dep : mEnv->GetSingleTargetDepSet(desc.pBuildTarget))
+        for (auto &dep : desc.closure)
         {
             for (auto &[key, object] : dep->features)
                 object->ProcessTargetPreBuild(*dep);
         }
 
-        for (auto &dep : mEnv->GetSingleTargetDepSet(desc.pBuildTarget))
+        for (auto &dep : desc.closure)
         {
             mEnv->RunActionsCategorized(dep, &desc, "post-source-translate");
             mEnv->RunAutomaticStructuredTasks(dep, &desc, "post-source-translate");
@@ -543,17 +637,18 @@ namespace re
             mEnv->RunAutomaticStructuredTasks(dep, &desc, "pre-build");
         }
 
-        Info(style, " - Building...\n\n");
+        ThrowIfCancelled(desc.pBuildTarget);
 
-        for (auto &subninja : desc.subninjas)
-            RunNinjaBuild(subninja, desc.pBuildTarget);
+        Info(style, " - Building...\n\n");
 
         auto result = RunNinjaBuild(desc.out_dir / "build.ninja", desc.pBuildTarget);
 
+        ThrowIfCancelled(desc.pBuildTarget);
+
         Info(style, "\n - Running post-build actions\n\n");
 
         // Running post-build actions
-        for (auto &dep : mEnv->GetSingleTargetDepSet(desc.pBuildTarget))
+        for (auto &dep : desc.closure)
         {
             mEnv->RunActionsCategorized(dep, &desc, "post-build");
             mEnv->RunAutomaticStructuredTasks(dep, &desc, "post-build");
@@ -580,12 +675,97 @@ namespace re
         return result;
     }
 
-    int DefaultBuildContext::RunNinjaBuild(const fs::path &script, const Target *root)
+    namespace
     {
-        auto out_dir = script.parent_path().u8string();
-        auto script_name = script.filename().u8string();
+        std::uint64_t HashFile(const std::string &path)
+        {
+            std::ifstream file{path, std::ios::binary};
+            std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
 
+            return HashFileContents(data);
+        }
+
+        // Remembers every file the manifest parser reads: the manifest itself, but also its subninjas (like the
+        // rebased CMake ones) and includes, which can change on their own
+        class RecordingFileReader : public ::FileReader
+        {
+        public:
+            explicit RecordingFileReader(::FileReader *reader) : mReader{reader}
+            {
+            }
+
+            Status ReadFile(const std::string &path, std::string *contents, std::string *err) override
+            {
+                auto status = mReader->ReadFile(path, contents, err);
+
+                if (status == Okay)
+                    files.emplace_back(path, HashFileContents(*contents));
+
+                return status;
+            }
+
+            std::vector<std::pair<std::string, std::uint64_t>> files;
+
+        private:
+            ::FileReader *mReader;
+        };
+    } // namespace
+
+    struct DefaultBuildContext::NinjaSession
+    {
         ::BuildConfig config;
+        std::unique_ptr<ninja::NinjaMain> ninja;
+
+        // Every file the state was parsed from along with its hash, used to tell whether it is still current
+        std::vector<std::pair<std::string, std::uint64_t>> manifest_files;
+
+        bool IsCurrent() const
+        {
+            for (auto &[path, hash] : manifest_files)
+                if (!fs::exists(path) || HashFile(path) != hash)
+                    return false;
+
+            return true;
+        }
+    };
+
+    DefaultBuildContext::~DefaultBuildContext()
+    {
+        try
+        {
+            YamlParseCache::Get().Save();
+        }
+        catch (const std::exception &)
+        {
+            // The cache is only an optimization and a destructor is no place to report errors
+        }
+    }
+
+    void DefaultBuildContext::SetKeepNinjaState(bool keep)
+    {
+        mKeepNinjaState = keep;
+
+        if (!keep)
+            mNinjaSessions.clear();
+    }
+
+    void DefaultBuildContext::SetCancellationFlag(const std::atomic<bool> *flag)
+    {
+        mCancellationFlag = flag;
+    }
+
+    void DefaultBuildContext::ThrowIfCancelled(const Target *target)
+    {
+        if (mCancellationFlag && *mCancellationFlag)
+            RE_THROW TargetBuildException(target, "Build cancelled");
+    }
+
+    std::unique_ptr<DefaultBuildContext::NinjaSession> DefaultBuildContext::CreateNinjaSession(const fs::path &script,
+                                                                                               const Target *root)
+    {
+        auto session = std::make_unique<NinjaSession>();
+        auto &config = session->config;
+
         ninja::Options options;
 
         switch (int processors = GetProcessorCount())
@@ -602,6 +782,68 @@ namespace re
         if (auto parallelism = mVars.GetVar("parallelism"))
             config.parallelism = std::stoi(*parallelism);
 
+        auto script_name = script.filename().u8string();
+
+        options.input_file = script_name.c_str();
+        options.dupe_edges_should_err = true;
+
+        // NinjaMain keeps a reference to the config, which is why both live in the session
+        session->ninja = std::make_unique<ninja::NinjaMain>("", config);
+        auto &ninja = *session->ninja;
+
+        ManifestParserOptions parser_opts;
+        if (options.dupe_edges_should_err)
+        {
+            parser_opts.dupe_edge_action_ = kDupeEdgeActionError;
+        }
+        if (options.phony_cycle_should_err)
+        {
+            parser_opts.phony_cycle_action_ = kPhonyCycleActionError;
+        }
+
+        RecordingFileReader reader{&ninja.disk_interface_};
+        ManifestParser parser(&ninja.state_, &reader, parser_opts);
+
+        std::string err;
+        if (!parser.Load(options.input_file, &err))
+        {
+            RE_THROW TargetBuildException(root, "Failed to load generated config: {}", err);
+            exit(1);
+        }
+
+        session->manifest_files = std::move(reader.files);
+
+        if (!ninja.EnsureBuildDirExists())
+            RE_THROW TargetBuildException(root, "ninja.EnsureBuildDirExists() failed");
+
+        if (!ninja.OpenBuildLog() || !ninja.OpenDepsLog())
+            RE_THROW TargetBuildException(root, "ninja.OpenBuildLog() || ninja.OpenDepsLog() failed");
+
+        /*
+        // Attempt to rebuild the manifest before building anything else
+        if (ninja.RebuildManifest(options.input_file, &err, status))
+        {
+            // In dry_run mode the regeneration will succeed without changing the
+            // manifest forever. Better to return immediately.
+            if (config.dry_run)
+                exit(0);
+            // Start the build over with the new manifest.
+            continue;
+        }
+        else if (!err.empty())
+        {
+            status->Error("rebuilding '%s': %s", options.input_file, err.c_str());
+            exit(1);
+        }
+        */
+
+        return session;
+    }
+
+    int DefaultBuildContext::RunNinjaBuild(const fs::path &script, const Target *root)
+    {
+        auto out_dir = script.parent_path().u8string();
+
         class ReAwareStatusPrinter : public ::StatusPrinter
         {
         public:
@@ -651,75 +893,48 @@ namespace re
             }
         };
 
-        ReAwareStatusPrinter status{config, this};
-
         // status->Info("Running Ninja!");
 
-        options.working_dir = out_dir.c_str();
-        options.input_file = script_name.c_str();
-        options.dupe_edges_should_err = true;
-
-        if (options.working_dir)
-        {
-            Info({}, "ninja: Entering directory `{}'\n", out_dir);
+        Info({}, "ninja: Entering directory `{}'\n", out_dir);
 
-            fs::current_path(script.parent_path());
-        }
+        fs::current_path(script.parent_path());
 
-        ninja::NinjaMain ninja("", config);
+        std::unique_ptr<NinjaSession> temp_session;
+        NinjaSession *session = nullptr;
 
-        ManifestParserOptions parser_opts;
-        if (options.dupe_edges_should_err)
-        {
-            parser_opts.dupe_edge_action_ = kDupeEdgeActionError;
-        }
-        if (options.phony_cycle_should_err)
+        if (mKeepNinjaState)
         {
-            parser_opts.phony_cycle_action_ = kPhonyCycleActionError;
-        }
+            auto &kept = mNinjaSessions[script.u8string()];
 
-        ManifestParser parser(&ninja.state_, &ninja.disk_interface_, parser_opts);
+            // Kept sessions only need to forget what they have already examined on disk, unless the manifest or any
+            // subninja they were parsed from has been regenerated with different contents since
+            if (kept && !kept->IsCurrent())
+                kept = nullptr;
 
-        std::string err;
-        if (!parser.Load(options.input_file, &err))
-        {
-            RE_THROW TargetBuildException(root, "Failed to load generated config: {}", err);
-            exit(1);
-        }
-
-        if (!ninja.EnsureBuildDirExists())
-            RE_THROW TargetBuildException(root, "ninja.EnsureBuildDirExists() failed");
-
-        if (!ninja.OpenBuildLog() || !ninja.OpenDepsLog())
-            RE_THROW TargetBuildException(root, "ninja.OpenBuildLog() || ninja.OpenDepsLog() failed");
+            if (kept)
+                kept->ninja->state_.Reset();
+            else
+                kept = CreateNinjaSession(script, root);
 
-        /*
-        // Attempt to rebuild the manifest before building anything else
-        if (ninja.RebuildManifest(options.input_file, &err, status))
-        {
-            // In dry_run mode the regeneration will succeed without changing the
-            // manifest forever. Better to return immediately.
-            if (config.dry_run)
-                exit(0);
-            // Start the build over with the new manifest.
-            continue;
+            session = kept.get();
         }
-        else if (!err.empty())
+        else
         {
-            status->Error("rebuilding '%s': %s", options.input_file, err.c_str());
-            exit(1);
+            temp_session = CreateNinjaSession(script, root);
+            session = temp_session.get();
         }
-        */
+
+        ReAwareStatusPrinter status{session->config, this};
 
         std::vector<const char *> targets = {};
 
-        int result = ninja.RunBuild(targets.size(), (char **)targets.data(), &status);
+        int result = session->ninja->RunBuild(targets.size(), (char **)targets.data(), &status);
 
         if (result)
             RE_THROW TargetBuildException(root, "Ninja build failed: exit_code={}", result);
 
         if (g_metrics)
-            ninja.DumpMetrics();
+            session->ninja->DumpMetrics();
 
         Info({}, "\n");
 
@@ -1,11 +1,16 @@
 #pragma once
 #include <re/buildenv.h>
+#include <re/dep_store.h>
 #include <re/target_feature.h>
 #include <re/user_output.h>
 
 #include "environment_var_namespace.h"
 #include <ulib/yaml.h>
 
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
 namespace re
 {
     class DefaultBuildContext : public IUserOutput
@@ -13,6 +18,7 @@ namespace re
     public:
         DefaultBuildContext();
         DefaultBuildContext(const DefaultBuildContext &) = delete;
+        ~DefaultBuildContext();
 
         void LoadDefaultEnvironment(const fs::path &data_path, const fs::path &dynamic_data_path);
 
@@ -34,11 +40,24 @@ namespace re
             mVars.RemoveVar(key);
         }
 
-        Target &LoadTarget(const fs::path &path);
+        /**
+         * @brief Loads a root target.
+         *
+         * @param path The target's path
+         * @param partial_build Whether only a part of the target will be built. If `lazy-target-load` is enabled,
+         *                      child targets are then only loaded once they are needed.
+         */
+        Target &LoadTarget(const fs::path &path, bool partial_build = false);
 
         ulib::yaml LoadCachedParams(const fs::path &path);
         void SaveCachedParams(const fs::path &path, const ulib::yaml &node);
 
+        /**
+         * @brief Resolves all of a target's dependencies, picking a single version for each package that is required
+         * with different version ranges and pinning it in the dependency version cache.
+         *
+         * @param pRootTarget The target to resolve the dependencies of
+         */
         void ResolveAllTargetDependencies(Target *pRootTarget);
 
         NinjaBuildDesc GenerateBuildDescForTarget(Target &root_target, Target *build_target = nullptr);
@@ -49,6 +68,25 @@ namespace re
         int BuildTarget(const NinjaBuildDesc &desc);
         void InstallTarget(const NinjaBuildDesc &desc);
 
+        /**
+         * @brief Keeps parsed ninja manifests along with their open build and deps logs between BuildTarget() calls.
+         *
+         * This is meant for long-running sessions like `re watch` which rebuild the same build desc over and over.
+         * A kept manifest is parsed again whenever the generated one no longer matches it.
+         *
+         * @param keep Whether to keep the ninja state
+         */
+        void SetKeepNinjaState(bool keep);
+
+        /**
+         * @brief Makes BuildTarget() stop between build phases once the flag gets set.
+         *
+         * Ninja is only interrupted by SIGINT while it waits for its subprocesses: this covers everything else.
+         *
+         * @param flag The flag to check, or nullptr to never cancel
+         */
+        void SetCancellationFlag(const std::atomic<bool> *flag);
+
         int BuildTargetInDir(const fs::path &path)
         {
             auto desc = GenerateBuildDescForTargetInDir(path);
@@ -78,6 +116,8 @@ namespace re
 
         std::unique_ptr<BuildEnv> mEnv;
 
+        std::unique_ptr<DepStore> mDepStore;
+
         std::vector<std::unique_ptr<ILangProvider>> mLangs;
         std::vector<std::unique_ptr<IDepResolver>> mDepResolvers;
         std::vector<std::unique_ptr<ITargetFeature>> mTargetFeatures;
@@ -88,6 +128,16 @@ namespace re
 
         std::unique_ptr<DepsVersionCache> mDepsVersionCache;
 
+        struct NinjaSession;
+
+        std::unordered_map<std::string, std::unique_ptr<NinjaSession>> mNinjaSessions;
+        bool mKeepNinjaState = false;
+
+        const std::atomic<bool> *mCancellationFlag = nullptr;
+
+        void ThrowIfCancelled(const Target *target);
+
+        std::unique_ptr<NinjaSession> CreateNinjaSession(const fs::path &script, const Target *root);
         int RunNinjaBuild(const fs::path &script, const Target *root);
 
         void CopyTemplateToDirectory(const fs::path &dir, const fs::path &template_dir);
@@ -0,0 +1,176 @@
+#include "file_watcher.h"
+
+#include <re/error.h>
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace re
+{
+#if defined(__linux__)
+    FileWatcher::FileWatcher()
+    {
+        mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if (mFd < 0)
+            RE_THROW Exception("inotify_init1 failed: {}", std::strerror(errno));
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+        if (mFd >= 0)
+            close(mFd);
+    }
+
+    void FileWatcher::AddDirectory(const fs::path &path)
+    {
+        constexpr auto kWatchMask =
+            IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+
+        auto wd = inotify_add_watch(mFd, path.c_str(), kWatchMask);
+
+        // The directory might have been removed since the targets were loaded - the next reload will notice that
+        if (wd >= 0)
+            mWatches[wd] = path;
+    }
+
+    bool FileWatcher::ReadChanges(std::vector<FileChange> &out, std::chrono::milliseconds timeout)
+    {
+        pollfd pfd{mFd, POLLIN, 0};
+
+        if (poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0)
+            return false;
+
+        auto initial_size = out.size();
+
+        alignas(inotify_event) char buffer[16 * 1024];
+
+        while (true)
+        {
+            auto length = read(mFd, buffer, sizeof buffer);
+
+            if (length <= 0)
+                break;
+
+            for (char *ptr = buffer; ptr < buffer + length;)
+            {
+                auto event = reinterpret_cast<const inotify_event *>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto it = mWatches.find(event->wd);
+
+                if (it == mWatches.end())
+                    continue;
+
+                if (event->mask & IN_IGNORED)
+                {
+                    mWatches.erase(it);
+                    continue;
+                }
+
+                if (event->mask & IN_DELETE_SELF)
+                {
+                    out.push_back(FileChange{it->second, FileChangeKind::Removed});
+                    continue;
+                }
+
+                if (event->len == 0)
+                    continue;
+
+                auto path = it->second / event->name;
+
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    out.push_back(FileChange{path, FileChangeKind::Created});
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    out.push_back(FileChange{path, FileChangeKind::Removed});
+                else if (event->mask & IN_CLOSE_WRITE)
+                    out.push_back(FileChange{path, FileChangeKind::Modified});
+            }
+        }
+
+        return out.size() > initial_size;
+    }
+#else
+    FileWatcher::FileWatcher()
+    {
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+    }
+
+    std::unordered_map<std::string, std::int64_t> FileWatcher::ListDirectory(const fs::path &path)
+    {
+        std::unordered_map<std::string, std::int64_t> result;
+        std::error_code ec;
+
+        for (auto &entry : fs::directory_iterator{path, ec})
+        {
+            auto time = entry.last_write_time(ec);
+            result[entry.path().filename().u8string()] = ec ? 0 : time.time_since_epoch().count();
+        }
+
+        return result;
+    }
+
+    void FileWatcher::AddDirectory(const fs::path &path)
+    {
+        auto key = path.u8string();
+
+        if (mListings.find(key) == mListings.end())
+            mListings[key] = ListDirectory(path);
+    }
+
+    bool FileWatcher::ReadChanges(std::vector<FileChange> &out, std::chrono::milliseconds timeout)
+    {
+        constexpr auto kPollInterval = std::chrono::milliseconds{250};
+
+        auto initial_size = out.size();
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        while (true)
+        {
+            for (auto &[key, listing] : mListings)
+            {
+                auto dir = fs::u8path(key);
+                auto current = ListDirectory(dir);
+
+                for (auto &[name, time] : current)
+                {
+                    auto it = listing.find(name);
+
+                    if (it == listing.end())
+                        out.push_back(FileChange{dir / fs::u8path(name), FileChangeKind::Created});
+                    else if (it->second != time)
+                        out.push_back(FileChange{dir / fs::u8path(name), FileChangeKind::Modified});
+                }
+
+                for (auto &[name, time] : listing)
+                    if (current.find(name) == current.end())
+                        out.push_back(FileChange{dir / fs::u8path(name), FileChangeKind::Removed});
+
+                listing = std::move(current);
+            }
+
+            if (out.size() > initial_size)
+                return true;
+
+            auto now = std::chrono::steady_clock::now();
+
+            if (now >= deadline)
+                return false;
+
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(kPollInterval, deadline - now));
+        }
+    }
+#endif
+} // namespace re
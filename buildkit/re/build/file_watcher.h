@@ -0,0 +1,85 @@
+#pragma once
+#include <re/fs.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief The kind of a filesystem change reported by FileWatcher.
+     */
+    enum class FileChangeKind
+    {
+        /**
+         * @brief An existing file was written to.
+         */
+        Modified,
+
+        /**
+         * @brief A file or directory was created or moved into a watched directory.
+         */
+        Created,
+
+        /**
+         * @brief A file or directory was deleted or moved out of a watched directory.
+         */
+        Removed
+    };
+
+    /**
+     * @brief A single filesystem change reported by FileWatcher.
+     */
+    struct FileChange
+    {
+        fs::path path;
+        FileChangeKind kind;
+    };
+
+    /**
+     * @brief Watches a set of directories (non-recursively) for changes to their entries.
+     *
+     * On Linux this is backed by inotify. Other platforms fall back to periodically polling the watched directories'
+     * entry modification times.
+     */
+    class FileWatcher
+    {
+    public:
+        FileWatcher();
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher &) = delete;
+        FileWatcher &operator=(const FileWatcher &) = delete;
+
+        /**
+         * @brief Starts watching a directory. Watching the same directory twice does nothing.
+         *
+         * @param path The directory to watch
+         */
+        void AddDirectory(const fs::path &path);
+
+        /**
+         * @brief Waits for changes in the watched directories.
+         *
+         * @param out The list to append changes to
+         * @param timeout How long to wait for the first change
+         *
+         * @return true If any changes were appended
+         */
+        bool ReadChanges(std::vector<FileChange> &out, std::chrono::milliseconds timeout);
+
+    private:
+#if defined(__linux__)
+        int mFd = -1;
+        std::unordered_map<int, fs::path> mWatches;
+#else
+        std::unordered_map<std::string, std::unordered_map<std::string, std::int64_t>> mListings;
+
+        static std::unordered_map<std::string, std::int64_t> ListDirectory(const fs::path &path);
+#endif
+    };
+} // namespace re
@@ -1,8 +1,10 @@
 #include "ninja_gen.h"
+#include "ninja_rebase.h"
 
 #include <fmt/ostream.h>
 
 #include <fstream>
+#include <unordered_set>
 
 #include <ulib/format.h>
 #include <ulib/fmt/list.h>
@@ -83,6 +85,52 @@ namespace re
 
         out.print("\n");
 
+        // Foreign manifests (like those of CMake dependencies) become part of this graph instead of being built on
+        // their own, so that the whole build is a single Ninja run sharing a single job pool
+        std::vector<std::string> subninja_defaults;
+        std::unordered_set<std::string> subninja_nodes;
+
+        for (std::size_t i = 0; i < desc.subninjas.size(); i++)
+        {
+            fs::path script = std::string{ desc.subninjas[i] };
+            auto rebased = script.parent_path() / "re-build.ninja";
+
+            for (auto& output : RebaseNinjaManifest(script, rebased, fmt::format("re_subninja_{}_", i)))
+                subninja_nodes.insert(output);
+
+            out.print("subninja {}\n", EscapeNinjaPath(rebased.generic_u8string()));
+
+            auto outputs = desc.subninja_outputs.find(std::string{ desc.subninjas[i] });
+
+            if (outputs == desc.subninja_outputs.end())
+                continue;
+
+            for (auto& output : outputs->second)
+            {
+                auto path = fs::path{ output }.lexically_normal().generic_u8string();
+
+                // Artifacts the manifest doesn't build (like imported libraries) are expected to just exist
+                if (subninja_nodes.insert(path).second)
+                    out.print("build {}: phony\n", EscapeNinjaPath(path));
+
+                subninja_defaults.push_back(EscapeNinjaPath(path));
+            }
+        }
+
+        // Only the parts of foreign manifests that Re targets use get built
+        if (!desc.subninjas.empty() && (!desc.targets.empty() || !subninja_defaults.empty()))
+        {
+            out.print("\ndefault");
+
+            for (auto& target : desc.targets)
+                out.print(" {}", target.out);
+
+            for (auto& output : subninja_defaults)
+                out.print(" {}", output);
+
+            out.print("\n");
+        }
+
         /*
         for (auto& child : desc.children)
         {
@@ -0,0 +1,428 @@
+#include "ninja_rebase.h"
+
+#include <re/error.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+namespace re
+{
+    namespace
+    {
+        struct Binding
+        {
+            std::string key;
+            std::string value;
+        };
+
+        // Joins lines split with a trailing '$' and strips comments: statements are easier to rewrite whole
+        std::vector<std::string> ReadLogicalLines(const fs::path &path)
+        {
+            std::ifstream file{path, std::ios::binary};
+
+            if (!file)
+                RE_THROW Exception("Failed to read Ninja manifest '{}'", path.generic_u8string());
+
+            std::vector<std::string> lines;
+            std::string line;
+
+            bool continued = false;
+
+            while (std::getline(file, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+
+                if (continued)
+                {
+                    lines.back() += line.substr(std::min(line.find_first_not_of(' '), line.size()));
+                }
+                else
+                {
+                    auto first = line.find_first_not_of(' ');
+
+                    if (first == line.npos || line[first] == '#')
+                        continue;
+
+                    lines.push_back(line);
+                }
+
+                auto &current = lines.back();
+                std::size_t dollars = 0;
+
+                while (dollars < current.size() && current[current.size() - dollars - 1] == '$')
+                    dollars++;
+
+                // "$$" at the end of a line is an escaped dollar sign, not a line continuation
+                continued = dollars % 2 == 1;
+
+                if (continued)
+                    current.pop_back();
+            }
+
+            return lines;
+        }
+
+        bool IsIndented(const std::string &line)
+        {
+            return !line.empty() && line.front() == ' ';
+        }
+
+        Binding ParseBinding(std::string_view line)
+        {
+            auto trim = [](std::string_view text) {
+                auto first = text.find_first_not_of(' ');
+
+                if (first == text.npos)
+                    return std::string_view{};
+
+                return text.substr(first, text.find_last_not_of(' ') - first + 1);
+            };
+
+            auto eq = line.find('=');
+
+            if (eq == line.npos)
+                return {std::string{trim(line)}, ""};
+
+            // Leading whitespace is significant in values, but Ninja strips the one after the '='
+            auto value = line.substr(eq + 1);
+            value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+
+            return {std::string{trim(line.substr(0, eq))}, std::string{value}};
+        }
+
+        // Splits the part of a `build` statement after the keyword, keeping escapes intact; unescaped colons and pipes
+        // become tokens of their own
+        std::vector<std::string> TokenizeBuildStatement(std::string_view text)
+        {
+            std::vector<std::string> tokens;
+            std::string current;
+
+            auto flush = [&tokens, &current] {
+                if (!current.empty())
+                    tokens.push_back(std::move(current));
+
+                current.clear();
+            };
+
+            for (std::size_t i = 0; i < text.size(); i++)
+            {
+                auto c = text[i];
+
+                if (c == '$' && i + 1 < text.size())
+                {
+                    current += c;
+                    current += text[++i];
+                }
+                else if (c == ' ')
+                {
+                    flush();
+                }
+                else if (c == ':')
+                {
+                    flush();
+                    tokens.push_back(":");
+                }
+                else
+                {
+                    current += c;
+                }
+            }
+
+            flush();
+
+            return tokens;
+        }
+
+        std::string UnescapeNinjaPath(std::string_view path)
+        {
+            std::string result;
+
+            for (std::size_t i = 0; i < path.size(); i++)
+            {
+                if (path[i] == '$' && i + 1 < path.size() &&
+                    (path[i + 1] == '$' || path[i + 1] == ' ' || path[i + 1] == ':'))
+                    i++;
+
+                result += path[i];
+            }
+
+            return result;
+        }
+
+        bool IsAbsoluteNinjaPath(std::string_view path)
+        {
+            if (path.empty())
+                return false;
+
+            if (path[0] == '/' || path[0] == '\\')
+                return true;
+
+            // Drive letters, with the colon either escaped (build statements) or not (variables)
+            if (!std::isalpha(static_cast<unsigned char>(path[0])))
+                return false;
+
+            return path.substr(1, 1) == ":" || path.substr(1, 2) == "$:";
+        }
+
+        bool StartsWithVariable(std::string_view path)
+        {
+            return path.size() > 1 && path[0] == '$' &&
+                   (path[1] == '{' || path[1] == '_' || std::isalnum(static_cast<unsigned char>(path[1])));
+        }
+
+        class ManifestRebaser
+        {
+        public:
+            ManifestRebaser(const fs::path &dir, std::string_view pool_prefix)
+                : mDir{dir}, mPathPrefix{EscapeNinjaPath(dir.generic_u8string() + "/")},
+                  mValuePrefix{EscapeNinjaValue(dir.generic_u8string() + "/")}, mPoolPrefix{pool_prefix}
+            {
+            }
+
+            void Rebase(const fs::path &manifest, const fs::path &out_path)
+            {
+                std::ostringstream out;
+                Process(manifest, out);
+
+                fs::create_directories(out_path.parent_path());
+
+                std::ofstream file{out_path, std::ios::binary};
+                file << out.str();
+            }
+
+            std::vector<std::string> GetOutputs()
+            {
+                return std::move(mOutputs);
+            }
+
+        private:
+            fs::path mDir;
+
+            std::string mPathPrefix;
+            std::string mValuePrefix;
+            std::string mPoolPrefix;
+
+            std::unordered_set<std::string> mGeneratorRules;
+            std::vector<std::string> mOutputs;
+
+            std::size_t mSubninjaCount = 0;
+
+            void Process(const fs::path &manifest, std::ostream &out)
+            {
+                auto lines = ReadLogicalLines(manifest);
+
+                for (std::size_t i = 0; i < lines.size(); i++)
+                {
+                    auto &line = lines[i];
+
+                    std::vector<Binding> bindings;
+
+                    while (i + 1 < lines.size() && IsIndented(lines[i + 1]))
+                        bindings.push_back(ParseBinding(lines[++i]));
+
+                    if (IsIndented(line))
+                        continue;
+
+                    auto space = line.find(' ');
+                    auto keyword = line.substr(0, space);
+                    auto rest = space == line.npos ? std::string{} : line.substr(space + 1);
+
+                    if (keyword == "rule")
+                        WriteRule(rest, bindings, out);
+                    else if (keyword == "build")
+                        WriteBuild(rest, bindings, out);
+                    else if (keyword == "pool")
+                        WritePool(rest, bindings, out);
+                    else if (keyword == "include")
+                        Process(ResolveIncludedPath(rest), out);
+                    else if (keyword == "subninja")
+                        WriteSubninja(ResolveIncludedPath(rest), out);
+                    else if (keyword != "default")
+                        out << line << "\n";
+                }
+            }
+
+            void WriteRule(const std::string &name, const std::vector<Binding> &bindings, std::ostream &out)
+            {
+                out << "rule " << name << "\n";
+
+                for (auto &[key, value] : bindings)
+                {
+                    // Regenerating the manifest is the foreign build system's business
+                    if (key == "generator")
+                        mGeneratorRules.insert(name);
+
+                    out << "  " << key << " = " << RebaseBinding(key, value) << "\n";
+                }
+
+                out << "\n";
+            }
+
+            void WriteBuild(const std::string &statement, const std::vector<Binding> &bindings, std::ostream &out)
+            {
+                auto tokens = TokenizeBuildStatement(statement);
+                auto colon = std::find(tokens.begin(), tokens.end(), ":");
+
+                if (colon == tokens.end() || std::next(colon) == tokens.end())
+                    RE_THROW Exception("Invalid Ninja build statement: 'build {}'", statement);
+
+                auto rule = std::next(colon);
+
+                if (mGeneratorRules.count(*rule))
+                    return;
+
+                // Generators declare the files their manifest is generated from like this, so that a deleted one
+                // doesn't fail the build. Several manifests can name the same files, which Ninja doesn't allow.
+                if (*rule == "phony" && std::next(rule) == tokens.end())
+                {
+                    tokens.erase(std::remove_if(tokens.begin(), colon, IsAbsoluteNinjaPath), colon);
+
+                    colon = std::find(tokens.begin(), tokens.end(), ":");
+                    rule = std::next(colon);
+
+                    if (colon == tokens.begin() || (colon == std::next(tokens.begin()) && tokens.front() == "|"))
+                        return;
+                }
+
+                std::string result = "build";
+
+                for (auto it = tokens.begin(); it != tokens.end(); ++it)
+                {
+                    result += ' ';
+
+                    if (it == colon)
+                    {
+                        result.pop_back();
+                        result += ':';
+                    }
+                    else if (it == rule || *it == "|" || *it == "||" || *it == "|@")
+                    {
+                        result += *it;
+                    }
+                    else
+                    {
+                        auto path = RebasePath(*it);
+
+                        if (it < colon)
+                            mOutputs.push_back(fs::path{UnescapeNinjaPath(path)}.lexically_normal().generic_u8string());
+
+                        result += path;
+                    }
+                }
+
+                out << result << "\n";
+
+                for (auto &[key, value] : bindings)
+                    out << "  " << key << " = " << RebaseBinding(key, value) << "\n";
+            }
+
+            void WritePool(const std::string &name, const std::vector<Binding> &bindings, std::ostream &out)
+            {
+                out << "pool " << mPoolPrefix << name << "\n";
+
+                for (auto &[key, value] : bindings)
+                    out << "  " << key << " = " << value << "\n";
+
+                out << "\n";
+            }
+
+            void WriteSubninja(const fs::path &manifest, std::ostream &out)
+            {
+                // Subninjas get their own scope, so they can't be inlined
+                std::ostringstream sub_out;
+                Process(manifest, sub_out);
+
+                auto path = mDir / fmt::format("re-subninja-{}.ninja", mSubninjaCount++);
+
+                std::ofstream file{path, std::ios::binary};
+                file << sub_out.str();
+
+                out << "subninja " << EscapeNinjaPath(path.generic_u8string()) << "\n";
+            }
+
+            fs::path ResolveIncludedPath(const std::string &path)
+            {
+                // Include paths are relative to the directory Ninja runs in, which is where foreign manifests live
+                return mDir / UnescapeNinjaPath(path);
+            }
+
+            std::string RebasePath(const std::string &path)
+            {
+                // Paths starting with variables can't be told apart without evaluating them: generators only use
+                // those for absolute paths
+                if (IsAbsoluteNinjaPath(path) || StartsWithVariable(path))
+                    return path;
+
+                return mPathPrefix + path;
+            }
+
+            std::string RebaseBinding(const std::string &key, const std::string &value)
+            {
+                if (key == "command")
+                {
+#ifdef WIN32
+                    return fmt::format("cmd.exe /C \"cd /D {} && {}\"", EscapeNinjaValue(mDir.u8string()), value);
+#else
+                    return fmt::format("cd \"{}\" && {}", EscapeNinjaValue(mDir.u8string()), value);
+#endif
+                }
+
+                if (key == "pool")
+                    return (value.empty() || value == "console") ? value : mPoolPrefix + value;
+
+                // Unlike in build statements, these mostly refer to edge variables (like CMake's $DEP_FILE) holding
+                // relative paths
+                if ((key == "depfile" || key == "rspfile" || key == "dyndep") && !value.empty() &&
+                    !IsAbsoluteNinjaPath(value))
+                    return mValuePrefix + value;
+
+                return value;
+            }
+        };
+    } // namespace
+
+    std::vector<std::string> RebaseNinjaManifest(const fs::path &manifest, const fs::path &out_path,
+                                                 std::string_view pool_prefix)
+    {
+        ManifestRebaser rebaser{manifest.parent_path(), pool_prefix};
+        rebaser.Rebase(manifest, out_path);
+
+        return rebaser.GetOutputs();
+    }
+
+    std::string EscapeNinjaPath(std::string_view path)
+    {
+        std::string result;
+
+        for (auto c : path)
+        {
+            if (c == '$' || c == ' ' || c == ':')
+                result += '$';
+
+            result += c;
+        }
+
+        return result;
+    }
+
+    std::string EscapeNinjaValue(std::string_view value)
+    {
+        std::string result;
+
+        for (auto c : value)
+        {
+            if (c == '$')
+                result += '$';
+
+            result += c;
+        }
+
+        return result;
+    }
+} // namespace re
@@ -0,0 +1,47 @@
+/**
+ * @file re/build/ninja_rebase.h
+ * @brief Including foreign Ninja manifests into Re's own build graph
+ */
+
+#pragma once
+#include <re/fs.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief Writes a copy of a foreign Ninja manifest (like a CMake-generated build.ninja) that can be included into
+     * another manifest with `subninja`.
+     *
+     * Ninja resolves every path relative to the directory it runs in, and `subninja` doesn't change that, while foreign
+     * manifests expect to be run from their own directory. The copy has every path Ninja itself uses (outputs, inputs,
+     * depfiles, response files and dyndep files) made absolute, and its commands change into the manifest's directory
+     * before running.
+     *
+     * Statements that only make sense in a standalone build are dropped: `default` targets and the edges that regenerate
+     * the manifest. Pools share a single namespace across all manifests, so they are renamed.
+     *
+     * @param manifest The manifest to rebase
+     * @param out_path The path to write the rebased manifest to
+     * @param pool_prefix The prefix to rename the manifest's pools with
+     *
+     * @throws Exception Thrown if the manifest or any file it includes cannot be read
+     *
+     * @return std::vector<std::string> The absolute paths of everything the manifest builds, as generic paths
+     */
+    std::vector<std::string> RebaseNinjaManifest(const fs::path &manifest, const fs::path &out_path,
+                                                 std::string_view pool_prefix);
+
+    /**
+     * @brief Escapes a path for use in a Ninja `build` statement.
+     */
+    std::string EscapeNinjaPath(std::string_view path);
+
+    /**
+     * @brief Escapes a string for use as a Ninja variable's value.
+     */
+    std::string EscapeNinjaValue(std::string_view value);
+} // namespace re
@@ -8,6 +8,7 @@
 
 #include <fmt/format.h>
 
+#include <re/dependency_graph.h>
 #include <re/fs.h>
 #include <re/target.h>
 #include <re/vars.h>
@@ -58,6 +59,34 @@ namespace re
         const SourceFile *pSourceFile = nullptr;
     };
 
+    /**
+     * @brief The full set of targets taking part in a build, in dependency order.
+     *
+     * Computed once after the targets' link environments are initialized. Every build stage iterates this instead of
+     * recomputing the build target's dependency set.
+     */
+    struct BuildClosure
+    {
+        std::vector<Target *> targets;
+
+        bool frozen = false;
+
+        auto begin() const
+        {
+            return targets.begin();
+        }
+
+        auto end() const
+        {
+            return targets.end();
+        }
+
+        std::size_t size() const
+        {
+            return targets.size();
+        }
+    };
+
     struct NinjaBuildDesc
     {
         fs::path out_dir;
@@ -80,9 +109,17 @@ namespace re
 
         std::vector<ulib::string> subninjas;
 
+        // Outputs of each subninja that Re targets actually use, keyed by the subninja's path: only those get built
+        std::unordered_map<std::string, std::vector<std::string>> subninja_outputs;
+
         Target *pRootTarget = nullptr;
         Target *pBuildTarget = nullptr;
 
+        DependencyGraph *pDependencyGraph = nullptr;
+
+        // Frozen by the build context once the configure stage is done
+        BuildClosure closure;
+
         nlohmann::json meta;
 
         tsl::ordered_map<const Target *, fs::path> artifacts;
@@ -11,6 +11,7 @@
 #include <re/process_util.h>
 #include <re/target_cfg_utils.h>
 #include <re/target_feature.h>
+#include <re/target_graph_snapshot.h>
 
 // #include <boost/algorithm/string.hpp>
 #include <ulib/format.h>
@@ -26,6 +27,19 @@
 
 namespace re
 {
+    namespace
+    {
+        bool IsTargetNamed(const Target &target, ulib::string_view name)
+        {
+            ulib::string_view target_name = target.name;
+
+            while (target_name.starts_with('.'))
+                target_name.remove_prefix(1);
+
+            return target_name == name;
+        }
+    } // namespace
+
     void PopulateTargetChildSet(Target *pTarget, ulib::list<Target *> &to)
     {
         to.push_back(pTarget);
@@ -34,10 +48,11 @@ namespace re
             PopulateTargetChildSet(child.get(), to);
     }
 
-    void PopulateTargetDependencySet(Target *pTarget, ulib::list<Target *> &to, TargetDepResolver dep_resolver,
-                                     bool throw_on_missing)
+    static void PopulateTargetDependencySetImpl(Target *pTarget, ulib::list<Target *> &to,
+                                                std::unordered_set<const Target *> &added,
+                                                TargetDepResolver &dep_resolver, bool throw_on_missing)
     {
-        if (std::find(to.begin(), to.end(), pTarget) != to.end())
+        if (added.find(pTarget) != added.end())
             return;
 
         // std::cout << pTarget->resolved_config << std::endl;
@@ -82,7 +97,7 @@ namespace re
             {
                 for (auto &t : dep.resolved)
                 {
-                    PopulateTargetDependencySet(t, to, dep_resolver, throw_on_missing);
+                    PopulateTargetDependencySetImpl(t, to, added, dep_resolver, throw_on_missing);
 
                     ulib::list<Target *> kids;
                     PopulateTargetChildSet(t, kids);
@@ -108,14 +123,16 @@ namespace re
         }
 
         for (auto &child : pTarget->children)
-            PopulateTargetDependencySet(child.get(), to, dep_resolver, throw_on_missing);
+            PopulateTargetDependencySetImpl(child.get(), to, added, dep_resolver, throw_on_missing);
 
         to.push_back(pTarget);
+        added.insert(pTarget);
     }
 
-    void PopulateTargetDependencySetNoResolve(const Target *pTarget, std::vector<const Target *> &to)
+    static void PopulateTargetDependencySetNoResolveImpl(const Target *pTarget, std::vector<const Target *> &to,
+                                                         std::unordered_set<const Target *> &added)
     {
-        if (std::find(to.begin(), to.end(), pTarget) != to.end())
+        if (added.find(pTarget) != added.end())
             return;
 
         if (pTarget->resolved_config.is_map() && !pTarget->resolved_config["enabled"].get<bool>())
@@ -126,6 +143,7 @@ namespace re
         }
 
         to.push_back(pTarget);
+        added.insert(pTarget);
 
         for (auto &dep : pTarget->dependencies)
         {
@@ -136,11 +154,24 @@ namespace re
                 RE_THROW TargetDependencyException(pTarget, "unresolved dependency '{}'", dep.ToString());
 
             for (auto &t : dep.resolved)
-                PopulateTargetDependencySetNoResolve(t, to);
+                PopulateTargetDependencySetNoResolveImpl(t, to, added);
         }
 
         for (auto &child : pTarget->children)
-            PopulateTargetDependencySetNoResolve(child.get(), to);
+            PopulateTargetDependencySetNoResolveImpl(child.get(), to, added);
+    }
+
+    void PopulateTargetDependencySet(Target *pTarget, ulib::list<Target *> &to, TargetDepResolver dep_resolver,
+                                     bool throw_on_missing)
+    {
+        std::unordered_set<const Target *> added{to.begin(), to.end()};
+        PopulateTargetDependencySetImpl(pTarget, to, added, dep_resolver, throw_on_missing);
+    }
+
+    void PopulateTargetDependencySetNoResolve(const Target *pTarget, std::vector<const Target *> &to)
+    {
+        std::unordered_set<const Target *> added{to.begin(), to.end()};
+        PopulateTargetDependencySetNoResolveImpl(pTarget, to, added);
     }
 
     BuildEnv::BuildEnv(LocalVarScope &scope, IUserOutput *pOut) : mVars{&scope, "build"}, mOut{pOut}
@@ -220,19 +251,67 @@ namespace re
         return target;
     }
 
-    Target &BuildEnv::LoadTarget(const fs::path &path)
+    std::shared_future<void> BuildEnv::PrepareFreeTargetAsync(const fs::path &path, const Target *ancestor,
+                                                              const TargetDependency *dep_source,
+                                                              DepFetchScheduler &scheduler)
     {
-        auto target = LoadFreeTarget(path);
-        target->root_path = target->path;
+        for (auto &middleware : mTargetLoadMiddlewares)
+            if (middleware->SupportsTargetLoadPath(path))
+                return middleware->PrepareTargetLoadAsync(path, ancestor, dep_source, scheduler);
 
-        target->LoadDependencies();
-        target->LoadMiscConfig();
-        target->LoadSourceTree();
+        return {};
+    }
+
+    Target &BuildEnv::LoadTarget(const fs::path &path, bool defer_child_targets)
+    {
+        std::unique_ptr<Target> target = nullptr;
+
+        auto use_snapshot = mVars.GetVar("graph-snapshot").value_or("false") == "true";
+        auto snapshot_path = TargetGraphSnapshot::GetSnapshotPath(path);
+
+        // Middleware-loaded targets come from foreign project files the snapshot knows nothing about
+        for (auto &middleware : mTargetLoadMiddlewares)
+            if (middleware->SupportsTargetLoadPath(path))
+                use_snapshot = false;
+
+        auto save_snapshot = use_snapshot;
+
+        if (use_snapshot)
+        {
+            TargetGraphSnapshot snapshot;
+
+            if (snapshot.Load(snapshot_path))
+            {
+                auto parent = mRootTargets.size() > 0 ? mRootTargets.front().get() : mTheCoreProjectTarget.get();
+
+                if ((target = snapshot.Rehydrate(path, parent)))
+                    save_snapshot = snapshot.IsModified();
+            }
+        }
+
+        if (!target)
+        {
+            target = LoadFreeTarget(path);
+            target->root_path = target->path;
+
+            target->LoadDependencies();
+            target->LoadMiscConfig();
+            target->LoadSourceTree({}, defer_child_targets);
+
+            // The snapshot must always describe the full tree
+            if (defer_child_targets)
+                save_snapshot = false;
+        }
+
+        if (save_snapshot)
+            TargetGraphSnapshot::Save(*target, snapshot_path);
 
         // mTargetMap.clear();
         PopulateTargetMap(target.get());
+        InvalidateDependencyGraph();
 
         target->config["load-context"] = "standalone";
+        InvalidateResolvedTargetCfgCache();
 
         auto &moved = mRootTargets.emplace_back(std::move(target));
         return *moved.get();
@@ -243,6 +322,74 @@ namespace re
         PopulateTargetMap(pTarget);
     }
 
+    Target *BuildEnv::FindOrLoadChild(Target &parent, ulib::string_view name)
+    {
+        for (auto &child : parent.children)
+            if (IsTargetNamed(*child, name))
+                return child.get();
+
+        if (parent.deferred_children.empty())
+            return nullptr;
+
+        // Targets are usually named after their directories: try that first and only load every other deferred
+        // child if the name turns out to be different
+        auto &deferred = parent.deferred_children;
+
+        auto it = std::find_if(deferred.begin(), deferred.end(), [name](const fs::path &path) {
+            return ulib::string_view{path.filename().u8string()} == name;
+        });
+
+        if (it != deferred.end())
+        {
+            auto path = std::move(*it);
+            deferred.erase(it);
+
+            if (auto child = LoadDeferredChild(parent, path, true); child && IsTargetNamed(*child, name))
+                return child;
+        }
+
+        auto paths = std::move(deferred);
+        deferred.clear();
+
+        Target *result = nullptr;
+
+        for (auto &path : paths)
+            if (auto child = LoadDeferredChild(parent, path, true); child && IsTargetNamed(*child, name))
+                result = child;
+
+        return result;
+    }
+
+    void BuildEnv::LoadDeferredSubtree(Target &target)
+    {
+        auto paths = std::move(target.deferred_children);
+        target.deferred_children.clear();
+
+        // Whole subtrees are needed from here on, so they are scanned in one go
+        for (auto &path : paths)
+            LoadDeferredChild(target, path, false);
+
+        for (auto &child : target.children)
+            LoadDeferredSubtree(*child);
+    }
+
+    Target *BuildEnv::LoadDeferredChild(Target &parent, const fs::path &path, bool defer_child_targets)
+    {
+        auto target = std::make_unique<Target>(path, &parent);
+
+        if (!target->GetCfgEntry<bool>("enabled").value_or(true))
+            return nullptr;
+
+        target->LoadDependencies();
+        target->LoadMiscConfig();
+        target->LoadSourceTree({}, defer_child_targets);
+
+        PopulateTargetMap(target.get());
+        InvalidateDependencyGraph();
+
+        return parent.children.emplace_back(std::move(target)).get();
+    }
+
     bool BuildEnv::CanLoadTargetFrom(const fs::path &path)
     {
         // Check middlewares first - they may load non-Re targets just fine
@@ -289,6 +436,31 @@ namespace re
         return result;
     }
 
+    void BuildEnv::FreezeBuildClosure(NinjaBuildDesc &desc)
+    {
+        auto &closure = desc.closure;
+
+        closure = {};
+
+        for (auto target : GetSingleTargetDepSet(desc.pBuildTarget))
+            closure.targets.push_back(target);
+
+        closure.frozen = true;
+    }
+
+    ulib::list<Target *> BuildEnv::GetBuildClosure(const NinjaBuildDesc &desc)
+    {
+        if (!desc.closure.frozen)
+            return GetSingleTargetDepSet(desc.pBuildTarget);
+
+        ulib::list<Target *> result;
+
+        for (auto target : desc.closure)
+            result.push_back(target);
+
+        return result;
+    }
+
     void BuildEnv::AddLangProvider(ulib::string_view name, ILangProvider *provider)
     {
         mLangProviders[name.data()] = provider;
@@ -330,8 +502,20 @@ namespace re
 
         if (link_provider && desc.state["link_initialized_" + target->module] != "1")
         {
+            auto is_enabled = [target] {
+                return !target->resolved_config.is_map() || target->resolved_config["enabled"].get<bool>();
+            };
+
+            auto was_enabled = is_enabled();
+            auto dep_count = target->dependencies.size();
+
             link_provider->InitLinkTargetEnv(desc, *target);
             desc.state["link_initialized_" + target->module] = "1";
+
+            // Resolving the config can disable the target or add conditional dependencies. Most targets do neither,
+            // and dropping every memoized dependency set for each of them would make generation quadratic.
+            if (is_enabled() != was_enabled || target->dependencies.size() != dep_count)
+                InvalidateDependencyGraph();
         }
 
         for (auto &[name, object] : target->features)
@@ -393,6 +577,14 @@ namespace re
 
     void BuildEnv::PopulateBuildDescWithDeps(Target *target, NinjaBuildDesc &desc)
     {
+        if (target == desc.pBuildTarget && desc.closure.frozen)
+        {
+            for (auto dep : desc.closure)
+                PopulateBuildDesc(dep, desc);
+
+            return;
+        }
+
         for (auto &dep : GetSingleTargetDepSet(target))
             PopulateBuildDesc(dep, desc);
     }
@@ -424,7 +616,7 @@ namespace re
             auto to_dep = desc->out_dir / desc->GetArtifactDirectory(path);
 
             auto context = dependent->local_var_ctx;
-            context["self"] = &*target.build_var_scope;
+            context.SetNamespace("self", &*target.build_var_scope);
 
             auto scope = LocalVarScope{&context, "_", &*dependent->build_var_scope, "target"};
 
@@ -635,34 +827,7 @@ namespace re
         mTargetLoadMiddlewares.push_back(middleware);
     }
 
-    Target *FindDeepNeighborTarget(const Target *target, ulib::string_view name)
-    {
-        while (name.size() && name.front() == '.')
-            name.remove_prefix(1);
-
-        if (!target || !target->parent)
-        {
-            return nullptr;
-        }
-
-        for (auto &child : target->parent->children)
-        {
-            // fmt::print("{} -> {}\n", name, child->name);
-
-            ulib::string_view childName = child->name;
-            while (childName.starts_with('.'))
-                childName.remove_prefix(1);
-
-            if (childName == name)
-            {
-                return child.get();
-            }
-        }
-
-        return FindDeepNeighborTarget(target->parent, name);
-    }
-
-    Target *GetDeepSiblingDep(const Target *target, ulib::string_view name)
+    Target *BuildEnv::FindLocalDependency(const Target &target, ulib::string_view name)
     {
         while (name.starts_with("."))
             name.remove_prefix(1);
@@ -671,13 +836,18 @@ namespace re
         if (components.empty())
             return nullptr;
 
-        auto result = FindDeepNeighborTarget(target, components[0]);
-        for (size_t i = 1; i < components.size(); i++)
-        {
-            result = result->FindChild(components[i]);
-            if (!result)
-                return nullptr;
-        }
+        // The first component is looked up among the children of the closest ancestor that has it
+        Target *result = nullptr;
+
+        for (auto ancestor = target.parent; ancestor && !result; ancestor = ancestor->parent)
+            result = FindOrLoadChild(*ancestor, components[0]);
+
+        for (size_t i = 1; result && i < components.size(); i++)
+            result = FindOrLoadChild(*result, components[i]);
+
+        // Dependencies are built along with all of their children
+        if (result)
+            LoadDeferredSubtree(*result);
 
         return result;
     }
@@ -689,7 +859,7 @@ namespace re
 
         if (dep.ns.empty())
         {
-            auto result = GetDeepSiblingDep(&target, dep.name);
+            auto result = FindLocalDependency(target, dep.name);
             // fmt::print("ResolveTargetDependencyImpl: target: {}\n", target.name);
 
             // Arch coercion - this is SOMETIMES very useful
@@ -859,9 +1029,15 @@ namespace re
             if (auto resolver = mDepResolvers[dep.ns])
             {
                 auto result = resolver->ResolveTargetDependency(target, dep, mDepsVersionCache);
+
+                // Resolvers may still hand out a package that was dropped along with another one: it comes back as is
+                if (mForgottenTargets.erase(result->root))
+                    PopulateTargetMap(result->root);
+
                 result->config["load-context"] = "dep";
                 result->config["root-dir"] = result->path.generic_u8string();
                 result->config["is-external-dep"] = "true";
+                InvalidateResolvedTargetCfgCache();
 
                 if (result->resolved_config.is_map())
                     result->resolved_config["is-external-dep"] = "true";
@@ -901,6 +1077,9 @@ namespace re
                     result->LoadConditionalDependencies();
                 }
 
+                // The dependency's configs were just changed, and cached dependencies may have an index already
+                result->BuildVarIndex();
+
                 if (resolver->DoesCustomHandleFilters() || dep.filters.empty() || dep.filters[0].front() == '/')
                 {
                     out.emplace_back(result);
@@ -938,13 +1117,142 @@ namespace re
     void BuildEnv::AppendDepsAndSelf(Target *pTarget, ulib::list<Target *> &to, bool throw_on_missing,
                                      bool use_external)
     {
-        PopulateTargetDependencySet(
-            pTarget, to,
-            [this, &to, pTarget, throw_on_missing, use_external](const Target &target, const TargetDependency &dep,
-                                                                 ulib::list<Target *> &out) {
-                return ResolveTargetDependencyImpl(target, dep, out, use_external);
-            },
-            throw_on_missing);
+        // Once a target's whole dependency set is resolved, there is nothing left to walk: the graph has it all
+        if (mResolvedTargets.find(pTarget) == mResolvedTargets.end())
+        {
+            bool resolved_any = false;
+            ulib::list<Target *> walked;
+
+            if (use_external && mVars.GetVar("parallel-dep-fetch").value_or("false") == "true")
+                resolved_any = PrefetchDependencies(pTarget);
+
+            PopulateTargetDependencySet(
+                pTarget, walked,
+                [this, &resolved_any, use_external](const Target &target, const TargetDependency &dep,
+                                                    ulib::list<Target *> &out) {
+                    auto resolved = ResolveTargetDependencyImpl(target, dep, out, use_external);
+                    resolved_any |= resolved;
+                    return resolved;
+                },
+                throw_on_missing);
+
+            if (resolved_any)
+                InvalidateDependencyGraph();
+
+            if (mDependencyGraph.IsFullyResolved(*pTarget))
+                mResolvedTargets.insert(pTarget);
+        }
+
+        std::unordered_set<const Target *> added{to.begin(), to.end()};
+
+        for (auto target : mDependencyGraph.GetBuildOrder(*pTarget))
+            if (added.insert(target).second)
+                to.push_back(target);
+    }
+
+    bool BuildEnv::PrefetchDependencies(Target *pTarget)
+    {
+        if (auto jobs = mVars.GetVar("dep-fetch-jobs"))
+            mFetchScheduler.SetJobLimit(ParseIntegerVar("dep-fetch-jobs", *jobs, 0));
+
+        bool resolved_any = false;
+
+        std::vector<Target *> frontier{pTarget};
+        std::unordered_set<const Target *> visited;
+
+        while (!frontier.empty())
+        {
+            std::vector<Target *> next;
+            std::vector<std::pair<Target *, TargetDependency *>> pending;
+
+            auto collect = [&next, &pending, &visited](auto &self, Target *target) -> void {
+                if (!visited.insert(target).second)
+                    return;
+
+                if (target->resolved_config.is_map() && !target->resolved_config["enabled"].get<bool>())
+                    return;
+
+                for (auto &dep : target->dependencies)
+                {
+                    if (dep.resolved.empty())
+                        pending.emplace_back(target, &dep);
+                    else
+                        next.insert(next.end(), dep.resolved.begin(), dep.resolved.end());
+                }
+
+                for (auto &child : target->children)
+                    self(self, child.get());
+            };
+
+            for (auto target : frontier)
+                collect(collect, target);
+
+            // Start fetching the whole level at once: resolving is only done after everything has arrived. Fetches
+            // can take several steps (like listing a repository's versions before cloning one), so this goes on
+            // until a round doesn't start anything new.
+            for (auto started = true; started;)
+            {
+                started = false;
+
+                try
+                {
+                    for (auto &[target, dep] : pending)
+                    {
+                        auto it = mDepResolvers.find(dep->ns);
+
+                        if (dep->ns.empty() || it == mDepResolvers.end() || !it->second)
+                            continue;
+
+                        auto fetch =
+                            it->second->FetchTargetDependencyAsync(*target, *dep, mDepsVersionCache, mFetchScheduler);
+
+                        if (fetch.valid() && fetch.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+                            started = true;
+                    }
+
+                    // Resolvers that batch their fetches up only start them now
+                    std::unordered_set<IDepResolver *> flushed;
+
+                    for (auto &[ns, resolver] : mDepResolvers)
+                        if (resolver && flushed.insert(resolver).second)
+                            resolver->FlushFetches(mFetchScheduler);
+                }
+                catch (...)
+                {
+                    // Fetches that already started must not outlive the error
+                    try
+                    {
+                        mFetchScheduler.Wait();
+                    }
+                    catch (...)
+                    {
+                    }
+
+                    throw;
+                }
+
+                mFetchScheduler.Wait();
+            }
+
+            for (auto &[target, dep] : pending)
+            {
+                if (dep->resolved.empty() && ResolveTargetDependencyImpl(*target, *dep, dep->resolved))
+                {
+                    resolved_any = true;
+                    next.insert(next.end(), dep->resolved.begin(), dep->resolved.end());
+                }
+            }
+
+            frontier = std::move(next);
+        }
+
+        return resolved_any;
+    }
+
+    void BuildEnv::InvalidateDependencyGraph()
+    {
+        mDependencyGraph.Invalidate();
+        mResolvedTargets.clear();
     }
 
     void BuildEnv::RunActionList(const NinjaBuildDesc *desc, Target *target, const TargetConfig &list,
@@ -1087,7 +1395,7 @@ namespace re
             {
                 if (desc)
                 {
-                    for (auto &dep : GetSingleTargetDepSet(desc->pBuildTarget))
+                    for (auto &dep : GetBuildClosure(*desc))
                         RunStructuredTask(dep, desc, dep_task.scalar(), stage);
                 }
                 else
@@ -1124,6 +1432,91 @@ namespace re
         return mDepResolvers[name];
     }
 
+    void BuildEnv::UnresolveDependency(TargetDependency &dep)
+    {
+        auto previous = std::move(dep.resolved);
+        dep.resolved.clear();
+
+        // Filters resolve to children: what was loaded for the dependency is the package they belong to
+        std::unordered_set<Target *> packages;
+
+        for (auto target : previous)
+            packages.insert(target->root);
+
+        if (!dep.ns.empty())
+            for (auto package : packages)
+                ForgetUnusedPackage(package, GetDepResolver(dep.ns));
+
+        InvalidateDependencyGraph();
+    }
+
+    bool BuildEnv::IsPackageUsed(const Target *package)
+    {
+        for (auto &[module, target] : mTargetMap)
+        {
+            if (!target || target->root == package)
+                continue;
+
+            for (auto &dep : target->dependencies)
+                for (auto resolved : dep.resolved)
+                    if (resolved->root == package)
+                        return true;
+        }
+
+        return false;
+    }
+
+    void BuildEnv::ForgetUnusedPackage(Target *package, IDepResolver *resolver)
+    {
+        for (auto &root : mRootTargets)
+            if (root.get() == package)
+                return;
+
+        if (mForgottenTargets.count(package) || IsPackageUsed(package))
+            return;
+
+        RE_TRACE(" [DBG] Forgetting package: '{}'\n", package->module);
+
+        ulib::list<Target *> targets;
+        PopulateTargetChildSet(package, targets);
+
+        // A newer version of the package is about to be loaded under the same module names
+        for (auto target : targets)
+            if (auto it = mTargetMap.find(target->module); it != mTargetMap.end() && it->second == target)
+                mTargetMap.erase(it);
+
+        mForgottenTargets.insert(package);
+
+        if (resolver)
+            resolver->ForgetTarget(package);
+
+        // Whatever only this package depended on goes away along with it, and so do its version requirements
+        std::vector<std::pair<Target *, IDepResolver *>> orphans;
+
+        for (auto target : targets)
+        {
+            for (auto &dep : target->dependencies)
+            {
+                for (auto resolved : dep.resolved)
+                {
+                    ulib::list<Target *> kids;
+                    PopulateTargetChildSet(resolved, kids);
+
+                    for (auto kid : kids)
+                        kid->dependents.erase(target);
+
+                    if (!dep.ns.empty() && resolved->root != package)
+                        orphans.emplace_back(resolved->root, GetDepResolver(dep.ns));
+                }
+
+                dep.resolved.clear();
+            }
+        }
+
+        for (auto &[orphan, orphan_resolver] : orphans)
+            ForgetUnusedPackage(orphan, orphan_resolver);
+    }
+
     void BuildEnv::DebugShowVisualBuildInfo(const Target *pTarget, int depth)
     {
         const auto kStyleRoot = fg(fmt::color::red) | bg(fmt::color::yellow);
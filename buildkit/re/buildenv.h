@@ -11,6 +11,8 @@
 #pragma once
 #include "build_desc.h"
 #include "dep_resolver.h"
+#include "dep_fetch_scheduler.h"
+#include "dependency_graph.h"
 #include "deps_version_cache.h"
 #include "target.h"
 #include "target_load_middleware.h"
@@ -98,13 +100,48 @@ namespace re
         std::unique_ptr<Target> LoadFreeTarget(const fs::path &path, const Target *ancestor = nullptr,
                                                const TargetDependency *dep_source = nullptr);
 
+        /**
+         * @brief Lets the middleware that would load the target at the specified path start preparing it.
+         *
+         * @param path The target path
+         * @param ancestor The target's "ancestor" target responsible for it (can be nullptr)
+         * @param dep_source The target's "source" dependency which caused it to be loaded (can be nullptr)
+         * @param scheduler The scheduler to prepare the target on
+         *
+         * @return std::shared_future<void> The scheduled work, or an invalid future if there is nothing to do
+         */
+        std::shared_future<void> PrepareFreeTargetAsync(const fs::path &path, const Target *ancestor,
+                                                        const TargetDependency *dep_source,
+                                                        DepFetchScheduler &scheduler);
+
         /**
          * @brief Loads a root-level target.
          *
+         * With deferred child targets, only the root target itself is loaded at first: its child targets are loaded
+         * on demand by FindOrLoadChild, which local dependency resolution uses as well. This is meant for partial
+         * builds, which only need the built target, its ancestors and whatever it depends on.
+         *
          * @param path The target path
+         * @param defer_child_targets Whether to defer loading child targets until they are needed
          * @return Target& A reference to the loaded target.
          */
-        Target &LoadTarget(const fs::path &path);
+        Target &LoadTarget(const fs::path &path, bool defer_child_targets = false);
+
+        /**
+         * @brief Finds a target's child by name, loading it first if it was deferred.
+         *
+         * @param parent The target to search in
+         * @param name The child target's name
+         * @return Target* The child target (nullptr if there's no such child)
+         */
+        Target *FindOrLoadChild(Target &parent, ulib::string_view name);
+
+        /**
+         * @brief Loads all deferred targets in a target's subtree.
+         *
+         * @param target The target to load the subtree of
+         */
+        void LoadDeferredSubtree(Target &target);
 
         /**
          * @brief Registers the specified target to be available as a local dependency.
@@ -127,6 +164,38 @@ namespace re
         ulib::list<Target *> GetSingleTargetLocalDepSet(Target *pTarget);
         ulib::list<Target *> GetTargetsInDependencyOrder();
 
+        /**
+         * @brief Computes the build target's dependency set along with per-target flags and stores it in the build
+         * description.
+         *
+         * Must be called once all the targets' link environments are initialized, since that can still change
+         * the dependency set.
+         *
+         * @param desc The build description to freeze the closure in
+         */
+        void FreezeBuildClosure(NinjaBuildDesc &desc);
+
+        /**
+         * @brief Gets the targets taking part in a build, in dependency order.
+         *
+         * @param desc The build description
+         * @return ulib::list<Target *> The frozen closure, or a freshly computed dependency set if it is not frozen yet
+         */
+        ulib::list<Target *> GetBuildClosure(const NinjaBuildDesc &desc);
+
+        /**
+         * @brief Gets the dependency graph of all targets in this environment.
+         *
+         * The graph only contains dependencies that have already been resolved: use GetSingleTargetDepSet() to
+         * resolve a target's dependencies first.
+         *
+         * @return DependencyGraph& The dependency graph
+         */
+        DependencyGraph &GetDependencyGraph()
+        {
+            return mDependencyGraph;
+        }
+
         void AddLangProvider(ulib::string_view name, ILangProvider *provider);
         ILangProvider *GetLangProvider(ulib::string_view name) override;
 
@@ -162,6 +231,27 @@ namespace re
 
         IDepResolver *GetDepResolver(ulib::string_view name);
 
+        /**
+         * @brief Forgets what a dependency was resolved to, so that it is resolved again the next time it is needed.
+         *
+         * External packages that nothing else uses anymore are unregistered along with their children, and so is
+         * everything that only they depended on. This lets another version of the package be loaded under the same
+         * module names.
+         *
+         * @param dep The dependency
+         */
+        void UnresolveDependency(TargetDependency &dep);
+
+        /**
+         * @brief Gets the scheduler used to fetch external dependencies concurrently.
+         *
+         * @return DepFetchScheduler& The scheduler
+         */
+        DepFetchScheduler &GetDepFetchScheduler()
+        {
+            return mFetchScheduler;
+        }
+
         void DebugShowVisualBuildInfo(const Target *pTarget = nullptr, int depth = 0);
 
         /**
@@ -200,11 +290,41 @@ namespace re
 
         std::unordered_set<std::string> mCompletedActions;
 
+        DepFetchScheduler mFetchScheduler;
+        DependencyGraph mDependencyGraph;
+
+        /**
+         * @brief Targets whose dependency sets were fully resolved since the graph was last invalidated.
+         */
+        std::unordered_set<const Target *> mResolvedTargets;
+
+        void InvalidateDependencyGraph();
+
         void PopulateTargetMap(Target *pTarget);
 
+        /**
+         * @brief External packages unregistered by UnresolveDependency(), which still own their targets.
+         */
+        std::unordered_set<const Target *> mForgottenTargets;
+
+        bool IsPackageUsed(const Target *package);
+        void ForgetUnusedPackage(Target *package, IDepResolver *resolver);
+
+        Target *LoadDeferredChild(Target &parent, const fs::path &path, bool defer_child_targets);
+        Target *FindLocalDependency(const Target &target, ulib::string_view name);
+
         void AppendDepsAndSelf(Target *pTarget, ulib::list<Target *> &to, bool throw_on_missing = true,
                                bool use_external = true);
 
+        /**
+         * @brief Resolves a target's dependencies breadth-first, fetching each level's external dependencies
+         * concurrently before resolving them.
+         *
+         * @param pTarget The target to start with
+         * @return true If any dependency got resolved
+         */
+        bool PrefetchDependencies(Target *pTarget);
+
         void RunActionList(const NinjaBuildDesc *desc, Target *target, const TargetConfig &list,
                            ulib::string_view run_type, ulib::string_view default_run_type);
 
@@ -0,0 +1,187 @@
+#include "dep_fetch_scheduler.h"
+
+#include <algorithm>
+
+namespace re
+{
+    DepFetchScheduler::~DepFetchScheduler()
+    {
+        {
+            std::lock_guard lock{mMutex};
+            mStopping = true;
+        }
+
+        mJobAvailable.notify_all();
+
+        for (auto &thread : mThreads)
+            thread.join();
+    }
+
+    void DepFetchScheduler::SetJobLimit(std::size_t limit)
+    {
+        std::lock_guard lock{mMutex};
+        mJobLimit = limit;
+    }
+
+    void DepFetchScheduler::SetPoolLimit(const std::string &pool, std::size_t limit)
+    {
+        std::lock_guard lock{mMutex};
+        mPoolLimits[pool] = std::max<std::size_t>(limit, 1);
+    }
+
+    std::shared_future<void> DepFetchScheduler::Schedule(const std::string &pool, const std::string &key, Task task)
+    {
+        std::unique_lock lock{mMutex};
+
+        if (auto it = mScheduled.find(key); it != mScheduled.end())
+            return it->second;
+
+        // Failed fetches are forgotten before their future completes, so that the next request retries them
+        auto wrapped = [this, key, task = std::move(task)] {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                std::lock_guard lock{mMutex};
+                mScheduled.erase(key);
+
+                throw;
+            }
+        };
+
+        auto &job = mQueue.emplace_back(Job{pool, std::packaged_task<void()>{std::move(wrapped)}});
+        auto future = job.task.get_future().share();
+
+        mScheduled.emplace(key, future);
+        mPending.push_back(future);
+
+        auto limit = mJobLimit ? mJobLimit : std::max(std::thread::hardware_concurrency(), 1u);
+
+        // Fetches spend most of their time waiting for the network or child processes, so the threads are only
+        // spawned as the queue grows
+        if (mQueue.size() > mIdle && mThreads.size() < limit)
+            mThreads.emplace_back([this] { WorkerMain(); });
+
+        lock.unlock();
+        mJobAvailable.notify_all();
+
+        return future;
+    }
+
+    void DepFetchScheduler::Wait()
+    {
+        std::vector<std::shared_future<void>> pending;
+
+        {
+            std::lock_guard lock{mMutex};
+            pending.swap(mPending);
+        }
+
+        std::exception_ptr error;
+
+        // Every fetch has to be waited for (even after a failure) since they may still be writing to disk
+        for (auto &future : pending)
+        {
+            try
+            {
+                future.get();
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    bool DepFetchScheduler::TryTakeJob(Job &out)
+    {
+        for (auto it = mQueue.begin(); it != mQueue.end(); it++)
+        {
+            auto limit = mPoolLimits.find(it->pool);
+
+            if (limit != mPoolLimits.end() && mPoolRunning[it->pool] >= limit->second)
+                continue;
+
+            out = std::move(*it);
+            mQueue.erase(it);
+
+            mPoolRunning[out.pool]++;
+            return true;
+        }
+
+        return false;
+    }
+
+    void DepFetchScheduler::WorkerMain()
+    {
+        std::unique_lock lock{mMutex};
+
+        while (true)
+        {
+            Job job;
+
+            mIdle++;
+            mJobAvailable.wait(lock, [this, &job] { return mStopping || TryTakeJob(job); });
+            mIdle--;
+
+            if (mStopping)
+                return;
+
+            lock.unlock();
+
+            // Exceptions end up in the job's future
+            job.task();
+
+            lock.lock();
+            mPoolRunning[job.pool]--;
+
+            // Finishing a job may unblock others waiting on its pool limit
+            mJobAvailable.notify_all();
+        }
+    }
+    std::shared_future<void> DepFetchBatch::Add(const std::string &item)
+    {
+        if (!mPromise)
+        {
+            mPromise = std::make_shared<std::promise<void>>();
+            mFuture = mPromise->get_future().share();
+        }
+
+        if (std::find(mItems.begin(), mItems.end(), item) == mItems.end())
+            mItems.push_back(item);
+
+        return mFuture;
+    }
+
+    void DepFetchBatch::Flush(DepFetchScheduler &scheduler, const std::string &pool, const std::string &key, Task task)
+    {
+        if (mItems.empty())
+            return;
+
+        // Every flush is a fetch of its own: the scheduler must never mistake it for an earlier one
+        auto batch_key = key + "#" + std::to_string(mFlushCount++);
+
+        scheduler.Schedule(pool, batch_key, [items = std::move(mItems), promise = std::move(mPromise), task] {
+            try
+            {
+                task(items);
+                promise->set_value();
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+                throw;
+            }
+        });
+
+        mItems.clear();
+        mPromise.reset();
+        mFuture = {};
+    }
+} // namespace re
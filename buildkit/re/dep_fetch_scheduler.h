@@ -0,0 +1,150 @@
+/**
+ * @file re/dep_fetch_scheduler.h
+ * @brief Bounded concurrent scheduler for external dependency fetches
+ */
+
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief Runs dependency fetches (clones, package installs and the like) concurrently.
+     *
+     * Every fetch belongs to a pool, usually named after the tool that performs it. The total number of running
+     * fetches is limited, and each pool can have a stricter limit of its own for tools that can't run several
+     * instances at once. Fetches are also deduplicated by key, so several targets requesting the same package only
+     * fetch it once. Failed fetches are not remembered: the next request for the same key tries again.
+     *
+     * Fetch tasks must only touch the file system: everything involving targets has to happen on the thread that
+     * scheduled them, after the fetch has completed.
+     */
+    class DepFetchScheduler
+    {
+    public:
+        using Task = std::function<void()>;
+
+        DepFetchScheduler() = default;
+
+        DepFetchScheduler(const DepFetchScheduler &) = delete;
+        DepFetchScheduler &operator=(const DepFetchScheduler &) = delete;
+
+        ~DepFetchScheduler();
+
+        /**
+         * @brief Sets the maximum number of fetches running at once.
+         *
+         * @param limit The limit (0 means one fetch per hardware thread)
+         */
+        void SetJobLimit(std::size_t limit);
+
+        /**
+         * @brief Sets the maximum number of fetches from a single pool running at once.
+         *
+         * @param pool The pool's name
+         * @param limit The limit
+         */
+        void SetPoolLimit(const std::string &pool, std::size_t limit);
+
+        /**
+         * @brief Schedules a fetch.
+         *
+         * @param pool The pool the fetch belongs to
+         * @param key A key uniquely identifying what is being fetched (usually the destination path)
+         * @param task The fetch itself
+         *
+         * @return std::shared_future<void> A future completed once the fetch is done; fetches already scheduled under
+         * the same key return the existing future, unless that fetch has failed
+         */
+        std::shared_future<void> Schedule(const std::string &pool, const std::string &key, Task task);
+
+        /**
+         * @brief Blocks until every scheduled fetch has finished.
+         *
+         * @throws Rethrows the first exception thrown by a fetch scheduled since the last call.
+         */
+        void Wait();
+
+    private:
+        struct Job
+        {
+            std::string pool;
+            std::packaged_task<void()> task;
+        };
+
+        std::mutex mMutex;
+        std::condition_variable mJobAvailable;
+
+        std::deque<Job> mQueue;
+        std::vector<std::thread> mThreads;
+
+        std::unordered_map<std::string, std::size_t> mPoolLimits;
+        std::unordered_map<std::string, std::size_t> mPoolRunning;
+
+        std::unordered_map<std::string, std::shared_future<void>> mScheduled;
+        std::vector<std::shared_future<void>> mPending;
+
+        std::size_t mJobLimit = 0;
+        std::size_t mIdle = 0;
+        bool mStopping = false;
+
+        void WorkerMain();
+        bool TryTakeJob(Job &out);
+    };
+
+    /**
+     * @brief Collects packages that a tool can install with a single invocation.
+     *
+     * Items are added while a round's fetches are being requested, and only scheduled as a single fetch once the
+     * batch is flushed: every item's future completes along with that fetch.
+     *
+     * Unlike DepFetchScheduler, batches must only be used from the thread that schedules fetches.
+     */
+    class DepFetchBatch
+    {
+    public:
+        using Task = std::function<void(const std::vector<std::string> &)>;
+
+        /**
+         * @brief Adds an item to the batch.
+         *
+         * @param item The item (usually a package name)
+         * @return std::shared_future<void> A future completed once the whole batch is fetched
+         */
+        std::shared_future<void> Add(const std::string &item);
+
+        /**
+         * @brief Schedules a fetch for all the items added since the last flush.
+         *
+         * @param scheduler The scheduler to run the fetch on
+         * @param pool The pool the fetch belongs to
+         * @param key A key identifying the batch
+         * @param task The fetch itself, which gets the batch's items
+         */
+        void Flush(DepFetchScheduler &scheduler, const std::string &pool, const std::string &key, Task task);
+
+        bool IsEmpty() const
+        {
+            return mItems.empty();
+        }
+
+    private:
+        std::vector<std::string> mItems;
+
+        std::shared_ptr<std::promise<void>> mPromise;
+        std::shared_future<void> mFuture;
+
+        std::size_t mFlushCount = 0;
+    };
+} // namespace re
@@ -1,8 +1,11 @@
 #pragma once
 #include "target.h"
 
+#include <future>
 #include <memory>
+#include <optional>
 #include <string_view>
+#include <vector>
 
 
 #include <re/fs.h>
@@ -12,6 +15,7 @@
 namespace re
 {
     class DepsVersionCache;
+    class DepFetchScheduler;
 
     struct IDepResolver
     {
@@ -19,6 +23,71 @@ namespace re
 
         virtual Target *ResolveTargetDependency(const Target &target, const TargetDependency &dep,
                                                 DepsVersionCache *cache) = 0;
+        /**
+         * @brief Starts fetching everything a dependency needs without resolving it yet.
+         *
+         * Called on the main thread before ResolveTargetDependency, which is still called afterwards to load the
+         * dependency's target once the fetch has completed. The fetch itself runs on one of the scheduler's threads.
+         *
+         * Fetches can take several steps: this is called again after the returned fetch completes, until there is
+         * nothing left to fetch.
+         *
+         * @param target The target to which the dependency belongs to
+         * @param dep The dependency to fetch
+         * @param cache The dependency version cache
+         * @param scheduler The scheduler to run the fetch on
+         *
+         * @return std::shared_future<void> The scheduled fetch, or an invalid future if there is nothing to fetch
+         */
+        virtual std::shared_future<void> FetchTargetDependencyAsync(const Target &target, const TargetDependency &dep,
+                                                                    DepsVersionCache *cache,
+                                                                    DepFetchScheduler &scheduler)
+        {
+            return {};
+        }
+
+        /**
+         * @brief Starts the fetches that FetchTargetDependencyAsync batched up instead of scheduling them right away.
+         *
+         * Called once all of a round's fetches have been requested, so that package managers that can install many
+         * packages at once only get invoked once per round.
+         *
+         * @param scheduler The scheduler to run the fetches on
+         */
+        virtual void FlushFetches(DepFetchScheduler &scheduler)
+        {
+        }
+
+        /**
+         * @brief Lists the versions a dependency can be resolved to.
+         *
+         * Used to pick a single version for all the dependencies on the same package before any of them is resolved.
+         *
+         * @param target The target to which the dependency belongs to
+         * @param dep The dependency to list the versions of
+         *
+         * @return std::optional<std::vector<std::string>> The available versions, or nothing if this resolver
+         * doesn't support versioned dependencies
+         */
+        virtual std::optional<std::vector<std::string>> GetAvailableVersions(const Target &target,
+                                                                             const TargetDependency &dep)
+        {
+            return std::nullopt;
+        }
+
+        /**
+         * @brief Drops a target this resolver loaded from its caches, so that resolving the same dependency again loads
+         * it anew.
+         *
+         * Called once a package is not used anymore, usually because its version has changed. The target must be kept
+         * alive: targets loaded along with it may still refer to it.
+         *
+         * @param target The package's root target
+         */
+        virtual void ForgetTarget(const Target *target)
+        {
+        }
+
         virtual Target *ResolveCoercedTargetDependency(const Target &target, const Target &dep)
         {
             return nullptr;
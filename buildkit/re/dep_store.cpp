@@ -0,0 +1,197 @@
+#include "dep_store.h"
+
+#include <re/error.h>
+#include <re/process_util.h>
+
+#include <fmt/format.h>
+
+#include <ulib/process.h>
+#include <ulib/string.h>
+
+#include <cctype>
+#include <optional>
+#include <random>
+
+namespace re
+{
+    namespace
+    {
+        std::string GetSafeEntryName(std::string_view name)
+        {
+            std::string result{name};
+
+            for (auto &c : result)
+                if (c == '/' || c == '\\' || c == ':' || c == '@' || c == ' ')
+                    c = '_';
+
+            return result;
+        }
+
+        fs::path GetTempPath(const fs::path &path)
+        {
+            auto temp = path;
+            temp += fmt::format(".tmp-{:x}", std::random_device{}());
+            return temp;
+        }
+
+        bool IsGitTag(const fs::path &repo, const std::string &name)
+        {
+            return RunProcessOrThrow("git", {}, {"git", "show-ref", "--verify", "--quiet", "refs/tags/" + name}, false,
+                                     false, repo) == 0;
+        }
+
+        std::optional<std::string> GetGitCommit(const fs::path &repo, const std::string &rev)
+        {
+            ulib::process process("git", {"-C", repo.u8string(), "rev-parse", "--verify", "--quiet", rev + "^{commit}"},
+                                  ulib::process::pipe_output | ulib::process::die_with_parent);
+
+            // Reading everything first keeps the process from blocking on a full pipe
+            ulib::string data = process.out().read_all();
+
+            if (process.wait() != 0)
+                return std::nullopt;
+
+            std::string commit = data;
+
+            while (!commit.empty() && std::isspace(static_cast<unsigned char>(commit.back())))
+                commit.pop_back();
+
+            if (commit.empty())
+                return std::nullopt;
+
+            return commit;
+        }
+    } // namespace
+
+    fs::path DepStore::GetEntryPath(std::string_view kind, std::string_view name) const
+    {
+        return mRoot / fs::path{std::string{kind}} / GetSafeEntryName(name);
+    }
+
+    fs::path DepStore::GetOrCreateEntry(std::string_view kind, std::string_view name,
+                                        const std::function<void(const fs::path &)> &populate)
+    {
+        auto path = GetEntryPath(kind, name);
+
+        if (fs::exists(path))
+            return path;
+
+        fs::create_directories(path.parent_path());
+
+        auto temp = GetTempPath(path);
+        std::error_code ec;
+
+        try
+        {
+            populate(temp);
+        }
+        catch (...)
+        {
+            fs::remove_all(temp, ec);
+            throw;
+        }
+
+        // Renaming over a non-empty directory fails: in that case another Re instance got there first and its entry
+        // is just as good as ours
+        fs::rename(temp, path, ec);
+
+        if (ec)
+        {
+            fs::remove_all(temp, ec);
+
+            if (!fs::exists(path))
+                RE_THROW Exception("failed to create dependency store entry '{}'", path.u8string());
+        }
+
+        return path;
+    }
+
+    fs::path DepStore::GetGitMirror(std::string_view url, bool update)
+    {
+        auto name = GetSafeEntryName(url);
+
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".git") != 0)
+            name += ".git";
+
+        std::shared_ptr<std::mutex> mirror_mutex;
+
+        {
+            std::lock_guard lock{mMutex};
+
+            auto &mutex = mMirrorMutexes[name];
+
+            if (!mutex)
+                mutex = std::make_shared<std::mutex>();
+
+            mirror_mutex = mutex;
+        }
+
+        // Different versions of the same repository can be fetched at once, but they all share its mirror
+        std::lock_guard lock{*mirror_mutex};
+
+        auto path = GetEntryPath("git-mirrors", name);
+
+        if (!fs::exists(path))
+        {
+            return GetOrCreateEntry("git-mirrors", name, [url](const fs::path &to) {
+                RunProcessOrThrow("git", {}, {"git", "clone", "--mirror", std::string{url}, to.u8string()}, false,
+                                  true);
+            });
+        }
+
+        if (update)
+            RunProcessOrThrow("git", {}, {"git", "fetch", "--prune"}, false, true, path);
+
+        return path;
+    }
+
+    std::string DepStore::ResolveGitCommit(std::string_view url, std::string_view branch)
+    {
+        auto rev = branch.empty() ? std::string{"HEAD"} : std::string{branch};
+
+        // Tags are not supposed to move, so a mirror that already has one can be trusted
+        if (!branch.empty())
+        {
+            auto mirror = GetGitMirror(url);
+
+            if (IsGitTag(mirror, rev))
+                if (auto commit = GetGitCommit(mirror, rev))
+                    return *commit;
+        }
+
+        // Branches do move: the mirror is brought up to date first
+        if (auto commit = GetGitCommit(GetGitMirror(url, true), rev))
+            return *commit;
+
+        RE_THROW Exception("'{}' does not name a commit in Git repository {}", rev, url);
+    }
+
+    void DepStore::CloneGitSnapshot(std::string_view url, std::string_view commit, const fs::path &to)
+    {
+        auto mirror = GetGitMirror(url);
+
+        // A plain local clone hardlinks or copies the mirror's objects: unlike --shared, the snapshot keeps working
+        // once the mirror prunes them
+        RunProcessOrThrow("git", {}, {"git", "clone", "--no-checkout", mirror.u8string(), to.u8string()}, false, true);
+
+        RunProcessOrThrow("git", {},
+                          {"git", "-c", "advice.detachedHead=false", "checkout", "--detach", std::string{commit}}, false,
+                          true, to);
+
+        // Keep the snapshot pointing at the real remote rather than the mirror
+        RunProcessOrThrow("git", {}, {"git", "remote", "set-url", "origin", std::string{url}}, false, true, to);
+    }
+
+    void DepStore::LinkEntry(const fs::path &entry, const fs::path &link)
+    {
+        fs::remove_all(link);
+        fs::create_directories(link.parent_path());
+
+        std::error_code ec;
+        fs::create_directory_symlink(entry, link, ec);
+
+        // Symlinks can require extra privileges on Windows
+        if (ec)
+            fs::copy(entry, link, fs::copy_options::recursive | fs::copy_options::copy_symlinks);
+    }
+} // namespace re
@@ -0,0 +1,116 @@
+/**
+ * @file re/dep_store.h
+ * @brief Machine-wide content-addressed dependency store
+ */
+
+#pragma once
+#include <re/fs.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace re
+{
+    /**
+     * @brief A dependency store shared by every project (and every worktree of a project) on the machine.
+     *
+     * The store keeps immutable entries, each one named after everything that determines its contents (package name,
+     * version, configuration). Entries are created once, in a temporary directory that is renamed into place when
+     * complete, so concurrent Re instances never see half-written entries. Project `.re-cache` directories then
+     * link to these entries instead of holding their own copies.
+     *
+     * Git dependencies additionally share a bare mirror per repository. Snapshots are keyed by commit and cloned from
+     * the mirror locally, so only the mirror ever hits the network.
+     */
+    class DepStore
+    {
+    public:
+        /**
+         * @brief Construct a new DepStore object.
+         *
+         * Nothing is created on disk until the store is actually used.
+         *
+         * @param root The store's root directory
+         */
+        explicit DepStore(const fs::path &root) : mRoot{root}
+        {
+        }
+
+        const fs::path &GetRoot() const
+        {
+            return mRoot;
+        }
+
+        /**
+         * @brief Gets the path of an entry, whether it exists or not.
+         *
+         * @param kind The kind of entry (e.g. "git" or "conan")
+         * @param name The entry's name
+         */
+        fs::path GetEntryPath(std::string_view kind, std::string_view name) const;
+
+        /**
+         * @brief Gets an entry, creating it first if it doesn't exist yet.
+         *
+         * @param kind The kind of entry (e.g. "git" or "conan")
+         * @param name The entry's name
+         * @param populate Fills a directory with the entry's contents
+         *
+         * @return fs::path The entry's path
+         */
+        fs::path GetOrCreateEntry(std::string_view kind, std::string_view name,
+                                  const std::function<void(const fs::path &)> &populate);
+
+        /**
+         * @brief Gets the shared bare mirror of a Git repository, cloning it first if needed.
+         *
+         * @param url The repository's URL
+         * @param update Fetch the latest refs into an already existing mirror
+         *
+         * @return fs::path The mirror's path
+         */
+        fs::path GetGitMirror(std::string_view url, bool update = false);
+
+        /**
+         * @brief Resolves a branch or tag of a Git repository to a commit using its shared mirror.
+         *
+         * Branches (and the default branch) are fetched into the mirror first, so that they never get stuck at the
+         * commit they pointed to the first time they were used.
+         *
+         * @param url The repository's URL
+         * @param branch The branch or tag to resolve (empty for the default branch)
+         *
+         * @return std::string The commit's SHA
+         */
+        std::string ResolveGitCommit(std::string_view url, std::string_view branch);
+
+        /**
+         * @brief Checks out a snapshot of a Git repository from its shared mirror.
+         *
+         * @param url The repository's URL
+         * @param commit The commit to check out, as returned by ResolveGitCommit()
+         * @param to The directory to check out to
+         */
+        void CloneGitSnapshot(std::string_view url, std::string_view commit, const fs::path &to);
+
+        /**
+         * @brief Makes a path point to a store entry, replacing whatever was there.
+         *
+         * Uses a directory symlink where possible and falls back to copying the entry otherwise.
+         *
+         * @param entry The store entry
+         * @param link The path that should point to it
+         */
+        static void LinkEntry(const fs::path &entry, const fs::path &link);
+
+    private:
+        fs::path mRoot;
+
+        std::mutex mMutex;
+        std::unordered_map<std::string, std::shared_ptr<std::mutex>> mMirrorMutexes;
+    };
+} // namespace re
@@ -0,0 +1,139 @@
+#include "dep_version_solver.h"
+
+#include <re/deps_version_cache.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+namespace re
+{
+    void DepVersionSolver::AddRequirement(const Target &target, TargetDependency &dep)
+    {
+        if (dep.ns.empty() || dep.version_kind == DependencyVersionKind::RawTag)
+            return;
+
+        mRequirements[fmt::format("{}:{}", dep.ns, dep.name)].push_back({&target, &dep});
+        mRequirementCount++;
+
+        std::string key = DepsVersionCache::GetLockKey(dep);
+        mSeenPins.emplace(std::move(key), &dep);
+    }
+
+    std::vector<TargetDependency *> DepVersionSolver::Solve()
+    {
+        std::vector<TargetDependency *> changed;
+
+        mLivePins.clear();
+
+        for (auto &[id, requirements] : mRequirements)
+        {
+            for (auto &requirement : requirements)
+            {
+                std::string key = DepsVersionCache::GetLockKey(*requirement.dep);
+                mLivePins.insert(std::move(key));
+            }
+
+            auto version = SolvePackage(id, requirements);
+
+            if (!version)
+                continue;
+
+            for (auto &requirement : requirements)
+            {
+                if (mCache.GetLockedVersion(*requirement.dep) == version)
+                    continue;
+
+                mCache.SetLockedVersion(*requirement.dep, *version);
+
+                if (!requirement.dep->resolved.empty())
+                    changed.push_back(requirement.dep);
+            }
+        }
+
+        mRequirements.clear();
+        mRequirementCount = 0;
+
+        return changed;
+    }
+
+    void DepVersionSolver::DropStalePins()
+    {
+        for (auto &[key, dep] : mSeenPins)
+            if (mLivePins.find(key) == mLivePins.end())
+                mCache.RemoveLockedVersion(*dep);
+
+        mSeenPins.clear();
+    }
+
+    std::optional<std::string> DepVersionSolver::SolvePackage(const std::string &id,
+                                                              const std::vector<Requirement> &requirements)
+    {
+        auto satisfies_all = [&requirements](const std::string &version) {
+            return std::all_of(requirements.begin(), requirements.end(), [&version](const Requirement &requirement) {
+                return DepsVersionCache::MatchesRequirements(*requirement.dep, version);
+            });
+        };
+
+        // Versions that are already pinned are kept as long as they work for everyone, so that adding a requirement
+        // doesn't upgrade a package behind the user's back
+        std::vector<std::string> pinned;
+
+        for (auto &requirement : requirements)
+            if (auto version = mCache.GetLockedVersion(*requirement.dep); version && satisfies_all(*version))
+                pinned.push_back(*version);
+
+        if (pinned.size() == requirements.size() &&
+            std::all_of(pinned.begin(), pinned.end(), [&pinned](const std::string &v) { return v == pinned.front(); }))
+            return pinned.front();
+
+        auto it = mAvailableVersions.find(id);
+
+        if (it == mAvailableVersions.end())
+            it = mAvailableVersions.emplace(id, mLister(*requirements.front().target, *requirements.front().dep)).first;
+
+        // The resolver doesn't do versions: every requirement gets resolved on its own
+        if (!it->second)
+            return std::nullopt;
+
+        auto &available = *it->second;
+
+        std::vector<std::string> candidates;
+        std::copy_if(available.begin(), available.end(), std::back_inserter(candidates), satisfies_all);
+
+        auto newest_first = [](const std::string &a, const std::string &b) {
+            return semverpp::version{a} > semverpp::version{b};
+        };
+
+        if (candidates.empty())
+        {
+            std::string details;
+
+            for (auto &requirement : requirements)
+            {
+                std::vector<std::string> matching;
+                std::copy_if(available.begin(), available.end(), std::back_inserter(matching),
+                             [&requirement](const std::string &version) {
+                                 return DepsVersionCache::MatchesRequirements(*requirement.dep, version);
+                             });
+
+                std::sort(matching.begin(), matching.end(), newest_first);
+
+                details += fmt::format("\n    '{}' wants '{}' ({})", requirement.target->module, requirement.dep->raw,
+                                       matching.empty() ? "no available version matches"
+                                                        : fmt::format("newest match: {}", matching.front()));
+            }
+
+            RE_THROW TargetDependencyException(requirements.front().target,
+                                               "no version of '{}' satisfies all of its requirements:{}", id, details);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), newest_first);
+
+        for (auto &candidate : candidates)
+            if (std::find(pinned.begin(), pinned.end(), candidate) != pinned.end())
+                return candidate;
+
+        return candidates.front();
+    }
+} // namespace re
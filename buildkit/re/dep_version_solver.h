@@ -0,0 +1,105 @@
+/**
+ * @file re/dep_version_solver.h
+ * @brief Whole-graph dependency version unification
+ */
+
+#pragma once
+#include "target.h"
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace re
+{
+    class DepsVersionCache;
+
+    /**
+     * @brief Picks a single version for every package that several targets depend on with different version
+     * requirements.
+     *
+     * Without this, `github:org/lib ^1.2` and `github:org/lib ~1.4` are resolved separately and can end up as two
+     * different versions of the same library, each cloned, loaded and built on its own. The solver collects every
+     * requirement on a package across the whole dependency graph, picks the newest version that satisfies all of them
+     * and pins it for each requirement in the DepsVersionCache.
+     *
+     * Only ranged requirements take part in this: dependencies on raw tags or branches are resolved as they are.
+     */
+    class DepVersionSolver
+    {
+    public:
+        using VersionLister =
+            std::function<std::optional<std::vector<std::string>>(const Target &, const TargetDependency &)>;
+
+        /**
+         * @brief Construct a new DepVersionSolver object.
+         *
+         * @param cache The cache to pin the picked versions in
+         * @param lister Lists the versions available for a dependency (or nothing if it isn't versioned)
+         */
+        DepVersionSolver(DepsVersionCache &cache, VersionLister lister) : mCache{cache}, mLister{std::move(lister)}
+        {
+        }
+
+        /**
+         * @brief Adds a dependency's version requirements to the next Solve() call.
+         *
+         * @param target The target to which the dependency belongs to
+         * @param dep The dependency
+         */
+        void AddRequirement(const Target &target, TargetDependency &dep);
+
+        /**
+         * @brief Picks a version for every package that has requirements and pins it for all of them.
+         *
+         * The collected requirements are cleared afterwards, while listed versions are kept for later calls.
+         *
+         * @throws TargetDependencyException Thrown if no version satisfies all the requirements on a package
+         *
+         * @return std::vector<TargetDependency *> The already resolved dependencies whose version has changed
+         */
+        std::vector<TargetDependency *> Solve();
+
+        /**
+         * @brief Unpins the requirements that were seen by earlier Solve() calls but not by the last one.
+         *
+         * Those belonged to packages that are not part of the graph anymore, like the dependencies of a version that
+         * got replaced: the last call must have seen the whole graph.
+         */
+        void DropStalePins();
+
+        /**
+         * @brief Gets the number of requirements collected for the next Solve() call.
+         */
+        std::size_t GetRequirementCount() const
+        {
+            return mRequirementCount;
+        }
+
+    private:
+        struct Requirement
+        {
+            const Target *target;
+            TargetDependency *dep;
+        };
+
+        DepsVersionCache &mCache;
+        VersionLister mLister;
+
+        // Ordered to keep the lock file and error messages deterministic
+        std::map<std::string, std::vector<Requirement>> mRequirements;
+        std::size_t mRequirementCount = 0;
+
+        std::unordered_map<std::string, std::optional<std::vector<std::string>>> mAvailableVersions;
+
+        // Every requirement seen so far by lock key, and the lock keys seen by the last Solve() call
+        std::unordered_map<std::string, const TargetDependency *> mSeenPins;
+        std::unordered_set<std::string> mLivePins;
+
+        std::optional<std::string> SolvePackage(const std::string &id, const std::vector<Requirement> &requirements);
+    };
+} // namespace re
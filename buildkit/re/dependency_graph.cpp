@@ -0,0 +1,141 @@
+#include "dependency_graph.h"
+
+#include <re/error.h>
+
+namespace re
+{
+    void DependencyGraph::Invalidate()
+    {
+        mNodes.clear();
+        mEdges.clear();
+        mIds.clear();
+        mClosures.clear();
+    }
+
+    const std::vector<Target *> &DependencyGraph::GetBuildOrder(const Target &target)
+    {
+        return GetClosure(target).build_order;
+    }
+
+    std::vector<Target *> DependencyGraph::GetDependencySet(const Target &target)
+    {
+        auto &closure = GetClosure(target);
+
+        if (closure.unresolved_dep)
+            RE_THROW TargetDependencyException(closure.unresolved_target, "unresolved dependency '{}'",
+                                               closure.unresolved_dep->ToString());
+
+        return closure.discovery_order;
+    }
+
+    bool DependencyGraph::IsFullyResolved(const Target &target)
+    {
+        return !GetClosure(target).unresolved_dep;
+    }
+
+    bool DependencyGraph::DependsOn(const Target &target, const Target &dependency)
+    {
+        auto &closure = GetClosure(target);
+        auto it = mIds.find(&dependency);
+
+        if (it == mIds.end())
+            return false;
+
+        auto id = it->second;
+
+        // Nodes added after the closure was computed can't be reachable from it
+        if (id / 64 >= closure.reachable.size())
+            return false;
+
+        return closure.reachable[id / 64] & (std::uint64_t{1} << (id % 64));
+    }
+
+    DependencyGraph::NodeId DependencyGraph::AddNode(const Target &target)
+    {
+        if (auto it = mIds.find(&target); it != mIds.end())
+            return it->second;
+
+        auto id = static_cast<NodeId>(mNodes.size());
+        mIds.emplace(&target, id);
+
+        // The graph itself never modifies targets, but the dependency sets it hands out are used to modify them
+        mNodes.emplace_back().target = const_cast<Target *>(&target);
+
+        std::vector<NodeId> edges;
+        const TargetDependency *unresolved = nullptr;
+
+        auto enabled = !target.resolved_config.is_map() || target.resolved_config["enabled"].get<bool>();
+
+        if (enabled)
+        {
+            for (auto &dep : target.dependencies)
+            {
+                if (dep.resolved.empty() && !unresolved)
+                    unresolved = &dep;
+
+                for (auto resolved : dep.resolved)
+                    edges.push_back(AddNode(*resolved));
+            }
+
+            for (auto &child : target.children)
+                edges.push_back(AddNode(*child));
+        }
+
+        // Adding the neighbors might have reallocated the node list
+        auto &node = mNodes[id];
+
+        node.enabled = enabled;
+        node.unresolved = unresolved;
+
+        node.edges_begin = static_cast<std::uint32_t>(mEdges.size());
+        mEdges.insert(mEdges.end(), edges.begin(), edges.end());
+        node.edges_end = static_cast<std::uint32_t>(mEdges.size());
+
+        return id;
+    }
+
+    const DependencyGraph::Closure &DependencyGraph::GetClosure(const Target &target)
+    {
+        auto root = AddNode(target);
+
+        if (mClosures.size() < mNodes.size())
+            mClosures.resize(mNodes.size());
+
+        if (mClosures[root])
+            return *mClosures[root];
+
+        auto closure = std::make_unique<Closure>();
+        closure->reachable.resize((mNodes.size() + 63) / 64);
+
+        auto visit = [this, &closure](auto &self, NodeId id) -> void {
+            auto &bits = closure->reachable[id / 64];
+            auto mask = std::uint64_t{1} << (id % 64);
+
+            if (bits & mask)
+                return;
+
+            auto &node = mNodes[id];
+
+            if (!node.enabled)
+                return;
+
+            bits |= mask;
+            closure->discovery_order.push_back(node.target);
+
+            if (node.unresolved && !closure->unresolved_dep)
+            {
+                closure->unresolved_target = node.target;
+                closure->unresolved_dep = node.unresolved;
+            }
+
+            for (auto edge = node.edges_begin; edge != node.edges_end; edge++)
+                self(self, mEdges[edge]);
+
+            closure->build_order.push_back(node.target);
+        };
+
+        visit(visit, root);
+
+        return *(mClosures[root] = std::move(closure));
+    }
+} // namespace re
@@ -0,0 +1,128 @@
+/**
+ * @file re/dependency_graph.h
+ * @brief Indexed target dependency graph with memoized dependency sets
+ */
+
+#pragma once
+#include "target.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief A flat, indexed view of the dependency relations between loaded targets.
+     *
+     * Targets get dense integer IDs the first time they are reached and their outgoing edges (resolved dependencies
+     * followed by child targets, in config order) are stored in a single flat array. Each target's dependency set
+     * is computed once, as both orderings the build needs plus a reachability bitset, and kept until Invalidate() is
+     * called.
+     *
+     * Disabled targets (`enabled: false` in their resolved config) are left out along with everything only
+     * reachable through them, just like in PopulateTargetDependencySet.
+     *
+     * The graph does not track target changes on its own: whoever resolves dependencies, loads child targets or
+     * resolves target configs must call Invalidate().
+     */
+    class DependencyGraph
+    {
+    public:
+        using NodeId = std::uint32_t;
+
+        /**
+         * @brief Drops all nodes and memoized dependency sets.
+         */
+        void Invalidate();
+
+        /**
+         * @brief Gets a target's dependency set in build order.
+         *
+         * Dependencies and their children always come before their dependents and the target itself is last. This
+         * is the same order PopulateTargetDependencySet produces. Unresolved dependencies are skipped.
+         *
+         * @param target The target to get the dependency set of
+         * @return const std::vector<Target *>& The dependency set, valid until the graph is invalidated
+         */
+        const std::vector<Target *> &GetBuildOrder(const Target &target);
+
+        /**
+         * @brief Gets a target's dependency set in discovery order.
+         *
+         * The target itself comes first, followed by its dependencies and children depth-first. This is the same
+         * order PopulateTargetDependencySetNoResolve produces.
+         *
+         * Returned by value: language providers hold on to it while generating, which may resolve target configs and
+         * invalidate the graph.
+         *
+         * @param target The target to get the dependency set of
+         * @return std::vector<Target *> The dependency set
+         *
+         * @throws TargetDependencyException Thrown if a dependency in the set is unresolved.
+         */
+        std::vector<Target *> GetDependencySet(const Target &target);
+
+        /**
+         * @brief Checks whether every dependency reachable from a target is resolved.
+         *
+         * @param target The target to check
+         * @return true If there are no unresolved dependencies in the target's dependency set
+         */
+        bool IsFullyResolved(const Target &target);
+
+        /**
+         * @brief Checks whether a target is part of another target's dependency set.
+         *
+         * @param target The dependent target
+         * @param dependency The target to look for
+         * @return true If the dependency is reachable from the target (a target is always part of its own set)
+         */
+        bool DependsOn(const Target &target, const Target &dependency);
+
+        /**
+         * @brief Gets the number of targets currently indexed.
+         */
+        std::size_t GetNodeCount() const
+        {
+            return mNodes.size();
+        }
+
+    private:
+        struct Node
+        {
+            Target *target = nullptr;
+
+            bool enabled = true;
+
+            /**
+             * @brief The target's first unresolved dependency, if any.
+             */
+            const TargetDependency *unresolved = nullptr;
+
+            std::uint32_t edges_begin = 0;
+            std::uint32_t edges_end = 0;
+        };
+
+        struct Closure
+        {
+            std::vector<std::uint64_t> reachable;
+
+            std::vector<Target *> build_order;
+            std::vector<Target *> discovery_order;
+
+            const Target *unresolved_target = nullptr;
+            const TargetDependency *unresolved_dep = nullptr;
+        };
+
+        std::vector<Node> mNodes;
+        std::vector<NodeId> mEdges;
+
+        std::unordered_map<const Target *, NodeId> mIds;
+        std::vector<std::unique_ptr<Closure>> mClosures;
+
+        NodeId AddNode(const Target &target);
+        const Closure &GetClosure(const Target &target);
+    };
+} // namespace re
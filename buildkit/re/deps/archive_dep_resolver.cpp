@@ -0,0 +1,378 @@
+#include "archive_dep_resolver.h"
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+#include <openssl/evp.h>
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <magic_enum/magic_enum.hpp>
+
+#include <re/dep_fetch_scheduler.h>
+#include <re/deps_version_cache.h>
+#include <re/process_util.h>
+#include <re/yaml_merge.h>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+
+namespace re
+{
+    namespace
+    {
+        class Sha256
+        {
+        public:
+            Sha256() : mContext{EVP_MD_CTX_new()}
+            {
+                EVP_DigestInit_ex(mContext, EVP_sha256(), nullptr);
+            }
+
+            ~Sha256()
+            {
+                EVP_MD_CTX_free(mContext);
+            }
+
+            Sha256(const Sha256 &) = delete;
+            Sha256 &operator=(const Sha256 &) = delete;
+
+            void Update(const char *data, std::size_t size)
+            {
+                EVP_DigestUpdate(mContext, data, size);
+            }
+
+            std::string Finish()
+            {
+                unsigned char digest[EVP_MAX_MD_SIZE];
+                unsigned int size = 0;
+
+                EVP_DigestFinal_ex(mContext, digest, &size);
+
+                std::string result;
+
+                for (unsigned int i = 0; i < size; i++)
+                    result += fmt::format("{:02x}", digest[i]);
+
+                return result;
+            }
+
+        private:
+            EVP_MD_CTX *mContext;
+        };
+
+        // Streams the response to a file, hashing it on the way: archives never have to fit in memory
+        void DownloadFile(const std::string &url, const fs::path &to, Sha256 &hash)
+        {
+            auto scheme_end = url.find("://");
+
+            if (scheme_end == url.npos)
+                RE_THROW Exception("Invalid archive URL '{}'", url);
+
+            auto path_start = url.find('/', scheme_end + 3);
+
+            httplib::Client client{url.substr(0, path_start)};
+
+            // Release downloads are usually redirected to some CDN
+            client.set_follow_location(true);
+
+            std::ofstream file{to, std::ios::binary};
+
+            if (!file)
+                RE_THROW Exception("Failed to download '{}': cannot write to '{}'", url, to.generic_u8string());
+
+            int status = 0;
+
+            auto response = client.Get(
+                path_start == url.npos ? "/" : url.substr(path_start),
+                [&status](const httplib::Response &response) {
+                    status = response.status;
+                    return status >= 200 && status <= 299;
+                },
+                [&file, &hash](const char *data, std::size_t size) {
+                    file.write(data, size);
+                    hash.Update(data, size);
+
+                    return file.good();
+                });
+
+            if (status != 0 && (status < 200 || status > 299))
+                RE_THROW Exception("Failed to download '{}': HTTP {}", url, status);
+
+            if (!response)
+                RE_THROW Exception("Failed to download '{}': HTTP request failed [.{}]", url,
+                                   magic_enum::enum_name(response.error()));
+        }
+    } // namespace
+
+    Target *ArchiveDepResolver::ResolveTargetDependency(const Target &target, const TargetDependency &dep,
+                                                        DepsVersionCache *cache)
+    {
+        auto url = GetArchiveUrl(dep);
+
+        auto [scope, context] = target.GetBuildVarScope();
+
+        auto re_arch = scope.ResolveLocal("arch");
+        auto re_platform = scope.ResolveLocal("platform");
+        auto re_config = scope.ResolveLocal("configuration");
+
+        auto triplet = fmt::format("{}-{}-{}", re_arch, re_platform, re_config);
+
+        if (dep.extra_config_hash)
+            triplet += fmt::format("-ecfg-{}", dep.extra_config_hash);
+
+        auto cache_dir = target.root_path / ".re-cache" / "archives";
+        auto hash = GetKnownHash(dep, url, cache);
+
+        auto dep_str = dep.ToString();
+
+        if (!hash || !fs::exists(cache_dir / *hash))
+        {
+            if (scope.ResolveLocal("auto-load-uncached-deps") != "true")
+                RE_THROW TargetUncachedDependencyException(
+                    &target, "Cannot resolve uncached dependency {} - autoloading is disabled", dep_str);
+
+            mOut->Info(fmt::emphasis::bold | fg(fmt::color::light_blue), "[{}] Restoring package {}...\n",
+                       target.module, dep_str);
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+
+            try
+            {
+                hash = RestoreArchive(url, hash, cache_dir);
+            }
+            catch (const Exception &e)
+            {
+                RE_THROW TargetDependencyException(&target, "{}: {}", dep_str, e.what());
+            }
+
+            auto end_time = std::chrono::high_resolution_clock::now();
+
+            mOut->Info(fmt::emphasis::bold | fg(fmt::color::light_blue), "\n[{}] Restored package {} ({:.2f}s)\n",
+                       target.module, dep_str,
+                       std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() / 1000.f);
+        }
+        else
+        {
+            mOut->Info(fmt::emphasis::bold | fg(fmt::color::light_blue), "[{}] Package {} already available\n",
+                       target.module, dep_str);
+        }
+
+        if (cache)
+            cache->SetLockedHash(dep, *hash);
+
+        auto path = cache_dir / *hash;
+        auto cutout = GetCutoutPath(target, dep);
+
+        if (!cutout.empty())
+            path /= cutout;
+
+        auto &result = mTargetCache[fmt::format("{}-{}{}", *hash, triplet, cutout.generic_u8string())];
+
+        if (result)
+            return result.get();
+
+        result = mLoader->LoadFreeTarget(path, &target, &dep);
+
+        result->root_path = target.root_path;
+
+        result->config["arch"] = re_arch;
+        result->config["platform"] = re_platform;
+        result->config["configuration"] = re_config;
+
+        if (!dep.extra_config.is_null())
+            MergeYamlNode(result->config, dep.extra_config);
+
+        result->var_parent = target.var_parent;
+        result->local_var_ctx = context;
+        result->build_var_scope.emplace(&result->local_var_ctx, "build", &scope);
+
+        result->module = fmt::format("archive.{}.{}", triplet, result->module);
+
+        result->LoadDependencies();
+        result->LoadMiscConfig();
+        result->LoadSourceTree();
+
+        mLoader->RegisterLocalTarget(result.get());
+        return result.get();
+    }
+
+    std::shared_future<void> ArchiveDepResolver::FetchTargetDependencyAsync(const Target &target,
+                                                                            const TargetDependency &dep,
+                                                                            DepsVersionCache *cache,
+                                                                            DepFetchScheduler &scheduler)
+    {
+        auto url = GetArchiveUrl(dep);
+
+        auto cache_dir = target.root_path / ".re-cache" / "archives";
+        auto hash = GetKnownHash(dep, url, cache);
+
+        // Once the archive is extracted, loading it can be prepared (a CMake project gets configured, for instance)
+        if (hash && fs::exists(cache_dir / *hash))
+        {
+            auto path = cache_dir / *hash;
+            auto cutout = GetCutoutPath(target, dep);
+
+            if (!cutout.empty())
+                path /= cutout;
+
+            return mLoader->PrepareFreeTargetAsync(path, &target, &dep, scheduler);
+        }
+
+        auto [scope, context] = target.GetBuildVarScope();
+
+        // ResolveTargetDependency reports this properly
+        if (scope.ResolveLocal("auto-load-uncached-deps") != "true")
+            return {};
+
+        mOut->Info(fmt::emphasis::bold | fg(fmt::color::light_blue), "[{}] Restoring package {}...\n", target.module,
+                   dep.ToString());
+
+        return scheduler.Schedule("archive", url, [this, url, hash, cache_dir] {
+            auto result = RestoreArchive(url, hash, cache_dir);
+
+            std::lock_guard lock{mMutex};
+            mFetchedHashes[url] = result;
+        });
+    }
+
+    void ArchiveDepResolver::ForgetTarget(const Target *target)
+    {
+        for (auto it = mTargetCache.begin(); it != mTargetCache.end(); it++)
+        {
+            if (it->second.get() == target)
+            {
+                mForgottenTargets.emplace_back(std::move(it->second));
+                mTargetCache.erase(it);
+                return;
+            }
+        }
+    }
+
+    std::string ArchiveDepResolver::RestoreArchive(const std::string &url,
+                                                   const std::optional<std::string> &expected_hash,
+                                                   const fs::path &cache_dir)
+    {
+        fs::create_directories(cache_dir);
+
+        // Several fetches (or Re instances) can be restoring the same archive at once
+        auto temp_name = fmt::format(".tmp-{:x}", std::random_device{}());
+
+        auto download_path = cache_dir / (temp_name + ".archive");
+        auto extract_path = cache_dir / (temp_name + ".d");
+
+        auto cleanup = [&download_path, &extract_path] {
+            std::error_code ec;
+
+            fs::remove(download_path, ec);
+            fs::remove_all(extract_path, ec);
+        };
+
+        try
+        {
+            Sha256 sha256;
+            DownloadFile(url, download_path, sha256);
+
+            auto hash = sha256.Finish();
+
+            if (expected_hash && *expected_hash != hash)
+                RE_THROW Exception("SHA-256 mismatch for '{}': expected {} (from the lock file), got {}", url,
+                                   *expected_hash, hash);
+
+            auto final_path = cache_dir / hash;
+
+            if (!fs::exists(final_path))
+            {
+                fs::create_directories(extract_path);
+
+                ulib::list<ulib::string> cmdline = {"cmake", "-E", "tar", "xf"};
+                cmdline.emplace_back(download_path.u8string());
+
+                // CMake's bundled libarchive reads every common archive format on every platform
+                RunProcessOrThrow("cmake", {}, cmdline, false, true, extract_path);
+
+                auto root = extract_path;
+
+                std::vector<fs::path> entries{fs::directory_iterator{extract_path}, fs::directory_iterator{}};
+
+                // Release tarballs keep everything in a single `name-version/` directory
+                if (entries.size() == 1 && fs::is_directory(entries.front()))
+                    root = entries.front();
+
+                std::error_code ec;
+                fs::rename(root, final_path, ec);
+
+                if (ec && !fs::exists(final_path))
+                    RE_THROW Exception("Failed to move the contents of '{}' to '{}': {}", url,
+                                       final_path.generic_u8string(), ec.message());
+            }
+
+            cleanup();
+            return hash;
+        }
+        catch (...)
+        {
+            cleanup();
+            throw;
+        }
+    }
+
+    std::string ArchiveDepResolver::GetArchiveUrl(const TargetDependency &dep)
+    {
+        // `http://host/path` parses as the `http` namespace with `//host/path` as the name
+        std::string url = dep.ns == "archive" ? std::string{dep.name} : fmt::format("{}:{}", dep.ns, dep.name);
+
+        if (dep.version.empty())
+            return url;
+
+        constexpr std::string_view kVersionPlaceholder = "{version}";
+
+        for (auto pos = url.find(kVersionPlaceholder); pos != url.npos;
+             pos = url.find(kVersionPlaceholder, pos + dep.version.size()))
+            url.replace(pos, kVersionPlaceholder.size(), std::string{dep.version});
+
+        return url;
+    }
+
+    std::optional<std::string> ArchiveDepResolver::GetKnownHash(const TargetDependency &dep, const std::string &url,
+                                                                DepsVersionCache *cache)
+    {
+        if (cache)
+            if (auto hash = cache->GetLockedHash(dep))
+                return hash;
+
+        std::lock_guard lock{mMutex};
+
+        if (auto it = mFetchedHashes.find(url); it != mFetchedHashes.end())
+            return it->second;
+
+        return std::nullopt;
+    }
+
+    fs::path ArchiveDepResolver::GetCutoutPath(const Target &target, const TargetDependency &dep)
+    {
+        if (dep.filters.empty() || dep.filters[0].front() != '/')
+            return {};
+
+        auto cutout = fs::u8path(std::string{dep.filters[0].substr(1)}).lexically_normal();
+
+        // The cutout is appended to the extracted archive's path, which it must never leave
+        auto escapes = cutout.has_root_name() || cutout.has_root_directory() ||
+                       std::any_of(cutout.begin(), cutout.end(), [](const fs::path &part) { return part == ".."; });
+
+        if (escapes)
+            RE_THROW TargetDependencyException(&target, "{}: cutout path '{}' points outside of the archive",
+                                               dep.ToString(), dep.filters[0]);
+
+        // "[/]" and "[/dir/]" mean the archive root and "dir" respectively
+        if (cutout == ".")
+            return {};
+
+        if (!cutout.has_filename())
+            cutout = cutout.parent_path();
+
+        return cutout;
+    }
+} // namespace re
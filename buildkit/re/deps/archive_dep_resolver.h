@@ -0,0 +1,81 @@
+/**
+ * @file re/deps/archive_dep_resolver.h
+ * @brief Dependencies on source archives downloaded over HTTP
+ */
+
+#pragma once
+#include <re/dep_resolver.h>
+#include <re/target.h>
+#include <re/target_loader.h>
+#include <re/user_output.h>
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief Resolves dependencies on source archives (.tar.gz, .tar.xz, .tar.zst, .zip): `archive:<url>`, or simply
+     * `http://...`/`https://...`.
+     *
+     * A `{version}` placeholder in the URL is replaced with the dependency's tag, as in
+     * `archive:https://example.com/lib-{version}.tar.gz @1.2.0`.
+     *
+     * The archive's SHA-256 is pinned in the lock file the first time it is downloaded, and every later download has
+     * to match it. Archives are extracted into a content-addressed cache (`.re-cache/archives/<sha256>`), so an
+     * archive whose hash is pinned and already extracted is never downloaded again. If the archive's only top-level
+     * entry is a directory, as with most release tarballs, that directory becomes the dependency's root.
+     */
+    class ArchiveDepResolver : public IDepResolver
+    {
+    public:
+        ArchiveDepResolver(ITargetLoader *pLoader, IUserOutput *pOut) : mLoader{pLoader}, mOut{pOut}
+        {
+        }
+
+        Target *ResolveTargetDependency(const Target &target, const TargetDependency &dep, DepsVersionCache *cache);
+
+        std::shared_future<void> FetchTargetDependencyAsync(const Target &target, const TargetDependency &dep,
+                                                            DepsVersionCache *cache, DepFetchScheduler &scheduler);
+
+        void ForgetTarget(const Target *target);
+
+        /**
+         * @brief Downloads an archive and extracts it into a content-addressed cache directory.
+         *
+         * Only touches the file system, so it can run on a DepFetchScheduler.
+         *
+         * @param url The archive's URL
+         * @param expected_hash The SHA-256 the archive must have, if it is known
+         * @param cache_dir The directory the archive gets extracted into a subdirectory of
+         *
+         * @throws Exception Thrown if the download fails or the archive's hash doesn't match
+         *
+         * @return std::string The archive's SHA-256, which is also the name of its subdirectory
+         */
+        std::string RestoreArchive(const std::string &url, const std::optional<std::string> &expected_hash,
+                                   const fs::path &cache_dir);
+
+    private:
+        ITargetLoader *mLoader;
+        IUserOutput *mOut;
+
+        std::unordered_map<std::string, std::unique_ptr<Target>> mTargetCache;
+
+        // Forgotten targets stay alive: targets loaded along with them may still refer to them
+        std::vector<std::unique_ptr<Target>> mForgottenTargets;
+
+        // Hashes of the archives downloaded by fetches, by URL: the lock file is only updated on the main thread
+        std::mutex mMutex;
+        std::unordered_map<std::string, std::string> mFetchedHashes;
+
+        std::string GetArchiveUrl(const TargetDependency &dep);
+        std::optional<std::string> GetKnownHash(const TargetDependency &dep, const std::string &url,
+                                                DepsVersionCache *cache);
+
+        fs::path GetCutoutPath(const Target &target, const TargetDependency &dep);
+    };
+} // namespace re
@@ -1,5 +1,7 @@
 #include "conan_dep_resolver.h"
 
+#include <re/dep_fetch_scheduler.h>
+#include <re/dep_store.h>
 #include <re/process_util.h>
 #include <re/target_cfg_utils.h>
 #include <re/yaml_merge.h>
@@ -12,6 +14,99 @@
 
 namespace re
 {
+    namespace
+    {
+        std::string GetConanReference(const TargetDependency &dep)
+        {
+            std::string reference = fmt::format("{}/", dep.name);
+
+            if (dep.version_kind == DependencyVersionKind::RawTag)
+            {
+                if (dep.version.empty() || dep.version == "latest")
+                    reference += "[>=0.0.1]";
+                else
+                    reference += std::string_view{dep.version};
+            }
+            else
+            {
+                reference += fmt::format("[{}{}]", dep.version_kind_str, dep.version);
+            }
+
+            return reference;
+        }
+
+        std::vector<std::string> GetConanOptions(const Target &target, const TargetDependency &dep)
+        {
+            auto [scope, context] = target.GetBuildVarScope();
+
+            std::vector<std::string> options;
+
+            for (auto &filter : dep.filters)
+            {
+                auto s = scope.Resolve(filter);
+
+                if (s.find("=") == std::string::npos)
+                {
+                    if (s[0] == '!')
+                    {
+                        s = s.substr(1);
+                        s += " = False";
+                    }
+                    else
+                    {
+                        s += " = True";
+                    }
+                }
+
+                options.push_back(fmt::format("{}:{}", dep.name, s));
+            }
+
+            return options;
+        }
+
+        ulib::list<ulib::string> GetConanSettings(const Target &target)
+        {
+            auto [scope, context] = target.GetBuildVarScope();
+
+            auto conan_arch = scope.ResolveLocal("arch");
+            auto conan_build_type = scope.ResolveLocal("configuration");
+
+            if (auto overridden = scope.GetVar("conan-arch-name"))
+                conan_arch = *overridden;
+
+            if (auto overridden = scope.GetVar("conan-build-type"))
+                conan_build_type = *overridden;
+
+            return {"-s", fmt::format("arch={}", conan_arch), "-s", fmt::format("arch_build={}", conan_arch),
+                    "-s", fmt::format("build_type={}", conan_build_type)};
+        }
+
+        ulib::list<ulib::string> GetConanInstallCommand(const Target &target)
+        {
+            ulib::list<ulib::string> cmdline;
+
+            auto [scope, context] = target.GetBuildVarScope();
+
+            auto cache_dir = scope.GetVar("dep-binary-cache");
+
+            if (cache_dir && !cache_dir->empty())
+            {
+                auto path = fs::path{*cache_dir} / "conan";
+                fs::create_directories(path);
+
+                // Conan reads this on every invocation, which leaves the user's own conan.conf alone. It only goes into
+                // the child's environment: changing ours would race with other fetch threads starting processes.
+                cmdline = {"cmake", "-E", "env"};
+                cmdline.emplace_back("CONAN_DOWNLOAD_CACHE=" + path.u8string());
+            }
+
+            for (auto arg : {"conan", "install", ".", "--build=missing"})
+                cmdline.emplace_back(arg);
+
+            return cmdline;
+        }
+    } // namespace
+
     Target *ConanDepResolver::ResolveTargetDependency(const Target &target, const TargetDependency &dep,
                                                       DepsVersionCache *cache)
     {
@@ -22,11 +117,7 @@ namespace re
         auto re_platform = scope.ResolveLocal("platform");
         auto re_config = scope.ResolveLocal("configuration");
 
-        auto cache_path = fmt::format("{}{}{}-{}-{}-{}-{}", dep.name, dep.version_kind_str, dep.version, re_arch,
-                                      re_platform, re_config, std::hash<std::string>{}(dep.raw));
-
-        if (dep.extra_config_hash)
-            cache_path += fmt::format("-ecfg-{}", dep.extra_config_hash);
+        auto cache_path = GetCachePath(target, dep);
 
         if (auto &cached = mTargetCache[cache_path])
             return cached.get();
@@ -36,27 +127,19 @@ namespace re
 
         auto build_info_path = pkg_cached / "conanbuildinfo.json";
 
+        // Packages already installed by another checkout are just linked from the store
+        auto use_store = mStore && scope.ResolveLocal("dep-store") == "true";
+        auto store_entry = use_store ? mStore->GetEntryPath("conan", cache_path) : fs::path{};
+
+        if (use_store && !fs::exists(build_info_path) && fs::exists(store_entry / "conanbuildinfo.json"))
+            DepStore::LinkEntry(store_entry, pkg_cached);
+
         if (!fs::exists(build_info_path))
         {
             if (scope.ResolveLocal("auto-load-uncached-deps") != "true")
                 RE_THROW TargetUncachedDependencyException(
                     &target, "Cannot resolve uncached dependency {} - autoloading is disabled", dep.raw);
 
-            auto conan_arch = re_arch;
-            auto conan_build_type = re_config;
-
-            if (auto overridden = scope.GetVar("conan-arch-name"))
-                conan_arch = *overridden;
-
-            if (auto overridden = scope.GetVar("conan-build-type"))
-                conan_build_type = *overridden;
-
-            // fmt::print("conan arch: {}\n", conan_arch);
-            // fmt::print("target.name: {}\n", target.name);
-            // fmt::print("scope.ResolveLocal: {}\n", scope.ResolveLocal("conan-arch-name"));
-            // fmt::print("resolved_config: \n");
-            // std::cout << target.resolved_config << std::endl;
-
             fs::create_directories(pkg_cached);
 
             // Create the appropriate conanfile.txt
@@ -64,50 +147,14 @@ namespace re
                 std::ofstream conanfile{pkg_cached / "conanfile.txt"};
 
                 conanfile << "[requires]\n";
-
-                conanfile << std::string_view{dep.name} << "/";
-
-                if (dep.version_kind == DependencyVersionKind::RawTag)
-                {
-                    if (dep.version.empty() || dep.version == "latest")
-                    {
-                        conanfile << "[>=0.0.1]";
-                    }
-                    else
-                    {
-                        conanfile << std::string_view{dep.version};
-                    }
-                }
-                else
-                {
-                    conanfile << "[" << std::string_view{dep.version_kind_str} << std::string_view{dep.version} << "]";
-                }
-
-                conanfile << "\n";
+                conanfile << GetConanReference(dep) << "\n";
 
                 if (dep.filters.size())
                 {
                     conanfile << "[options]\n";
 
-                    for (auto &filter : dep.filters)
-                    {
-                        auto s = scope.Resolve(filter);
-
-                        if (s.find("=") == std::string::npos)
-                        {
-                            if (s[0] == '!')
-                            {
-                                s = s.substr(1);
-                                s += " = False";
-                            }
-                            else
-                            {
-                                s += " = True";
-                            }
-                        }
-
-                        conanfile << std::string_view{dep.name} << ":" << std::string_view{s} << "\n";
-                    }
+                    for (auto &option : GetConanOptions(target, dep))
+                        conanfile << option << "\n";
                 }
 
                 conanfile << "\n";
@@ -120,11 +167,12 @@ namespace re
 
             auto start_time = std::chrono::high_resolution_clock::now();
 
-            RunProcessOrThrow("conan", {},
-                              {"conan", "install", ".", "--build=missing", "-s", fmt::format("arch={}", conan_arch),
-                               "-s", fmt::format("arch_build={}", conan_arch), "-s",
-                               fmt::format("build_type={}", conan_build_type)},
-                              true, true, pkg_cached.u8string());
+            auto cmdline = GetConanInstallCommand(target);
+
+            for (auto &setting : GetConanSettings(target))
+                cmdline.push_back(setting);
+
+            RunProcessOrThrow("conan", {}, cmdline, true, true, pkg_cached.u8string());
 
             /*
             // Throw if the package still isn't there
@@ -134,6 +182,16 @@ namespace re
             }
             */
 
+            // The build info only refers to the Conan cache, so it can be shared as is
+            if (use_store)
+            {
+                store_entry = mStore->GetOrCreateEntry("conan", cache_path, [&pkg_cached](const fs::path &to) {
+                    fs::copy(pkg_cached, to, fs::copy_options::recursive);
+                });
+
+                DepStore::LinkEntry(store_entry, pkg_cached);
+            }
+
             auto end_time = std::chrono::high_resolution_clock::now();
 
             mOut->Info(fmt::emphasis::bold | fg(fmt::color::plum), "\n[{}] Restored package {} ({:.2f}s)\n",
@@ -276,6 +334,114 @@ namespace re
         // conan install . --build=missing -s arch=x86 -s arch_build=x86 -s build_type=Debug
     }
 
+    std::shared_future<void> ConanDepResolver::FetchTargetDependencyAsync(const Target &target,
+                                                                          const TargetDependency &dep,
+                                                                          DepsVersionCache *cache,
+                                                                          DepFetchScheduler &scheduler)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        // Reporting uncached packages is left to ResolveTargetDependency
+        if (scope.ResolveLocal("auto-load-uncached-deps") != "true")
+            return {};
+
+        auto cache_path = GetCachePath(target, dep);
+        auto pkg_cached = target.root_path / ".re-cache" / "conan-deps-cache" / cache_path;
+
+        if (fs::exists(pkg_cached / "conanbuildinfo.json"))
+            return {};
+
+        if (mStore && scope.ResolveLocal("dep-store") == "true" &&
+            fs::exists(mStore->GetEntryPath("conan", cache_path) / "conanbuildinfo.json"))
+            return {};
+
+        if (auto it = mInstalls.find(pkg_cached.u8string()); it != mInstalls.end())
+            return it->second;
+
+        auto settings = GetConanSettings(target);
+
+        std::string batch_name = "batch";
+
+        for (auto &setting : settings)
+            if (setting != "-s")
+                batch_name += fmt::format("-{}", setting);
+
+        auto &batch = mInstallBatches[(target.root_path / ".re-cache" / "conan-deps-cache" / batch_name).u8string()];
+
+        batch.settings = settings;
+        batch.target = &target;
+
+        for (auto &option : GetConanOptions(target, dep))
+            batch.options.insert(option);
+
+        auto &install = mInstalls[pkg_cached.u8string()];
+        install = batch.references.Add(GetConanReference(dep));
+        return install;
+    }
+
+    void ConanDepResolver::FlushFetches(DepFetchScheduler &scheduler)
+    {
+        for (auto &[path, batch] : mInstallBatches)
+        {
+            if (batch.references.IsEmpty())
+                continue;
+
+            batch.references.Flush(
+                scheduler, "conan", path,
+                [path = fs::path{path}, install = GetConanInstallCommand(*batch.target), settings = batch.settings,
+                 options = std::move(batch.options)](const std::vector<std::string> &references) {
+                    fs::create_directories(path);
+
+                    {
+                        std::ofstream conanfile{path / "conanfile.txt"};
+
+                        conanfile << "[requires]\n";
+
+                        for (auto &reference : references)
+                            conanfile << reference << "\n";
+
+                        if (!options.empty())
+                        {
+                            conanfile << "\n";
+                            conanfile << "[options]\n";
+
+                            for (auto &option : options)
+                                conanfile << option << "\n";
+                        }
+                    }
+
+                    auto cmdline = install;
+
+                    for (auto &setting : settings)
+                        cmdline.push_back(setting);
+
+                    // Conan resolves and builds the whole batch as one graph. The per-package installs that follow
+                    // then only have to generate their build info - and still report errors properly if this fails
+                    // (for example because two packages require conflicting versions of a third one).
+                    RunProcessOrThrow("conan", {}, cmdline, true, false, path.u8string());
+                });
+
+            batch.options.clear();
+        }
+    }
+
+    std::string ConanDepResolver::GetCachePath(const Target &target, const TargetDependency &dep)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        auto re_arch = scope.ResolveLocal("arch");
+        auto re_platform = scope.ResolveLocal("platform");
+        auto re_config = scope.ResolveLocal("configuration");
+
+        auto cache_path = fmt::format("{}{}{}-{}-{}-{}-{}", dep.name, dep.version_kind_str, dep.version, re_arch,
+                                      re_platform, re_config, std::hash<std::string>{}(dep.raw));
+
+        if (dep.extra_config_hash)
+            cache_path += fmt::format("-ecfg-{}", dep.extra_config_hash);
+
+        return cache_path;
+    }
+
     bool ConanDepResolver::SaveDependencyToPath(const TargetDependency &dep, const fs::path &path)
     {
         ulib::yaml config;
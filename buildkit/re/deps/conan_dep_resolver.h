@@ -10,24 +10,36 @@
  */
 
 #pragma once
+#include <re/dep_fetch_scheduler.h>
 #include <re/dep_resolver.h>
 #include <re/target.h>
 #include <re/user_output.h>
 
+#include <map>
+#include <set>
+#include <string>
+
 namespace re
 {
+    class DepStore;
+
     /**
      * @brief Implements IDepResolver to provide Conan package dependency support.
      */
     class ConanDepResolver : public IDepResolver
     {
     public:
-        ConanDepResolver(IUserOutput *pOut) : mOut{pOut}
+        ConanDepResolver(IUserOutput *pOut, DepStore *pStore = nullptr) : mOut{pOut}, mStore{pStore}
         {
         }
 
         Target *ResolveTargetDependency(const Target &target, const TargetDependency &dep, DepsVersionCache *cache);
 
+        std::shared_future<void> FetchTargetDependencyAsync(const Target &target, const TargetDependency &dep,
+                                                            DepsVersionCache *cache, DepFetchScheduler &scheduler);
+
+        void FlushFetches(DepFetchScheduler &scheduler);
+
         bool SaveDependencyToPath(const TargetDependency &dep, const fs::path &path);
 
         virtual bool DoesCustomHandleFilters()
@@ -37,6 +49,26 @@ namespace re
 
     private:
         IUserOutput *mOut;
+        DepStore *mStore;
+
         std::unordered_map<std::string, std::unique_ptr<Target>> mTargetCache;
+
+        /**
+         * @brief Packages waiting to be installed with a single `conan install`, for one set of settings.
+         */
+        struct InstallBatch
+        {
+            const Target *target = nullptr;
+
+            ulib::list<ulib::string> settings;
+            std::set<std::string> options;
+
+            DepFetchBatch references;
+        };
+
+        std::map<std::string, InstallBatch> mInstallBatches;
+        std::unordered_map<std::string, std::shared_future<void>> mInstalls;
+
+        std::string GetCachePath(const Target &target, const TargetDependency &dep);
     };
 } // namespace re
@@ -9,6 +9,8 @@
 #include <re/target_cfg_utils.h>
 #include <re/yaml_merge.h>
 
+#include <re/dep_fetch_scheduler.h>
+#include <re/dep_store.h>
 #include <re/deps_version_cache.h>
 
 #include <fstream>
@@ -27,75 +29,9 @@ namespace re
     Target *GitDepResolver::ResolveGitDependency(const Target &target, const TargetDependency &dep,
                                                  ulib::string_view url, ulib::string branch, DepsVersionCache *cache)
     {
-        if (cache)
-        {
-            auto git_ls_remote = [&](const re::TargetDependency &target_dep,
-                                     std::string_view url) -> std::vector<std::string> {
-                std::vector<std::string> result;
-                fmt::print("exec: git ls-remote --refs --tags {}\n", url);
-                ulib::process process("git", {"ls-remote", "--refs", "--tags", url},
-                                      ulib::process::pipe_output | ulib::process::die_with_parent);
-
-                std::optional<int> code = process.wait(std::chrono::seconds(5));
-                if (code.has_value())
-                {
-                    // fmt::print("exit code: {}", *code);
-                    if (*code != 0)
-                        RE_THROW TargetDependencyException(&target, "git ls-remote failed with code: {}", *code);
-                }
-                else
-                {
-                    fmt::print(" - Using terminate process bypass for git ls-remote for {}\n", url);
-                }
-
-                ulib::string data = process.out().read_all();
-                ulib::list<ulib::string> lines = data.split("\n");
-                for (auto &line : lines)
-                {
-                    ulib::list<ulib::string> keys = line.split("\t");
-                    if (keys.size() == 1)
-                        keys = line.split(" ");
-                    if (keys.size() != 2)
-                        RE_THROW TargetDependencyException(
-                            &target, "Invalid line in git ls-remote output: {}, size: {}", line, keys.size());
-
-                    auto &tag = result.emplace_back();
-
-                    auto hash = keys[0];
-                    tag = keys[1];
-
-                    constexpr char kRefsTags[] = "refs/tags/";
-                    auto pos = tag.find(kRefsTags);
-                    if (pos != tag.npos)
-                        tag.erase(pos, sizeof kRefsTags - 1);
-                }
-
-                if (!code.has_value())
-                {
-                    try
-                    {
-                        process.terminate();
-                    }
-                    catch (...)
-                    {
-                        process.detach();
-                    }
-                }
-
-                return result;
-            };
-
-            branch = cache->GetLatestVersionMatchingRequirements(target, dep, url, git_ls_remote);
-        }
-
-        auto cached_dir = fmt::format("git.{}.{}@{}", dep.ns, dep.name, branch);
-
-        cached_dir.erase(std::remove(cached_dir.begin(), cached_dir.end(), ' '), cached_dir.end());
+        branch = GetGitDependencyBranch(target, dep, url, branch, cache);
 
-        // Hack lol
-        for (auto &c : cached_dir)
-            if (c == '/' || c == ':')
-                c = '_';
+        auto cached_dir = GetGitCachedDirName(dep, branch);
 
         auto [scope, context] = target.GetBuildVarScope();
 
@@ -124,7 +60,7 @@ namespace re
         auto cache_name = ".re-cache";
         auto git_cached = target.root_path / cache_name / cached_dir;
 
-        fs::create_directories(git_cached);
+        fs::create_directories(git_cached.parent_path());
 
         auto dep_str = dep.ToString();
 
@@ -139,8 +75,7 @@ namespace re
 
             auto start_time = std::chrono::high_resolution_clock::now();
 
-            fs::remove_all(git_cached);
-            DownloadGitDependency(url, branch, git_cached);
+            RestoreGitDependency(url, branch, git_cached, UsesDepStore(target), GetSparseCheckoutPaths(target, dep));
 
             auto end_time = std::chrono::high_resolution_clock::now();
 
@@ -152,6 +87,9 @@ namespace re
         {
             mOut->Info(fmt::emphasis::bold | fg(fmt::color::light_blue), "[{}] Package {} already available\n",
                        target.module, dep_str);
+
+            // Another dependency on the same repository may have only checked out a different part of it
+            UpdateSparseCheckout(git_cached, GetSparseCheckoutPaths(target, dep));
         }
 
         if (cutout_filter.size())
@@ -182,10 +120,222 @@ namespace re
         return result.get();
     }
 
-    void GitDepResolver::DownloadGitDependency(ulib::string_view url, ulib::string_view branch, const fs::path &to)
+    ulib::string GitDepResolver::GetGitDependencyBranch(const Target &target, const TargetDependency &dep,
+                                                        ulib::string_view url, ulib::string branch,
+                                                        DepsVersionCache *cache)
+    {
+        if (cache)
+        {
+            auto &index = GetTagIndex(target);
+
+            branch = cache->GetLatestVersionMatchingRequirements(
+                target, dep, url, [&index](const TargetDependency &, const std::string &url) {
+                    return index.GetTags(url);
+                });
+        }
+
+        return branch;
+    }
+
+    std::string GitDepResolver::GetGitCachedDirName(const TargetDependency &dep, ulib::string_view branch)
+    {
+        auto cached_dir = fmt::format("git.{}.{}@{}", dep.ns, dep.name, branch);
+
+        cached_dir.erase(std::remove(cached_dir.begin(), cached_dir.end(), ' '), cached_dir.end());
+
+        // Hack lol
+        for (auto &c : cached_dir)
+            if (c == '/' || c == ':')
+                c = '_';
+
+        return cached_dir;
+    }
+
+    std::shared_future<void> GitDepResolver::FetchTargetDependencyAsync(const Target &target,
+                                                                        const TargetDependency &dep,
+                                                                        DepsVersionCache *cache,
+                                                                        DepFetchScheduler &scheduler)
+    {
+        return FetchGitDependencyAsync(target, dep, dep.name, dep.version, cache, scheduler);
+    }
+
+    std::shared_future<void> GitDepResolver::FetchGitDependencyAsync(const Target &target, const TargetDependency &dep,
+                                                                     ulib::string_view url, ulib::string branch,
+                                                                     DepsVersionCache *cache,
+                                                                     DepFetchScheduler &scheduler)
+    {
+        // Listing the remote's tags is a fetch step of its own, so that all remotes are listed concurrently
+        if (cache && !cache->HasLockedVersion(dep))
+        {
+            auto &index = GetTagIndex(target);
+            auto remote = std::string{url};
+
+            if (!index.IsFresh(remote))
+                return scheduler.Schedule("git-ls-remote", "ls-remote " + remote,
+                                          [&index, remote] { index.Refresh(remote); });
+        }
+
+        branch = GetGitDependencyBranch(target, dep, url, branch, cache);
+
+        auto git_cached = target.root_path / ".re-cache" / GetGitCachedDirName(dep, branch);
+
+        // Once the repository is there, loading it can be prepared (a CMake project gets configured, for instance)
+        if (fs::exists(git_cached / ".git"))
+        {
+            // The part of the repository this dependency needs must be checked out before anything looks at it
+            UpdateSparseCheckout(git_cached, GetSparseCheckoutPaths(target, dep));
+
+            if (dep.filters.size() >= 1 && dep.filters[0].front() == '/')
+                git_cached /= std::string{dep.filters[0].substr(1)};
+
+            return mLoader->PrepareFreeTargetAsync(git_cached, &target, &dep, scheduler);
+        }
+
+        auto [scope, context] = target.GetBuildVarScope();
+
+        // ResolveGitDependency reports this properly
+        if (scope.ResolveLocal("auto-load-uncached-deps") != "true")
+            return {};
+
+        mOut->Info(fmt::emphasis::bold | fg(fmt::color::light_blue), "[{}] Restoring package {}...\n", target.module,
+                   dep.ToString());
+
+        auto use_store = UsesDepStore(target);
+        auto sparse_paths = GetSparseCheckoutPaths(target, dep);
+
+        return scheduler.Schedule("git", git_cached.u8string(),
+                                  [this, url = ulib::string{url}, branch, git_cached, use_store, sparse_paths] {
+                                      RestoreGitDependency(url, branch, git_cached, use_store, sparse_paths);
+                                  });
+    }
+
+    void GitDepResolver::ForgetTarget(const Target *target)
+    {
+        for (auto it = mTargetCache.begin(); it != mTargetCache.end(); it++)
+        {
+            if (it->second.get() == target)
+            {
+                mForgottenTargets.emplace_back(std::move(it->second));
+                mTargetCache.erase(it);
+                return;
+            }
+        }
+    }
+
+    std::optional<std::vector<std::string>> GitDepResolver::GetAvailableVersions(const Target &target,
+                                                                                 const TargetDependency &dep)
+    {
+        return GetGitAvailableVersions(target, dep.name);
+    }
+
+    std::vector<std::string> GitDepResolver::GetGitAvailableVersions(const Target &target, ulib::string_view url)
+    {
+        return GetTagIndex(target).GetTags(std::string{url});
+    }
+
+    GitTagIndex &GitDepResolver::GetTagIndex(const Target &target)
+    {
+        auto path = target.root_path / ".re-cache" / "git-tag-index.json";
+        auto &index = mTagIndices[path.u8string()];
+
+        if (!index)
+            index = std::make_unique<GitTagIndex>(path);
+
+        auto [scope, context] = target.GetBuildVarScope();
+
+        if (auto ttl = scope.GetVar("git-tag-index-ttl"))
+            index->SetTTL(std::chrono::seconds{ParseIntegerVar("git-tag-index-ttl", *ttl, 0)});
+
+        if (auto timeout = scope.GetVar("git-ls-remote-timeout"))
+            index->SetTimeout(std::chrono::seconds{ParseIntegerVar("git-ls-remote-timeout", *timeout, 1)});
+
+        return *index;
+    }
+
+    bool GitDepResolver::UsesDepStore(const Target &target)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+        return mStore && scope.ResolveLocal("dep-store") == "true";
+    }
+
+    std::vector<std::string> GitDepResolver::GetSparseCheckoutPaths(const Target &target, const TargetDependency &dep)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        // Store snapshots are shared by every dependency on the repository, so they are always complete
+        if (scope.ResolveLocal("git-sparse-checkout") != "true" || UsesDepStore(target))
+            return {};
+
+        // Only cutout filters name paths: the other ones select targets by name, wherever they are, and need the whole
+        // repository
+        if (dep.filters.size() >= 1 && dep.filters[0].front() == '/' && dep.filters[0].size() > 1)
+            return {std::string{dep.filters[0].substr(1)}};
+
+        return {};
+    }
+
+    void GitDepResolver::UpdateSparseCheckout(const fs::path &repo, const std::vector<std::string> &paths)
+    {
+        // Sparse checkouts are only ever widened: full clones stay full
+        if (!fs::exists(repo / ".git" / "info" / "sparse-checkout"))
+            return;
+
+        // The file outlives `git sparse-checkout disable`, only the config tells whether the checkout is still sparse
+        ulib::list<ulib::string> config_cmdline = {"git", "config", "--get", "core.sparseCheckout", "true"};
+
+        if (RunProcessOrThrow("git", {}, config_cmdline, false, false, repo) != 0)
+            return;
+
+        // No paths means the whole tree is needed
+        if (paths.empty())
+        {
+            RunProcessOrThrow("git", {}, {"git", "sparse-checkout", "disable"}, false, true, repo);
+            return;
+        }
+
+        ulib::list<ulib::string> cmdline = {"git", "sparse-checkout", "add"};
+
+        for (auto &path : paths)
+            if (!fs::exists(repo / path))
+                cmdline.emplace_back(path);
+
+        if (cmdline.size() > 3)
+            RunProcessOrThrow("git", {}, cmdline, false, true, repo);
+    }
+
+    void GitDepResolver::RestoreGitDependency(ulib::string_view url, ulib::string_view branch, const fs::path &to,
+                                              bool use_store, const std::vector<std::string> &sparse_paths)
+    {
+        fs::remove_all(to);
+
+        if (!use_store)
+        {
+            DownloadGitDependency(url, branch, to, sparse_paths);
+            return;
+        }
+
+        // Every checkout of the same commit links to the same snapshot, whichever branch or tag it came from
+        auto commit = mStore->ResolveGitCommit(url, branch);
+        auto entry = mStore->GetOrCreateEntry("git", fmt::format("{}@{}", url, commit),
+                                              [this, url, &commit](const fs::path &path) {
+                                                  mStore->CloneGitSnapshot(url, commit, path);
+                                              });
+
+        DepStore::LinkEntry(entry, to);
+    }
+
+    void GitDepResolver::DownloadGitDependency(ulib::string_view url, ulib::string_view branch, const fs::path &to,
+                                               const std::vector<std::string> &sparse_paths)
     {
         ulib::list<ulib::string> cmdline = {"git", "clone", "--depth", "1"};
 
+        // Only fetch the blobs of the requested subtrees: everything else stays on the server
+        if (!sparse_paths.empty())
+        {
+            cmdline.emplace_back("--filter=blob:none");
+            cmdline.emplace_back("--sparse");
+        }
+
         if (!branch.empty())
         {
             cmdline.emplace_back("--branch");
@@ -196,6 +346,16 @@ namespace re
         cmdline.emplace_back(to.u8string());
 
         RunProcessOrThrow("git", {}, cmdline, false, true);
+
+        if (!sparse_paths.empty())
+        {
+            ulib::list<ulib::string> set_cmdline = {"git", "sparse-checkout", "set"};
+
+            for (auto &path : sparse_paths)
+                set_cmdline.emplace_back(path);
+
+            RunProcessOrThrow("git", {}, set_cmdline, false, true, to);
+        }
     }
 
     bool GitDepResolver::SaveDependencyToPath(const TargetDependency &dep, const fs::path &path)
@@ -1,30 +1,59 @@
 #pragma once
 #include <re/dep_resolver.h>
+#include <re/deps/git_tag_index.h>
 #include <re/target.h>
 #include <re/target_loader.h>
 #include <re/user_output.h>
 
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace re
 {
+    class DepStore;
+
     class GitDepResolver : public IDepResolver
     {
     public:
-        GitDepResolver(ITargetLoader* pLoader, IUserOutput* pOut)
-            : mLoader{ pLoader }, mOut{ pOut }
+        GitDepResolver(ITargetLoader* pLoader, IUserOutput* pOut, DepStore* pStore = nullptr)
+            : mLoader{ pLoader }, mOut{ pOut }, mStore{ pStore }
         {}
 
         Target* ResolveTargetDependency(const Target& target, const TargetDependency& dep, DepsVersionCache* cache);
         Target* ResolveGitDependency(const Target& target, const TargetDependency& dep, ulib::string_view url, ulib::string branch, DepsVersionCache* cache);
-        void DownloadGitDependency(ulib::string_view url, ulib::string_view branch, const fs::path& to);
+        void DownloadGitDependency(ulib::string_view url, ulib::string_view branch, const fs::path& to, const std::vector<std::string>& sparse_paths = {});
+
+        std::shared_future<void> FetchTargetDependencyAsync(const Target& target, const TargetDependency& dep, DepsVersionCache* cache, DepFetchScheduler& scheduler);
+        void ForgetTarget(const Target* target);
+
+        std::shared_future<void> FetchGitDependencyAsync(const Target& target, const TargetDependency& dep, ulib::string_view url, ulib::string branch, DepsVersionCache* cache, DepFetchScheduler& scheduler);
+
+        std::optional<std::vector<std::string>> GetAvailableVersions(const Target& target, const TargetDependency& dep);
+        std::vector<std::string> GetGitAvailableVersions(const Target& target, ulib::string_view url);
         
         virtual bool SaveDependencyToPath(const TargetDependency& dep, const fs::path& path);
 
     private:
         ITargetLoader* mLoader;
         IUserOutput* mOut;
+        DepStore* mStore;
 
         std::unordered_map<std::string, std::unique_ptr<Target>> mTargetCache;
+
+        // Forgotten targets stay alive: targets loaded along with them may still refer to them
+        std::vector<std::unique_ptr<Target>> mForgottenTargets;
+        std::unordered_map<std::string, std::unique_ptr<GitTagIndex>> mTagIndices;
+
+        ulib::string GetGitDependencyBranch(const Target& target, const TargetDependency& dep, ulib::string_view url, ulib::string branch, DepsVersionCache* cache);
+        std::string GetGitCachedDirName(const TargetDependency& dep, ulib::string_view branch);
+
+        GitTagIndex& GetTagIndex(const Target& target);
+
+        bool UsesDepStore(const Target& target);
+        void RestoreGitDependency(ulib::string_view url, ulib::string_view branch, const fs::path& to, bool use_store, const std::vector<std::string>& sparse_paths);
+
+        std::vector<std::string> GetSparseCheckoutPaths(const Target& target, const TargetDependency& dep);
+        void UpdateSparseCheckout(const fs::path& repo, const std::vector<std::string>& paths);
     };
 }
@@ -0,0 +1,206 @@
+#include "git_tag_index.h"
+
+#include <re/error.h>
+
+#include <fmt/format.h>
+
+#include <nlohmann/json.hpp>
+
+#include <ulib/process.h>
+#include <ulib/string.h>
+
+#include <fstream>
+#include <future>
+#include <optional>
+#include <random>
+
+namespace re
+{
+    namespace
+    {
+        std::vector<std::string> ListRemoteTags(const std::string &url, std::chrono::seconds timeout)
+        {
+            std::vector<std::string> result;
+
+            ulib::process process("git", {"ls-remote", "--refs", "--tags", url},
+                                  ulib::process::pipe_output | ulib::process::die_with_parent);
+
+            // Drained while waiting: a remote with a few hundred tags fills the pipe, and git would block writing to it
+            // until the timeout. The timeout only has to kill the process then, which also ends the read.
+            auto output = std::async(std::launch::async, [&process] { return ulib::string{process.out().read_all()}; });
+
+            std::optional<int> code = process.wait(timeout);
+
+            // Whatever the process printed so far may be cut short anywhere, even in the middle of a line
+            if (!code.has_value())
+            {
+                try
+                {
+                    process.terminate();
+                }
+                catch (...)
+                {
+                    process.detach();
+                }
+
+                RE_THROW Exception("git ls-remote for {} timed out after {}s", url, timeout.count());
+            }
+
+            if (*code != 0)
+                RE_THROW Exception("git ls-remote for {} failed with code: {}", url, *code);
+
+            ulib::string data = output.get();
+            ulib::list<ulib::string> lines = data.split("\n");
+            for (auto &line : lines)
+            {
+                ulib::list<ulib::string> keys = line.split("\t");
+                if (keys.size() == 1)
+                    keys = line.split(" ");
+                if (keys.size() != 2)
+                    RE_THROW Exception("Invalid line in git ls-remote output for {}: {}, size: {}", url, line,
+                                       keys.size());
+
+                auto &tag = result.emplace_back();
+                tag = keys[1];
+
+                constexpr char kRefsTags[] = "refs/tags/";
+                auto pos = tag.find(kRefsTags);
+                if (pos != tag.npos)
+                    tag.erase(pos, sizeof kRefsTags - 1);
+            }
+
+            return result;
+        }
+
+        std::int64_t GetCurrentTimestamp()
+        {
+            return std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+    } // namespace
+
+    GitTagIndex::GitTagIndex(const fs::path &path) : mPath{path}
+    {
+        std::ifstream file{path};
+
+        if (!file)
+            return;
+
+        // A broken index is as good as an empty one
+        auto data = nlohmann::json::parse(file, nullptr, false);
+
+        if (!data.is_object())
+            return;
+
+        for (auto &[url, object] : data.items())
+        {
+            auto timestamp = object.find("timestamp");
+            auto tags = object.find("tags");
+
+            if (timestamp == object.end() || tags == object.end() || !timestamp->is_number() || !tags->is_array())
+                continue;
+
+            auto &entry = mEntries[url];
+
+            entry.timestamp = timestamp->get<std::int64_t>();
+
+            for (auto &tag : *tags)
+                if (tag.is_string())
+                    entry.tags.push_back(tag.get<std::string>());
+        }
+    }
+
+    void GitTagIndex::SetTTL(std::chrono::seconds ttl)
+    {
+        std::lock_guard lock{mMutex};
+        mTTL = ttl;
+    }
+
+    bool GitTagIndex::IsFresh(const std::string &url)
+    {
+        std::lock_guard lock{mMutex};
+        return IsFreshLocked(url);
+    }
+
+    std::vector<std::string> GitTagIndex::GetTags(const std::string &url)
+    {
+        {
+            std::lock_guard lock{mMutex};
+
+            if (IsFreshLocked(url))
+                return mEntries[url].tags;
+        }
+
+        Refresh(url);
+
+        std::lock_guard lock{mMutex};
+        return mEntries[url].tags;
+    }
+
+    void GitTagIndex::SetTimeout(std::chrono::seconds timeout)
+    {
+        std::lock_guard lock{mMutex};
+        mTimeout = timeout;
+    }
+
+    void GitTagIndex::Refresh(const std::string &url)
+    {
+        std::chrono::seconds timeout;
+
+        {
+            std::lock_guard lock{mMutex};
+            timeout = mTimeout;
+        }
+
+        // Failures leave the entry as it was, so that nothing incomplete ever gets saved
+        auto tags = ListRemoteTags(url, timeout);
+
+        std::lock_guard lock{mMutex};
+
+        auto &entry = mEntries[url];
+
+        entry.timestamp = GetCurrentTimestamp();
+        entry.tags = std::move(tags);
+        entry.refreshed = true;
+
+        SaveLocked();
+    }
+
+    bool GitTagIndex::IsFreshLocked(const std::string &url) const
+    {
+        auto it = mEntries.find(url);
+
+        if (it == mEntries.end())
+            return false;
+
+        return it->second.refreshed || GetCurrentTimestamp() - it->second.timestamp < mTTL.count();
+    }
+
+    void GitTagIndex::SaveLocked()
+    {
+        auto data = nlohmann::json::object();
+
+        for (auto &[url, entry] : mEntries)
+        {
+            auto &object = data[url];
+
+            object["timestamp"] = entry.timestamp;
+            object["tags"] = entry.tags;
+        }
+
+        fs::create_directories(mPath.parent_path());
+
+        // Other Re instances may be reading the index at the same time
+        auto temp_path = mPath;
+        temp_path += fmt::format(".tmp-{:x}", std::random_device{}());
+
+        {
+            std::ofstream file{temp_path};
+            file << data.dump();
+        }
+
+        std::error_code ec;
+        fs::rename(temp_path, mPath, ec);
+    }
+} // namespace re
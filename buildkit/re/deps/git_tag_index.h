@@ -0,0 +1,93 @@
+/**
+ * @file re/deps/git_tag_index.h
+ * @brief Persistent index of the tags available in remote Git repositories
+ */
+
+#pragma once
+#include <re/fs.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief Caches `git ls-remote --tags` results per remote URL, both in memory and in a JSON file.
+     *
+     * Entries older than the TTL are refreshed the next time they are needed; entries refreshed by this process are
+     * always considered fresh, so a remote is never listed twice in a single run.
+     *
+     * All methods are thread-safe: refreshes are meant to run concurrently on a DepFetchScheduler.
+     */
+    class GitTagIndex
+    {
+    public:
+        /**
+         * @brief Construct a new GitTagIndex object, loading the existing index file if there is one.
+         *
+         * @param path The index file's path
+         */
+        explicit GitTagIndex(const fs::path &path);
+
+        /**
+         * @brief Sets how long listed tags stay valid.
+         *
+         * @param ttl The TTL (zero means that every remote is listed again once per run)
+         */
+        void SetTTL(std::chrono::seconds ttl);
+
+        /**
+         * @brief Sets how long listing a remote may take before it counts as a failure.
+         *
+         * @param timeout The timeout
+         */
+        void SetTimeout(std::chrono::seconds timeout);
+
+        /**
+         * @brief Checks whether the tags of a remote can be returned without listing it.
+         *
+         * @param url The remote's URL
+         */
+        bool IsFresh(const std::string &url);
+
+        /**
+         * @brief Gets the tags of a remote, listing it first if the index doesn't have fresh ones.
+         *
+         * @param url The remote's URL
+         * @return std::vector<std::string> The tag names, without the `refs/tags/` prefix
+         */
+        std::vector<std::string> GetTags(const std::string &url);
+
+        /**
+         * @brief Lists a remote's tags and stores them in the index.
+         *
+         * @param url The remote's URL
+         *
+         * @throws Exception Thrown if listing the remote failed or timed out, in which case the index is left as is.
+         */
+        void Refresh(const std::string &url);
+
+    private:
+        struct Entry
+        {
+            std::int64_t timestamp = 0;
+            std::vector<std::string> tags;
+
+            bool refreshed = false;
+        };
+
+        fs::path mPath;
+        std::chrono::seconds mTTL{3600};
+        std::chrono::seconds mTimeout{60};
+
+        std::mutex mMutex;
+        std::unordered_map<std::string, Entry> mEntries;
+
+        bool IsFreshLocked(const std::string &url) const;
+        void SaveLocked();
+    };
+} // namespace re
@@ -23,6 +23,38 @@ namespace re
 			return mGit->ResolveGitDependency(target, dep, fmt::format("https://github.com/{}", url), dep.version, cache);
 	}
 	
+	std::shared_future<void> GithubDepResolver::FetchTargetDependencyAsync(const Target& target, const TargetDependency& dep, DepsVersionCache* cache, DepFetchScheduler& scheduler)
+	{
+		ulib::string url = dep.name;
+
+		if (!url.ends_with(".git"))
+			url.append(".git");
+
+		auto temp = std::getenv("RE_GITHUB_FORCE_SSH");
+		auto force_ssh = temp && !strcmp(temp, "1");
+
+		if (dep.ns == "github-ssh" || force_ssh)
+			return mGit->FetchGitDependencyAsync(target, dep, fmt::format("git@github.com:{}", url), dep.version, cache, scheduler);
+		else
+			return mGit->FetchGitDependencyAsync(target, dep, fmt::format("https://github.com/{}", url), dep.version, cache, scheduler);
+	}
+
+	std::optional<std::vector<std::string>> GithubDepResolver::GetAvailableVersions(const Target& target, const TargetDependency& dep)
+	{
+		ulib::string url = dep.name;
+
+		if (!url.ends_with(".git"))
+			url.append(".git");
+
+		auto temp = std::getenv("RE_GITHUB_FORCE_SSH");
+		auto force_ssh = temp && !strcmp(temp, "1");
+
+		if (dep.ns == "github-ssh" || force_ssh)
+			return mGit->GetGitAvailableVersions(target, fmt::format("git@github.com:{}", url));
+		else
+			return mGit->GetGitAvailableVersions(target, fmt::format("https://github.com/{}", url));
+	}
+
 	bool GithubDepResolver::SaveDependencyToPath(const TargetDependency& dep, const fs::path& path)
 	{
         fs::create_directories(path);
@@ -11,6 +11,13 @@ namespace re
 		{}
 
 		Target* ResolveTargetDependency(const Target& target, const TargetDependency& dep, DepsVersionCache* cache);
+		std::shared_future<void> FetchTargetDependencyAsync(const Target& target, const TargetDependency& dep, DepsVersionCache* cache, DepFetchScheduler& scheduler);
+		std::optional<std::vector<std::string>> GetAvailableVersions(const Target& target, const TargetDependency& dep);
+
+		void ForgetTarget(const Target* target)
+		{
+			mGit->ForgetTarget(target);
+		}
 		
         virtual bool SaveDependencyToPath(const TargetDependency& dep, const fs::path& path);
 
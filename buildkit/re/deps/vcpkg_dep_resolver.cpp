@@ -3,6 +3,7 @@
 #include <fmt/color.h>
 #include <fmt/format.h>
 
+#include <re/dep_fetch_scheduler.h>
 #include <re/process_util.h>
 #include <re/target_cfg_utils.h>
 #include <re/yaml_merge.h>
@@ -21,15 +22,7 @@ namespace re
         auto re_platform = scope.ResolveLocal("platform");
         auto re_config = scope.ResolveLocal("configuration");
 
-        auto lib_type = scope.ResolveLocal("vcpkg-library-type");
-
-        auto at_prefix = (dep.version.size() && dep.ns == "vcpkg") ? fmt::format("-{}", dep.version) : "";
-        // fmt::print(" / dbg - ns='{}' atp='{}'\n", dep.ns, at_prefix);
-
-        if (!lib_type.empty() && lib_type != "dynamic")
-        {
-            at_prefix = fmt::format("-{}", lib_type) + at_prefix;
-        }
+        auto at_prefix = GetPackageSuffix(target, dep);
 
         auto cache_path = fmt::format("{}{}-{}-{}-{}", dep.name, at_prefix, re_arch, re_platform, re_config);
 
@@ -39,10 +32,7 @@ namespace re
         if (auto &cached = mTargetCache[cache_path])
             return cached.get();
 
-        auto vcpkg_root = mVcpkgPath;
-
-        if (auto path = scope.GetVar("vcpkg-root-path"))
-            vcpkg_root = fs::path{*path};
+        auto vcpkg_root = GetVcpkgRoot(target);
 
         auto dep_str = dep.ToString();
 
@@ -97,9 +87,13 @@ namespace re
             if (re_platform == "windows")
                 vcpkg_name += ".exe";
 
-            RunProcessOrThrow("vcpkg", vcpkg_root / vcpkg_name,
-                              {"install", fmt::format("{}:{}-{}{}", dep.name, re_arch, re_platform, at_prefix)}, true,
-                              true);
+            ulib::list<ulib::string> cmdline = {"install",
+                                                fmt::format("{}:{}-{}{}", dep.name, re_arch, re_platform, at_prefix)};
+
+            for (auto &arg : GetBinaryCacheArgs(target))
+                cmdline.emplace_back(arg);
+
+            RunProcessOrThrow("vcpkg", vcpkg_root / vcpkg_name, cmdline, true, true);
 
             // Throw if the package still isn't there
             if (!fs::exists(path))
@@ -279,6 +273,130 @@ namespace re
         return result.get();
     }
 
+    std::shared_future<void> VcpkgDepResolver::FetchTargetDependencyAsync(const Target &target,
+                                                                          const TargetDependency &dep,
+                                                                          DepsVersionCache *cache,
+                                                                          DepFetchScheduler &scheduler)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        // Bootstrapping vcpkg itself and reporting uncached packages is left to ResolveTargetDependency
+        if (scope.ResolveLocal("auto-load-uncached-deps") != "true")
+            return {};
+
+        auto vcpkg_root = GetVcpkgRoot(target);
+
+        if (!fs::exists(vcpkg_root / ".git"))
+            return {};
+
+        auto re_arch = scope.ResolveLocal("arch");
+        auto re_platform = scope.ResolveLocal("platform");
+
+        auto at_prefix = GetPackageSuffix(target, dep);
+        auto path = vcpkg_root / "packages" / (dep.name + fmt::format("_{}-{}{}", re_arch, re_platform, at_prefix));
+
+        if (fs::exists(path / "BUILD_INFO"))
+            return {};
+
+        if (auto it = mInstalls.find(path.u8string()); it != mInstalls.end())
+            return it->second;
+
+        fmt::print(fmt::emphasis::bold | fg(fmt::color::light_green), "[{}] Restoring package {}...\n\n",
+                   target.module, dep.ToString());
+
+        std::string vcpkg_name = "vcpkg";
+
+        if (re_platform == "windows")
+            vcpkg_name += ".exe";
+
+        auto triplet = fmt::format("{}-{}{}", re_arch, re_platform, at_prefix);
+
+        // All the missing ports of a triplet are installed by a single vcpkg invocation, which builds them concurrently
+        auto &batch = mInstallBatches[fmt::format("{}:{}", (vcpkg_root / vcpkg_name).u8string(), triplet)];
+
+        batch.vcpkg = vcpkg_root / vcpkg_name;
+        batch.args = GetBinaryCacheArgs(target);
+
+        auto &install = mInstalls[path.u8string()];
+        install = batch.ports.Add(fmt::format("{}:{}", dep.name, triplet));
+        return install;
+    }
+
+    void VcpkgDepResolver::FlushFetches(DepFetchScheduler &scheduler)
+    {
+        // vcpkg locks its installation root, so only one install can run at a time
+        scheduler.SetPoolLimit("vcpkg", 1);
+
+        for (auto &[key, batch] : mInstallBatches)
+        {
+            batch.ports.Flush(
+                scheduler, "vcpkg", key,
+                [vcpkg = batch.vcpkg, args = batch.args](const std::vector<std::string> &ports) {
+                    auto install = [&vcpkg, &args](const std::vector<std::string> &ports) {
+                        ulib::list<ulib::string> cmdline = {"install"};
+
+                        for (auto &port : ports)
+                            cmdline.emplace_back(port);
+
+                        for (auto &arg : args)
+                            cmdline.emplace_back(arg);
+
+                        return RunProcessOrThrow("vcpkg", vcpkg, cmdline, true, false) == 0;
+                    };
+
+                    if (install(ports) || ports.size() == 1)
+                        return;
+
+                    // A single broken port fails the whole batch: install the ports one by one so that the others
+                    // still make it. ResolveTargetDependency reports the ones that are still missing afterwards.
+                    for (auto &port : ports)
+                        install({port});
+                });
+        }
+    }
+
+    fs::path VcpkgDepResolver::GetVcpkgRoot(const Target &target)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        if (auto path = scope.GetVar("vcpkg-root-path"))
+            return fs::path{*path};
+
+        return mVcpkgPath;
+    }
+
+    std::string VcpkgDepResolver::GetPackageSuffix(const Target &target, const TargetDependency &dep)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        auto lib_type = scope.ResolveLocal("vcpkg-library-type");
+
+        auto at_prefix = (dep.version.size() && dep.ns == "vcpkg") ? fmt::format("-{}", dep.version) : "";
+        // fmt::print(" / dbg - ns='{}' atp='{}'\n", dep.ns, at_prefix);
+
+        if (!lib_type.empty() && lib_type != "dynamic")
+        {
+            at_prefix = fmt::format("-{}", lib_type) + at_prefix;
+        }
+
+        return at_prefix;
+    }
+
+    std::vector<std::string> VcpkgDepResolver::GetBinaryCacheArgs(const Target &target)
+    {
+        auto [scope, context] = target.GetBuildVarScope();
+
+        auto cache_dir = scope.GetVar("dep-binary-cache");
+
+        if (!cache_dir || cache_dir->empty())
+            return {};
+
+        auto path = fs::path{*cache_dir} / "vcpkg";
+        fs::create_directories(path);
+
+        return {fmt::format("--binarysource=clear;files,{},readwrite", path.u8string())};
+    }
+
     bool VcpkgDepResolver::SaveDependencyToPath(const TargetDependency &dep, const fs::path &path)
     {
         ulib::yaml config;
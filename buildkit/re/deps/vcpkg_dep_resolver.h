@@ -1,10 +1,15 @@
 #pragma once
+#include <re/dep_fetch_scheduler.h>
 #include <re/dep_resolver.h>
 #include <re/target.h>
 #include <re/user_output.h>
 
 #include <re/fs.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 namespace re
 {
     class VcpkgDepResolver : public IDepResolver
@@ -16,6 +21,11 @@ namespace re
 
         Target *ResolveTargetDependency(const Target &target, const TargetDependency &dep, DepsVersionCache *cache);
 
+        std::shared_future<void> FetchTargetDependencyAsync(const Target &target, const TargetDependency &dep,
+                                                            DepsVersionCache *cache, DepFetchScheduler &scheduler);
+
+        void FlushFetches(DepFetchScheduler &scheduler);
+
         virtual bool SaveDependencyToPath(const TargetDependency &dep, const fs::path &path);
 
         virtual bool DoesCustomHandleFilters()
@@ -28,5 +38,23 @@ namespace re
         IUserOutput *mOut;
 
         std::unordered_map<std::string, std::unique_ptr<Target>> mTargetCache;
+
+        /**
+         * @brief Ports waiting to be installed with a single `vcpkg install`, for one vcpkg instance and triplet.
+         */
+        struct InstallBatch
+        {
+            fs::path vcpkg;
+            std::vector<std::string> args;
+
+            DepFetchBatch ports;
+        };
+
+        std::map<std::string, InstallBatch> mInstallBatches;
+        std::unordered_map<std::string, std::shared_future<void>> mInstalls;
+
+        fs::path GetVcpkgRoot(const Target &target);
+        std::string GetPackageSuffix(const Target &target, const TargetDependency &dep);
+        std::vector<std::string> GetBinaryCacheArgs(const Target &target);
     };
 } // namespace re
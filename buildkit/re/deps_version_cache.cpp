@@ -9,34 +9,7 @@ namespace re
         if (dep.version_kind == DependencyVersionKind::RawTag)
             return dep.version;
 
-        ulib::string kind_str = "@";
-
-        switch (dep.version_kind)
-        {
-        case DependencyVersionKind::Equal:
-            kind_str = "==";
-            break;
-        case DependencyVersionKind::Greater:
-            kind_str = "<";
-            break;
-        case DependencyVersionKind::GreaterEqual:
-            kind_str = ">=";
-            break;
-        case DependencyVersionKind::Less:
-            kind_str = "<";
-            break;
-        case DependencyVersionKind::LessEqual:
-            kind_str = "<=";
-            break;
-        case DependencyVersionKind::SameMinor:
-            kind_str = "~";
-            break;
-        case DependencyVersionKind::SameMajor:
-            kind_str = "^";
-            break;
-        };
-
-        auto existing_key = ulib::format("{}:{}{}{}", dep.ns, dep.name, kind_str, dep.version);
+        auto existing_key = GetLockKey(dep);
 
         auto &existing = mData[existing_key];
 
@@ -48,76 +21,145 @@ namespace re
         if (available.empty())
             RE_THROW TargetDependencyException(&target, "no versions for '{}'", dep.raw);
 
-        auto erase_cond_negated = [](auto &cont, const auto &value, const auto &pred) {
-            cont.erase(std::remove_if(cont.begin(), cont.end(),
-                                      [&pred, &value](const auto &x) {
-                                          try
-                                          {
-                                              return !(pred(semverpp::version{std::string(x)}, value));
-                                          }
-                                          catch (semverpp::invalid_version)
-                                          {
-                                              return true;
-                                          }
-                                      }),
-                       cont.end());
-        };
+        available.erase(std::remove_if(available.begin(), available.end(),
+                                       [&dep](const std::string &version) { return !MatchesRequirements(dep, version); }),
+                        available.end());
+
+        if (available.empty())
+            RE_THROW TargetDependencyException(&target, "no matching versions for '{}'", dep.raw);
+
+        std::sort(available.begin(), available.end(), [](const std::string &a, const std::string &b) {
+            return semverpp::version{a} > semverpp::version{b};
+        });
 
-        /*
-                fmt::print("\n # result_all: {} -> [\n", dep.raw);
+        const auto &version = available.at(0);
+        existing = version;
 
-                for (auto &ver : available)
-                    fmt::print("    {} @ {}\n", ver, semverpp::version{ver}.string());
+        fmt::print("\n # result: {} -> [\n", dep.raw);
 
-                fmt::print("]; dep.version_sv={}\n", dep.version_sv.string());
-                */
+        for (auto &ver : available)
+            fmt::print("    {} @ {}\n", ver, semverpp::version{std::string(ver)}.string());
+
+        fmt::print("]\n");
+
+        return version;
+    }
+
+    bool DepsVersionCache::MatchesRequirements(const TargetDependency &dep, const std::string &version)
+    {
+        if (dep.version_kind == DependencyVersionKind::RawTag)
+            return version == std::string(dep.version);
+
+        try
+        {
+            semverpp::version v{version};
+
+            switch (dep.version_kind)
+            {
+            case DependencyVersionKind::Equal:
+                return v == dep.version_sv;
+            case DependencyVersionKind::Greater:
+                return v > dep.version_sv;
+            case DependencyVersionKind::GreaterEqual:
+                return v >= dep.version_sv;
+            case DependencyVersionKind::Less:
+                return v < dep.version_sv;
+            case DependencyVersionKind::LessEqual:
+                return v <= dep.version_sv;
+            case DependencyVersionKind::SameMinor:
+                return v >= dep.version_sv && v.major == dep.version_sv.major && v.minor == dep.version_sv.minor;
+            case DependencyVersionKind::SameMajor:
+                return v >= dep.version_sv && v.major == dep.version_sv.major;
+            default:
+                return false;
+            };
+        }
+        catch (semverpp::invalid_version)
+        {
+            return false;
+        }
+    }
+
+    std::optional<std::string> DepsVersionCache::GetLockedVersion(const TargetDependency &dep) const
+    {
+        if (dep.version_kind == DependencyVersionKind::RawTag)
+            return std::string(dep.version);
+
+        auto it = mData.find(GetLockKey(dep));
+
+        if (it == mData.end() || !it->is_string())
+            return std::nullopt;
+
+        return it->get<std::string>();
+    }
+
+    void DepsVersionCache::SetLockedVersion(const TargetDependency &dep, const std::string &version)
+    {
+        if (dep.version_kind != DependencyVersionKind::RawTag)
+            mData[GetLockKey(dep)] = version;
+    }
+
+    std::optional<std::string> DepsVersionCache::GetLockedHash(const TargetDependency &dep) const
+    {
+        auto it = mData.find(GetLockKey(dep) + "#sha256");
+
+        if (it == mData.end() || !it->is_string())
+            return std::nullopt;
+
+        return it->get<std::string>();
+    }
+
+    void DepsVersionCache::SetLockedHash(const TargetDependency &dep, const std::string &hash)
+    {
+        mData[GetLockKey(dep) + "#sha256"] = hash;
+    }
+
+    void DepsVersionCache::RemoveLockedVersion(const TargetDependency &dep)
+    {
+        auto key = GetLockKey(dep);
+
+        mData.erase(key);
+        mData.erase(key + "#sha256");
+    }
+
+    bool DepsVersionCache::HasLockedVersion(const TargetDependency &dep) const
+    {
+        if (dep.version_kind == DependencyVersionKind::RawTag)
+            return true;
+
+        auto it = mData.find(GetLockKey(dep));
+        return it != mData.end() && !it->is_null();
+    }
+
+    ulib::string DepsVersionCache::GetLockKey(const TargetDependency &dep)
+    {
+        ulib::string kind_str = "@";
 
         switch (dep.version_kind)
         {
         case DependencyVersionKind::Equal:
-            erase_cond_negated(available, dep.version_sv, std::equal_to<semverpp::version>{});
+            kind_str = "==";
             break;
         case DependencyVersionKind::Greater:
-            erase_cond_negated(available, dep.version_sv, std::greater<semverpp::version>{});
+            kind_str = "<";
             break;
         case DependencyVersionKind::GreaterEqual:
-            erase_cond_negated(available, dep.version_sv, std::greater_equal<semverpp::version>{});
+            kind_str = ">=";
             break;
         case DependencyVersionKind::Less:
-            erase_cond_negated(available, dep.version_sv, std::less<semverpp::version>{});
+            kind_str = "<";
             break;
         case DependencyVersionKind::LessEqual:
-            erase_cond_negated(available, dep.version_sv, std::less_equal<semverpp::version>{});
+            kind_str = "<=";
             break;
         case DependencyVersionKind::SameMinor:
-            erase_cond_negated(available, dep.version_sv, [](const semverpp::version &a, const semverpp::version &b) {
-                return a >= b && a.major == b.major && a.minor == b.minor;
-            });
+            kind_str = "~";
             break;
         case DependencyVersionKind::SameMajor:
-            erase_cond_negated(available, dep.version_sv, [](const semverpp::version &a, const semverpp::version &b) {
-                return a >= b && a.major == b.major;
-            });
+            kind_str = "^";
             break;
         };
 
-        if (available.empty())
-            RE_THROW TargetDependencyException(&target, "no matching versions for '{}'", dep.raw);
-
-        std::sort(available.begin(), available.end(), [](const std::string &a, const std::string &b) {
-            return semverpp::version{a} > semverpp::version{b};
-        });
-
-        const auto &version = available.at(0);
-        existing = version;
-
-        fmt::print("\n # result: {} -> [\n", dep.raw);
-
-        for (auto &ver : available)
-            fmt::print("    {} @ {}\n", ver, semverpp::version{std::string(ver)}.string());
-
-        fmt::print("]\n");
-
-        return version;
+        return ulib::format("{}:{}{}{}", dep.ns, dep.name, kind_str, dep.version);
     }
 } // namespace re
@@ -13,6 +13,7 @@
 
 #include <nlohmann/json.hpp>
 #include <functional>
+#include <optional>
 
 namespace re
 {
@@ -62,6 +63,69 @@ namespace re
             std::function<std::vector<std::string>(const re::TargetDependency &, const std::string&)> get_available_versions
         );
 
+        /**
+         * @brief Checks whether the dependency's version is already pinned, meaning that no available versions have
+         * to be looked up to resolve it.
+         * 
+         * @param dep The dependency to check
+         * 
+         * @return true If GetLatestVersionMatchingRequirements won't need the available versions
+         */
+        bool HasLockedVersion(const TargetDependency& dep) const;
+
+        /**
+         * @brief Gets the version a dependency is pinned to.
+         * 
+         * @param dep The dependency to look up
+         * 
+         * @return std::optional<std::string> The pinned version (or the raw tag itself), if any
+         */
+        std::optional<std::string> GetLockedVersion(const TargetDependency& dep) const;
+
+        /**
+         * @brief Pins a dependency to a version, replacing the previously pinned one.
+         * All dependencies with the same name and version requirements will resolve to this version.
+         * 
+         * @param dep The dependency to pin
+         * @param version The version to pin it to
+         */
+        void SetLockedVersion(const TargetDependency& dep, const std::string& version);
+
+        /**
+         * @brief Gets the content hash a dependency is pinned to, for dependencies whose contents aren't identified
+         * by their version alone (like archives downloaded from a URL).
+         * 
+         * @param dep The dependency to look up
+         * 
+         * @return std::optional<std::string> The pinned SHA-256, if any
+         */
+        std::optional<std::string> GetLockedHash(const TargetDependency& dep) const;
+
+        /**
+         * @brief Pins a dependency's contents to a hash, replacing the previously pinned one.
+         * 
+         * @param dep The dependency to pin
+         * @param hash The SHA-256 to pin it to
+         */
+        void SetLockedHash(const TargetDependency& dep, const std::string& hash);
+
+        /**
+         * @brief Unpins a dependency's version and content hash, for requirements nothing has anymore.
+         * 
+         * @param dep The dependency to unpin
+         */
+        void RemoveLockedVersion(const TargetDependency& dep);
+
+        /**
+         * @brief Checks whether a version satisfies a dependency's version requirements.
+         * 
+         * @param dep The dependency to check against
+         * @param version The version to check
+         * 
+         * @return true If the dependency can be resolved to this version
+         */
+        static bool MatchesRequirements(const TargetDependency& dep, const std::string& version);
+
         /**
          * @brief Returns the JSON state data associated with the cache.
          * This can be saved and later re-loaded into the DepsVersionCache to get the same outputs.
@@ -70,6 +134,13 @@ namespace re
          */
         const nlohmann::json& GetData() const { return mData; }
 
+        /**
+         * @brief Gets the key a dependency is pinned under: dependencies with the same key share their pinned version.
+         * 
+         * @param dep The dependency
+         */
+        static ulib::string GetLockKey(const TargetDependency& dep);
+
     private:
         nlohmann::json mData;
     };
@@ -0,0 +1,251 @@
+#include "dir_enumerator.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace re
+{
+    namespace
+    {
+        std::atomic<std::uint64_t> gDirectories{0};
+        std::atomic<std::uint64_t> gEntries{0};
+        std::atomic<std::uint64_t> gStatCalls{0};
+
+        constexpr std::string_view kTargetConfigName = "re.yml";
+        constexpr std::string_view kIgnoreMarkerName = ".re-ignore-this";
+        constexpr std::string_view kPartitionSuffix = ".re.yml";
+
+        void NoteMarkerFile(DirListing &listing, const std::string &name)
+        {
+            if (name == kTargetConfigName)
+                listing.has_target_config = true;
+            else if (name == kIgnoreMarkerName)
+                listing.has_ignore_marker = true;
+            else if (name.size() > kPartitionSuffix.size() &&
+                     name.compare(name.size() - kPartitionSuffix.size(), kPartitionSuffix.size(), kPartitionSuffix) ==
+                         0)
+                listing.partitions.push_back(name);
+        }
+
+#if defined(__linux__)
+        struct LinuxDirent64
+        {
+            ino64_t d_ino;
+            off64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+        };
+
+        std::int64_t ToNanoseconds(std::int64_t sec, std::int64_t nsec)
+        {
+            return sec * 1'000'000'000 + nsec;
+        }
+
+        /**
+         * @brief Fills in a FileStatus with statx, asking the filesystem for just the fields stamps need.
+         */
+        bool StatAt(int dirfd, const char *path, int flags, FileStatus &out)
+        {
+            gStatCalls++;
+
+#if defined(STATX_MTIME)
+            struct statx stx;
+
+            if (statx(dirfd, path, flags, STATX_TYPE | STATX_MTIME | STATX_SIZE, &stx) != 0)
+                return false;
+
+            out.exists = true;
+            out.directory = S_ISDIR(stx.stx_mode);
+            out.mtime = ToNanoseconds(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+            out.size = out.directory ? 0 : stx.stx_size;
+#else
+            struct stat st;
+
+            if (fstatat(dirfd, path, &st, flags) != 0)
+                return false;
+
+            out.exists = true;
+            out.directory = S_ISDIR(st.st_mode);
+            out.mtime = ToNanoseconds(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+            out.size = out.directory ? 0 : st.st_size;
+#endif
+            return true;
+        }
+
+        [[noreturn]] void ThrowErrno(const char *what, const fs::path &path)
+        {
+            throw fs::filesystem_error{what, path, std::error_code{errno, std::system_category()}};
+        }
+#endif
+    } // namespace
+
+#if defined(__linux__)
+    DirListing EnumerateDirectory(const fs::path &path)
+    {
+        DirListing listing;
+
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if (fd < 0)
+            ThrowErrno("cannot open directory", path);
+
+        gDirectories++;
+
+        // Stamp the directory before reading it so that concurrent changes are never missed
+        FileStatus status;
+
+        if (StatAt(fd, "", AT_EMPTY_PATH, status))
+            listing.mtime = status.mtime;
+
+        alignas(LinuxDirent64) char buffer[32 * 1024];
+
+        while (true)
+        {
+            auto length = syscall(SYS_getdents64, fd, buffer, sizeof buffer);
+
+            if (length < 0)
+            {
+                auto error = errno;
+                close(fd);
+
+                errno = error;
+                ThrowErrno("cannot read directory", path);
+            }
+
+            if (length == 0)
+                break;
+
+            for (long offset = 0; offset < length;)
+            {
+                auto dirent = reinterpret_cast<const LinuxDirent64 *>(buffer + offset);
+                offset += dirent->d_reclen;
+
+                std::string name = dirent->d_name;
+
+                if (name == "." || name == "..")
+                    continue;
+
+                gEntries++;
+
+                DirEntryType type = DirEntryType::Other;
+
+                if (dirent->d_type == DT_DIR)
+                    type = DirEntryType::Directory;
+                else if (dirent->d_type == DT_REG)
+                    type = DirEntryType::File;
+                else if (dirent->d_type == DT_UNKNOWN || dirent->d_type == DT_LNK)
+                {
+                    // Some filesystems (older NFS and XFS setups) don't report types; symlinks need to be followed
+                    FileStatus entry_status;
+
+                    if (StatAt(fd, name.c_str(), 0, entry_status))
+                        type = entry_status.directory ? DirEntryType::Directory : DirEntryType::File;
+                }
+
+                if (type == DirEntryType::File)
+                    NoteMarkerFile(listing, name);
+
+                listing.entries.push_back(DirEntry{std::move(name), type});
+            }
+        }
+
+        close(fd);
+
+        std::sort(listing.partitions.begin(), listing.partitions.end());
+        return listing;
+    }
+
+    FileStatus GetFileStatus(const fs::path &path)
+    {
+        FileStatus status;
+
+        if (!StatAt(AT_FDCWD, path.c_str(), 0, status))
+            return FileStatus{};
+
+        return status;
+    }
+#else
+    DirListing EnumerateDirectory(const fs::path &path)
+    {
+        DirListing listing;
+        listing.mtime = GetFileStatus(path).mtime;
+
+        gDirectories++;
+
+        for (auto &entry : fs::directory_iterator{path})
+        {
+            gEntries++;
+
+            auto name = entry.path().filename().u8string();
+            auto type = DirEntryType::Other;
+
+            if (entry.is_directory())
+                type = DirEntryType::Directory;
+            else if (entry.is_regular_file())
+                type = DirEntryType::File;
+
+            if (type == DirEntryType::File)
+                NoteMarkerFile(listing, name);
+
+            listing.entries.push_back(DirEntry{std::move(name), type});
+        }
+
+        std::sort(listing.partitions.begin(), listing.partitions.end());
+        return listing;
+    }
+
+    FileStatus GetFileStatus(const fs::path &path)
+    {
+        FileStatus status;
+        std::error_code ec;
+
+        gStatCalls++;
+
+        auto fs_status = fs::status(path, ec);
+
+        if (ec || !fs::exists(fs_status))
+            return status;
+
+        auto time = fs::last_write_time(path, ec);
+
+        if (ec)
+            return status;
+
+        status.exists = true;
+        status.directory = fs::is_directory(fs_status);
+        status.mtime = time.time_since_epoch().count();
+
+        if (!status.directory)
+        {
+            auto size = fs::file_size(path, ec);
+
+            if (!ec)
+                status.size = size;
+        }
+
+        return status;
+    }
+#endif
+
+    DirEnumerationStats GetDirEnumerationStats()
+    {
+        DirEnumerationStats stats;
+
+        stats.directories = gDirectories;
+        stats.entries = gEntries;
+        stats.stat_calls = gStatCalls;
+
+        return stats;
+    }
+} // namespace re
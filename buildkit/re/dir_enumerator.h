@@ -0,0 +1,117 @@
+/**
+ * @file re/dir_enumerator.h
+ * @brief Low-overhead directory enumeration for source tree loading
+ */
+
+#pragma once
+#include <re/fs.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief The type of a directory entry, with symlinks already resolved.
+     */
+    enum class DirEntryType
+    {
+        File,
+        Directory,
+        Other
+    };
+
+    struct DirEntry
+    {
+        std::string name;
+        DirEntryType type;
+    };
+
+    /**
+     * @brief Everything Re needs to know about a directory, gathered in a single pass over its entries.
+     */
+    struct DirListing
+    {
+        /**
+         * @brief The directory's last write time, taken before reading its entries.
+         */
+        std::int64_t mtime = 0;
+
+        /**
+         * @brief All entries except for `.` and `..`, in the order the filesystem returned them.
+         */
+        std::vector<DirEntry> entries;
+
+        /**
+         * @brief Whether the directory contains a `re.yml` file.
+         */
+        bool has_target_config = false;
+
+        /**
+         * @brief Whether the directory contains a `.re-ignore-this` marker.
+         */
+        bool has_ignore_marker = false;
+
+        /**
+         * @brief Names of the `*.re.yml` config partitions in the directory, sorted.
+         */
+        std::vector<std::string> partitions;
+    };
+
+    /**
+     * @brief The basic status of a path as needed for file stamps.
+     */
+    struct FileStatus
+    {
+        bool exists = false;
+        bool directory = false;
+
+        std::int64_t mtime = 0;
+        std::uint64_t size = 0;
+    };
+
+    /**
+     * @brief Lists a directory.
+     *
+     * On Linux this reads raw `getdents64` records and only stats entries whose type the filesystem did not report
+     * (or symlinks). The directory's own mtime is taken from the open descriptor with `statx`.
+     *
+     * @param path The directory to list
+     *
+     * @return DirListing The directory listing
+     *
+     * @throws fs::filesystem_error Thrown if the directory could not be opened or read.
+     */
+    DirListing EnumerateDirectory(const fs::path &path);
+
+    /**
+     * @brief Gets the status of a path with a single system call where possible.
+     *
+     * Modification times are only comparable to the ones returned by this function and EnumerateDirectory.
+     *
+     * @param path The path to check
+     *
+     * @return FileStatus The path's status (exists == false if it could not be accessed)
+     */
+    FileStatus GetFileStatus(const fs::path &path);
+
+    /**
+     * @brief Counters describing the filesystem work done by directory enumeration.
+     */
+    struct DirEnumerationStats
+    {
+        std::uint64_t directories = 0;
+        std::uint64_t entries = 0;
+
+        /**
+         * @brief Stat-like calls actually made: unknown entry types, directory and file stamps.
+         */
+        std::uint64_t stat_calls = 0;
+    };
+
+    /**
+     * @brief Gets the process-wide directory enumeration counters.
+     */
+    DirEnumerationStats GetDirEnumerationStats();
+} // namespace re
@@ -1,5 +1,6 @@
 #include "cmake_lang_provider.h"
 
+#include <re/build/ninja_rebase.h>
 #include <re/target.h>
 #include <re/target_cfg_utils.h>
 
@@ -43,21 +44,47 @@ namespace re
             {"config", vars.ResolveLocal("configuration")}};
 
         target.resolved_config = GetResolvedTargetCfg(target, configuration);
+        target.BuildVarIndex();
     }
 
     bool CMakeLangProvider::InitBuildTargetRules(NinjaBuildDesc &desc, const Target &target)
     {
-        if (auto build_script = target.resolved_config.search("cmake-out-build-script"))
+        auto build_script = target.resolved_config.search("cmake-out-build-script");
+
+        if (build_script)
         {
             if (std::find(desc.subninjas.begin(), desc.subninjas.end(), std::string{build_script->scalar()}) ==
                 desc.subninjas.end())
+            {
                 desc.subninjas.push_back(build_script->scalar());
+
+                if (mVarScope->GetVar("cmake-build-all-targets").value_or("false") == "true")
+                    desc.subninja_outputs[std::string{build_script->scalar()}].push_back(
+                        (fs::path{build_script->scalar()}.parent_path() / "all").generic_u8string());
+            }
         }
 
         if (auto cmake_meta = target.resolved_config["cmake-meta"]["targets"].search(target.name))
+        {
             if (auto location = cmake_meta->search("location"))
+            {
                 desc.artifacts[&target] = fs::path{location->scalar()};
 
+                // Only the CMake targets that are part of the build get built out of the whole CMake project
+                if (build_script)
+                {
+                    auto &outputs = desc.subninja_outputs[std::string{build_script->scalar()}];
+
+                    if (std::find(outputs.begin(), outputs.end(), std::string{location->scalar()}) == outputs.end())
+                        outputs.push_back(location->scalar());
+
+                    // Makes the C++ targets linking against this one depend on it in the build graph
+                    desc.vars["cxx_artifact_" + GetEscapedModulePath(target)] =
+                        EscapeNinjaPath(fs::path{location->scalar()}.lexically_normal().generic_u8string());
+                }
+            }
+        }
+
         return true;
     }
 
@@ -1,13 +1,54 @@
 #include "cmake_target_load_middleware.h"
 
+#include <re/dir_enumerator.h>
 #include <re/process_util.h>
 #include <re/target_cfg_utils.h>
 
+#include <re/dep_fetch_scheduler.h>
+
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <futile/futile.h>
+#include <iterator>
 
 namespace re
 {
+    namespace
+    {
+        std::vector<fs::path> GetCMakeInputFiles(const fs::path &dir)
+        {
+            std::vector<fs::path> files;
+
+            if (!fs::is_directory(dir))
+                return files;
+
+            std::error_code ec;
+
+            for (auto it = fs::recursive_directory_iterator{dir, ec}; it != fs::recursive_directory_iterator{};
+                 it.increment(ec))
+            {
+                auto name = it->path().filename().u8string();
+
+                // Hidden directories (.git, .re-cache) and the default output directory hold no project files
+                if (it->is_directory(ec))
+                {
+                    if (name.front() == '.' || (it.depth() == 0 && name == "out"))
+                        it.disable_recursion_pending();
+
+                    continue;
+                }
+
+                if (name == "CMakeLists.txt" || it->path().extension() == ".cmake" ||
+                    (name.size() > 9 && name.compare(name.size() - 9, 9, ".cmake.in") == 0))
+                    files.push_back(it->path());
+            }
+
+            std::sort(files.begin(), files.end());
+            return files;
+        }
+    } // namespace
+
     bool CMakeTargetLoadMiddleware::SupportsTargetLoadPath(const fs::path &path)
     {
         //
@@ -18,9 +59,24 @@ namespace re
         return fs::exists(path / "CMakeLists.txt") && !fs::exists(path / "re.yml");
     }
 
-    std::unique_ptr<Target> CMakeTargetLoadMiddleware::LoadTargetWithMiddleware(const fs::path &path,
-                                                                                const Target *ancestor,
-                                                                                const TargetDependency *dep_source)
+    std::shared_future<void> CMakeTargetLoadMiddleware::PrepareTargetLoadAsync(const fs::path &path,
+                                                                               const Target *ancestor,
+                                                                               const TargetDependency *dep_source,
+                                                                               DepFetchScheduler &scheduler)
+    {
+        auto step = GetConfigureStep(path, ancestor, dep_source);
+
+        if (step.up_to_date)
+            return {};
+
+        mOut->Info(fg(fmt::color::cornflower_blue) | fmt::emphasis::bold,
+                   " * CMakeTargetLoadMiddleware: Configuring CMake project '{}'\n", path.generic_u8string());
+
+        return scheduler.Schedule("cmake", step.out_dir.u8string(), [this, step] { RunConfigureStep(step); });
+    }
+
+    CMakeTargetLoadMiddleware::ConfigureStep CMakeTargetLoadMiddleware::GetConfigureStep(
+        const fs::path &path, const Target *ancestor, const TargetDependency *dep_source)
     {
         auto canonical_path = fs::canonical(path);
 
@@ -68,116 +124,229 @@ namespace re
             cxx_std_override = "20";
 
         auto bin_dir = out_dir / "build";
+        auto meta_path = out_dir / "re-cmake-meta.yml";
 
-        fs::create_directories(bin_dir);
+        ulib::list<ulib::string> cmdline = {"cmake", "-G", "Ninja"};
 
-        mOut->Info(fg(fmt::color::cornflower_blue) | fmt::emphasis::bold,
-                   "\n * CMakeTargetLoadMiddleware: Loading CMake project target from '{}'\n", path.generic_u8string());
+        cmdline.emplace_back("-DRE_ORIGINAL_CMAKE_DIR=" + canonical_path.generic_u8string());
+        cmdline.emplace_back("-DRE_BIN_OUT_DIR=" + bin_dir.generic_u8string());
+        cmdline.emplace_back("-DRE_ADAPTED_META_FILE=" + meta_path.generic_u8string());
+        cmdline.emplace_back("-DCMAKE_BUILD_TYPE=" + config);
 
-        auto meta_path = out_dir / "re-cmake-meta.yml";
+        if (dep_source && !dep_source->extra_config.is_null())
+        {
+            auto parse_config_for_target = [&cmdline, &arch, &platform, &config](
+                                               const ulib::yaml &node, const ulib::list<ulib::string> &targets) {
+                std::string defs_private, defs_public;
 
-        bool should_rebuild = true;
+                for (auto &kv : node["cxx-compile-definitions"].items())
+                    defs_private.append(fmt::format("{}={};", kv.name(), kv.value().scalar()));
 
-        if (ancestor && ancestor->build_var_scope->GetVar("cmake-reconfigure").value_or("false") == "true")
-            should_rebuild = true;
+                for (auto &kv : node["cxx-compile-definitions-public"].items())
+                    defs_public.append(fmt::format("{}={};", kv.name(), kv.value().scalar()));
 
-        ulib::yaml cmake_meta{ulib::yaml::value_t::null};
+                for (auto &target : targets)
+                {
+                    cmdline.emplace_back(
+                        fmt::format("-DRE_CUSTOM_COMPILE_DEFINITIONS_PRIVATE_{}={}", target, defs_private));
+                    cmdline.emplace_back(
+                        fmt::format("-DRE_CUSTOM_COMPILE_DEFINITIONS_PUBLIC_{}={}", target, defs_public));
+                }
 
-        if (fs::exists(meta_path))
-        {
-            cmake_meta = ulib::yaml::parse(futile::open(meta_path).read());
+                for (auto kv : node["cmake-extra-options"].items())
+                    cmdline.emplace_back(fmt::format("-D{}={}", kv.name(), kv.value().scalar()));
+            };
+
+            auto resolved = GetFlatResolvedTargetCfg(dep_source->extra_config,
+                                                     {{"arch", arch}, {"platform", platform}, {"config", config}});
+
+            if (dep_source->filters.empty())
+                parse_config_for_target(resolved, {"ALL"});
+            else
+                parse_config_for_target(resolved, dep_source->filters);
 
-            should_rebuild = false;
+            for (auto &kv : resolved.items())
+            {
+                constexpr auto kCMakeTargetPrefix = "cmake-target.";
 
-            if (!should_rebuild && dep_source &&
-                cmake_meta["last-build-ecfg-hash"].get<std::size_t>() != dep_source->extra_config_data_hash)
-                should_rebuild = true;
+                if (kv.name().find(kCMakeTargetPrefix) == 0)
+                    parse_config_for_target(kv.value(), {kv.name().substr(sizeof kCMakeTargetPrefix)});
+            }
         }
 
-        if (should_rebuild)
-        {
-            mOut->Info(fg(fmt::color::dim_gray) | fmt::emphasis::bold, "     Rebuilding CMake cache...\n\n");
+        cmdline.emplace_back(fmt::format("-DRE_ECFG_HASH={}", dep_source ? dep_source->extra_config_data_hash : 0));
 
-            ulib::list<ulib::string> cmdline = {"cmake", "-G", "Ninja"};
+        cmdline.emplace_back("-DCMAKE_C_COMPILER_WORKS=1");
+        cmdline.emplace_back("-DCMAKE_CXX_COMPILER_WORKS=1");
 
-            cmdline.emplace_back("-DRE_ORIGINAL_CMAKE_DIR=" + canonical_path.generic_u8string());
-            cmdline.emplace_back("-DRE_BIN_OUT_DIR=" + bin_dir.generic_u8string());
-            cmdline.emplace_back("-DRE_ADAPTED_META_FILE=" + meta_path.generic_u8string());
-            cmdline.emplace_back("-DCMAKE_BUILD_TYPE=" + config);
+        if (compiler_override.size())
+        {
+            cmdline.emplace_back("-DCMAKE_C_COMPILER=" + compiler_override);
+            cmdline.emplace_back("-DCMAKE_CXX_COMPILER=" + compiler_override);
+        }
 
-            if (dep_source && !dep_source->extra_config.is_null())
-            {
-                auto parse_config_for_target = [&cmdline, &arch, &platform, &config](
-                                                   const ulib::yaml &node, const ulib::list<ulib::string> &targets) {
-                    std::string defs_private, defs_public;
+        if (link_flags.size())
+        {
+            cmdline.emplace_back("-DRE_CUSTOM_LINK_OPTS=" + link_flags);
+            cmdline.emplace_back("-DCMAKE_EXE_LINKER_FLAGS=" + link_flags);
+            cmdline.emplace_back("-DLINKER_FLAGS=" + link_flags);
+            cmdline.emplace_back("-DLINK_FLAGS=" + link_flags);
+        }
 
-                    for (auto &kv : node["cxx-compile-definitions"].items())
-                        defs_private.append(fmt::format("{}={};", kv.name(), kv.value().scalar()));
+        if (cxx_std_override.size())
+            cmdline.emplace_back("-DCMAKE_CXX_STANDARD=" + cxx_std_override);
 
-                    for (auto &kv : node["cxx-compile-definitions-public"].items())
-                        defs_public.append(fmt::format("{}={};", kv.name(), kv.value().scalar()));
+        cmdline.emplace_back("-B");
+        cmdline.emplace_back(out_dir.generic_u8string());
+        cmdline.emplace_back(mAdapterPath.generic_u8string());
 
-                    for (auto &target : targets)
-                    {
-                        cmdline.emplace_back(
-                            fmt::format("-DRE_CUSTOM_COMPILE_DEFINITIONS_PRIVATE_{}={}", target, defs_private));
-                        cmdline.emplace_back(
-                            fmt::format("-DRE_CUSTOM_COMPILE_DEFINITIONS_PUBLIC_{}={}", target, defs_public));
-                    }
+        ConfigureStep step;
 
-                    for (auto kv : node["cmake-extra-options"].items())
-                        cmdline.emplace_back(fmt::format("-D{}={}", kv.name(), kv.value().scalar()));
-                };
+        step.source_dir = canonical_path;
+        step.out_dir = out_dir;
+        step.bin_dir = bin_dir;
+        step.meta_path = meta_path;
 
-                auto resolved = GetFlatResolvedTargetCfg(dep_source->extra_config,
-                                                         {{"arch", arch}, {"platform", platform}, {"config", config}});
+        step.arch = arch;
+        step.config = config;
+        step.platform = platform;
 
-                if (dep_source->filters.empty())
-                    parse_config_for_target(resolved, {"ALL"});
-                else
-                    parse_config_for_target(resolved, dep_source->filters);
+        auto reconfigure =
+            ancestor && ancestor->build_var_scope->GetVar("cmake-reconfigure").value_or("false") == "true";
 
-                for (auto &kv : resolved.items())
-                {
-                    constexpr auto kCMakeTargetPrefix = "cmake-target.";
+        {
+            std::lock_guard lock{mMutex};
 
-                    if (kv.name().find(kCMakeTargetPrefix) == 0)
-                        parse_config_for_target(kv.value(), {kv.name().substr(sizeof kCMakeTargetPrefix)});
-                }
+            // Projects configured by this very run are up to date no matter what
+            if (mConfigured.count(out_dir.u8string()))
+            {
+                step.cmdline = std::move(cmdline);
+                step.up_to_date = true;
+                return step;
             }
+        }
 
-            cmdline.emplace_back(fmt::format("-DRE_ECFG_HASH={}", dep_source ? dep_source->extra_config_data_hash : 0));
+        step.input_stamp = GetFingerprint(canonical_path, cmdline, compiler_override, false);
 
-            cmdline.emplace_back("-DCMAKE_C_COMPILER_WORKS=1");
-            cmdline.emplace_back("-DCMAKE_CXX_COMPILER_WORKS=1");
+        if (!reconfigure && fs::exists(meta_path))
+        {
+            std::ifstream file{out_dir / "re-cmake-fingerprint"};
+            std::string fingerprint, input_stamp;
+
+            std::getline(file, fingerprint);
+            std::getline(file, input_stamp);
 
-            if (compiler_override.size())
+            // Nothing has been touched since the last configuration: no need to read every CMake file again
+            if (!input_stamp.empty() && input_stamp == step.input_stamp)
             {
-                cmdline.emplace_back("-DCMAKE_C_COMPILER=" + compiler_override);
-                cmdline.emplace_back("-DCMAKE_CXX_COMPILER=" + compiler_override);
+                step.fingerprint = std::move(fingerprint);
+                step.up_to_date = true;
             }
+            else
+            {
+                step.fingerprint = GetFingerprint(canonical_path, cmdline, compiler_override, true);
+                step.up_to_date = fingerprint == step.fingerprint;
+
+                // Files were only touched: remember their new times so that they aren't hashed on every load
+                if (step.up_to_date)
+                    WriteFingerprint(step);
+            }
+        }
+        else
+        {
+            step.fingerprint = GetFingerprint(canonical_path, cmdline, compiler_override, true);
+        }
 
-            if (link_flags.size())
+        step.cmdline = std::move(cmdline);
+        return step;
+    }
+
+    void CMakeTargetLoadMiddleware::RunConfigureStep(const ConfigureStep &step)
+    {
+        fs::create_directories(step.bin_dir);
+
+        // Run CMake with our adapter script
+        RunProcessOrThrow("cmake", {}, step.cmdline, true, true);
+
+        // Only written once CMake has succeeded, so that failed configurations always run again
+        WriteFingerprint(step);
+
+        std::lock_guard lock{mMutex};
+        mConfigured.insert(step.out_dir.u8string());
+    }
+
+    void CMakeTargetLoadMiddleware::WriteFingerprint(const ConfigureStep &step)
+    {
+        std::ofstream file{step.out_dir / "re-cmake-fingerprint"};
+        file << step.fingerprint << "\n" << step.input_stamp << "\n";
+    }
+
+    std::string CMakeTargetLoadMiddleware::GetFingerprint(const fs::path &source_dir,
+                                                          const ulib::list<ulib::string> &cmdline,
+                                                          const std::string &compiler, bool hash_contents)
+    {
+        std::string inputs;
+
+        for (auto &arg : cmdline)
+            inputs += fmt::format("{}\n", arg);
+
+        // The project's own CMake files, along with the adapter script that loads them
+        for (auto &dir : {source_dir, mAdapterPath})
+        {
+            for (auto &file : GetCMakeInputFiles(dir))
             {
-                cmdline.emplace_back("-DRE_CUSTOM_LINK_OPTS=" + link_flags);
-                cmdline.emplace_back("-DCMAKE_EXE_LINKER_FLAGS=" + link_flags);
-                cmdline.emplace_back("-DLINKER_FLAGS=" + link_flags);
-                cmdline.emplace_back("-DLINK_FLAGS=" + link_flags);
+                if (!hash_contents)
+                {
+                    auto status = GetFileStatus(file);
+
+                    inputs += fmt::format("{}={}:{}\n", file.generic_u8string(), status.size, status.mtime);
+                    continue;
+                }
+
+                std::ifstream stream{file, std::ios::binary};
+                std::string data{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+
+                inputs += fmt::format("{}={:x}\n", file.generic_u8string(), HashFileContents(data));
             }
+        }
+
+        // The toolchain CMake picks up: a changed compiler needs the project to be configured again
+        for (auto var : {"CC", "CXX"})
+            if (auto value = std::getenv(var))
+                inputs += fmt::format("{}={}\n", var, value);
+
+        std::error_code ec;
+
+        if (!compiler.empty() && fs::exists(compiler, ec))
+            inputs += fmt::format("compiler={}:{}\n", fs::file_size(compiler, ec),
+                                  fs::last_write_time(compiler, ec).time_since_epoch().count());
 
-            if (cxx_std_override.size())
-                cmdline.emplace_back("-DCMAKE_CXX_STANDARD=" + cxx_std_override);
+        return fmt::format("{:016x}", HashFileContents(inputs));
+    }
+
+    std::unique_ptr<Target> CMakeTargetLoadMiddleware::LoadTargetWithMiddleware(const fs::path &path,
+                                                                                const Target *ancestor,
+                                                                                const TargetDependency *dep_source)
+    {
+        auto step = GetConfigureStep(path, ancestor, dep_source);
 
-            cmdline.emplace_back("-B");
-            cmdline.emplace_back(out_dir.generic_u8string());
-            cmdline.emplace_back(mAdapterPath.generic_u8string());
+        mOut->Info(fg(fmt::color::cornflower_blue) | fmt::emphasis::bold,
+                   "\n * CMakeTargetLoadMiddleware: Loading CMake project target from '{}'\n", path.generic_u8string());
 
-            // Run CMake with our adapter script
-            RunProcessOrThrow("cmake", {}, cmdline, true, true);
+        if (!step.up_to_date)
+        {
+            mOut->Info(fg(fmt::color::dim_gray) | fmt::emphasis::bold, "     Rebuilding CMake cache...\n\n");
+            RunConfigureStep(step);
         }
 
-        std::ifstream file{meta_path};
-        cmake_meta = ulib::yaml::parse(futile::open(meta_path).read());
+        auto &canonical_path = step.source_dir;
+        auto &out_dir = step.out_dir;
+        auto &arch = step.arch;
+        auto &config = step.config;
+        auto &platform = step.platform;
+        auto path_hash = std::hash<std::string>{}(canonical_path.generic_u8string());
+
+        auto cmake_meta = ulib::yaml::parse(futile::open(step.meta_path).read());
 
         TargetConfig target_config{ulib::yaml::value_t::map};
 
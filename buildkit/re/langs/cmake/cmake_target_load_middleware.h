@@ -2,6 +2,10 @@
 #include <re/target_load_middleware.h>
 #include <re/user_output.h>
 
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
 namespace re
 {
     class CMakeTargetLoadMiddleware : public ITargetLoadMiddleware
@@ -19,8 +23,57 @@ namespace re
             const TargetDependency* dep_source
         );
 
+        std::shared_future<void> PrepareTargetLoadAsync(
+            const fs::path& path,
+            const Target* ancestor,
+            const TargetDependency* dep_source,
+            DepFetchScheduler& scheduler
+        );
+
     private:
+        /**
+         * @brief Everything needed to configure a CMake project with the adapter script.
+         */
+        struct ConfigureStep
+        {
+            fs::path source_dir;
+            fs::path out_dir;
+            fs::path bin_dir;
+            fs::path meta_path;
+
+            std::string arch;
+            std::string config;
+            std::string platform;
+
+            ulib::list<ulib::string> cmdline;
+
+            /**
+             * @brief Hash of the project's CMake files, the toolchain and the options passed to CMake.
+             * The project is only configured again once it changes.
+             */
+            std::string fingerprint;
+
+            /**
+             * @brief Same as the fingerprint, but with the sizes and modification times of the CMake files instead of
+             * their contents. Files are only hashed again once this changes.
+             */
+            std::string input_stamp;
+
+            bool up_to_date = false;
+        };
+
         fs::path mAdapterPath;
         IUserOutput* mOut;
+
+        std::mutex mMutex;
+        std::unordered_set<std::string> mConfigured;
+
+        ConfigureStep GetConfigureStep(const fs::path& path, const Target* ancestor, const TargetDependency* dep_source);
+        void RunConfigureStep(const ConfigureStep& step);
+
+        void WriteFingerprint(const ConfigureStep& step);
+
+        std::string GetFingerprint(const fs::path& source_dir, const ulib::list<ulib::string>& cmdline, const std::string& compiler,
+                                   bool hash_contents);
     };
 }
@@ -5,6 +5,7 @@
 
 #include <re/target_cfg_utils.h>
 #include <re/yaml_merge.h>
+#include <re/yaml_parse_cache.h>
 
 #include <fstream>
 #include <futile/futile.h>
@@ -117,6 +118,7 @@ namespace re
             {"host-platform", vars.ResolveLocal("host-platform")}, {"config", vars.ResolveLocal("configuration")},
             {"load-context", vars.ResolveLocal("load-context")},   {"runtime", vars.ResolveLocal("runtime")}};
 
+        target.InvalidateVarIndex();
         target.resolved_config = GetResolvedTargetCfg(target, cond_desc);
 
         // Choose and load the correct build environment.
@@ -180,9 +182,12 @@ namespace re
                 if (!path.is_absolute())
                     path = target.path / path;
 
-                auto config = ulib::yaml::parse(futile::open(path).read());
+                // Includes are usually shared by lots of targets, so they're parsed just once
+                auto config = YamlParseCache::Get().ParseFile(path);
 
                 MergeYamlNode(target.config, config);
+                InvalidateResolvedTargetCfgCache();
+
                 target.resolved_config = GetResolvedTargetCfg(target, cond_desc);
             }
         }
@@ -218,6 +223,9 @@ namespace re
         // fmt::print("InitLinkEnv: Setting default root path: {} => {}", target.module, target.path.u8string());
         target.resolved_config["cxx-root-include-path"] = target.path.u8string();
 
+        // The configs are final from here on
+        target.BuildVarIndex();
+
         // Forward the C++ build tools definitions to the build system
         for (const auto &kv : env["tools"].items())
         {
@@ -264,8 +272,7 @@ namespace re
             if (!definitions.search(def.name()))
                 definitions[def.name()] = def.value();
 
-        std::vector<const Target *> include_deps;
-        PopulateTargetDependencySetNoResolve(&target, include_deps);
+        auto include_deps = desc.pDependencyGraph->GetDependencySet(target);
 
         /////////////////////////////////////////////////////////////////
 
@@ -627,23 +634,21 @@ namespace re
             return;
 
         auto path = GetEscapedModulePath(target);
-        auto &env = mEnvCache.at(desc.state.at("re_cxx_env_for_" + path));
-
-        bool eligible = false;
+        auto &env_name = desc.state.at("re_cxx_env_for_" + path);
+        auto &env = mEnvCache.at(env_name);
 
-        if (auto exts = env.search("supported-extensions"))
-            if (exts->is_sequence())
-                for (const auto &ext : *exts)
-                    if (ext.scalar() == file.extension)
-                        eligible = true;
+        auto [exts_it, inserted] = mEnvSourceExtensions.try_emplace(env_name);
 
-        if (auto exts = env.search("cxx-supported-extensions"))
-            if (exts->is_sequence())
-                for (const auto &ext : *exts)
-                    if (ext.scalar() == file.extension)
-                        eligible = true;
+        if (inserted)
+        {
+            for (auto key : {"supported-extensions", "cxx-supported-extensions"})
+                if (auto exts = env.search(key))
+                    if (exts->is_sequence())
+                        for (const auto &ext : *exts)
+                            exts_it->second.insert(GetSourceExtensionId(std::string{ext.scalar()}));
+        }
 
-        if (!eligible)
+        if (exts_it->second.find(file.extension_id) == exts_it->second.end())
             return;
 
         auto &meta = desc.meta["targets"][target.path.u8string()]["cxx"];
@@ -653,7 +658,7 @@ namespace re
         if (file.extension.front() == 'h') // C/C++ Header File: no need to build it
             return;
 
-        auto local_path = fs::relative(file.path, target.path).generic_u8string();
+        auto local_path = std::string{file.relative_path};
 
         auto extension = env["default-extensions"]["object"].scalar();
 
@@ -734,8 +739,7 @@ namespace re
                 link_target.in.append(" ");
             }
 
-        std::vector<const Target *> link_deps;
-        PopulateTargetDependencySetNoResolve(&target, link_deps);
+        auto link_deps = desc.pDependencyGraph->GetDependencySet(target);
 
         for (auto &dep : link_deps)
             if (dep != &target)
@@ -772,8 +776,8 @@ namespace re
         {
             // std::ifstream stream{ (mEnvSearchPath / name.data() / ".yml") };
 
-            auto &data = (mEnvCache[name.data()] = ulib::yaml::parse(
-                              futile::open(mEnvSearchPath.u8string() + "/" + name.data() + ".yml").read()));
+            auto &data = (mEnvCache[name.data()] = YamlParseCache::Get().ParseFile(
+                              fs::u8path(mEnvSearchPath.u8string() + "/" + name.data() + ".yml")));
 
             if (auto inherits = data.search("inherits"))
                 for (const auto &v : *inherits)
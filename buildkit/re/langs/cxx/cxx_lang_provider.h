@@ -8,6 +8,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace re
 {
@@ -38,6 +39,9 @@ namespace re
 		fs::path mEnvSearchPath;
 		std::unordered_map<std::string, CxxBuildEnvData> mEnvCache;
 
+		// Supported source extensions per environment, resolved to IDs on first use
+		std::unordered_map<std::string, std::unordered_set<SourceExtensionId>> mEnvSourceExtensions;
+
 		CxxBuildEnvData& LoadEnvOrThrow(std::string_view name, const Target& invokee);
 	};
 }
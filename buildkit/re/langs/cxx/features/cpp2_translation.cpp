@@ -11,7 +11,7 @@ namespace re
 
         for(auto& source : target.sources)
         {
-            auto out_file = target.root_path / out_dir / target.module / (source.path.lexically_relative(target.path).u8string() + ".cpp");
+            auto out_file = target.root_path / out_dir / target.module / (std::string{source.relative_path} + ".cpp");
 
             if(source.extension == "cpp2")
             {
@@ -24,8 +24,8 @@ namespace re
                     out_file.u8string()
                 }, true, true);
 
-                source.path = out_file;
-                source.extension = "cpp";
+                target.RelocateSource(source, out_file);
+                source.SetExtension("cpp");
             }
         }
     }
@@ -9,6 +9,7 @@ namespace re
 
         // target.config["cxx-root-include-path"] = symlinks_cache.u8string();
         target.resolved_config["cxx-root-include-path"] = symlinks_cache.u8string();
+        target.BuildVarIndex();
 
         if (fs::exists(symlinks_cache))
             return;
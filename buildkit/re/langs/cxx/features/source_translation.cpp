@@ -20,7 +20,7 @@ namespace re
                 continue;
 
             auto in_path = source.path;
-            ulib::string base_path = source.path.lexically_relative(target.path).u8string();
+            ulib::string base_path = ulib::string_view{source.relative_path.data(), source.relative_path.size()};
 
             int num_steps = 0;
 
@@ -37,8 +37,9 @@ namespace re
                         auto step_name = step["name"];
 
                         auto out_ext_node = step["out-extension"];
-                        ulib::string out_ext =
-                            !out_ext_node.is_null() ? out_ext_node.scalar() : ulib::string_view{source.extension};
+                        ulib::string out_ext = !out_ext_node.is_null()
+                                                   ? out_ext_node.scalar()
+                                                   : ulib::string_view{source.extension.data(), source.extension.size()};
 
                         auto out_path = out_root / (base_path + step_suffix + "." + out_ext);
 
@@ -52,7 +53,7 @@ namespace re
                         {
                             for (auto extension : *extensions)
                             {
-                                if (extension.scalar() == source.extension)
+                                if (GetSourceExtensionId(std::string{extension.scalar()}) == source.extension_id)
                                 {
                                     supported = true;
                                     break;
@@ -72,8 +73,8 @@ namespace re
 
                         target.unused_sources.push_back(source);
 
-                        source.path = out_path;
-                        source.extension = out_ext;
+                        target.RelocateSource(source, out_path);
+                        source.SetExtension(std::string{out_ext});
 
                         in_path = out_path;
 
@@ -93,7 +94,7 @@ namespace re
         for (auto &source : target.unused_sources)
         {
             auto in_path = source.path;
-            ulib::string base_path = source.path.lexically_relative(target.path).u8string();
+            ulib::string base_path = ulib::string_view{source.relative_path.data(), source.relative_path.size()};
 
             int num_steps = 0;
 
@@ -104,7 +105,8 @@ namespace re
                 ulib::string step_suffix = ulib::format("_st_step{}", num_steps);
 
                 auto out_ext_node = step.search("out-extension");
-                auto out_ext = out_ext_node ? out_ext_node->scalar() : ulib::string_view{source.extension};
+                auto out_ext = out_ext_node ? out_ext_node->scalar()
+                                            : ulib::string_view{source.extension.data(), source.extension.size()};
 
                 auto out_path = out_root / (base_path + step_suffix + "." + out_ext);
 
@@ -0,0 +1,285 @@
+#include "source_filter.h"
+
+#include <re/target.h>
+
+namespace re
+{
+    namespace
+    {
+        bool IsGlobComponent(std::string_view component)
+        {
+            return component.find_first_of("*?[") != std::string_view::npos;
+        }
+
+        /**
+         * @brief Matches a single character against the pattern element at pattern[i], advancing i past it.
+         */
+        bool MatchChar(std::string_view pattern, std::size_t &i, char c)
+        {
+            if (pattern[i] == '?')
+            {
+                i++;
+                return true;
+            }
+
+            auto end = pattern[i] == '[' ? pattern.find(']', i + 2) : std::string_view::npos;
+
+            // Not a (complete) character class: compare literally
+            if (end == std::string_view::npos)
+                return pattern[i++] == c;
+
+            auto negate = pattern[i + 1] == '!' || pattern[i + 1] == '^';
+            auto matched = false;
+
+            for (auto j = i + (negate ? 2 : 1); j < end; j++)
+            {
+                if (j + 2 < end && pattern[j + 1] == '-')
+                {
+                    matched |= c >= pattern[j] && c <= pattern[j + 2];
+                    j += 2;
+                }
+                else
+                    matched |= pattern[j] == c;
+            }
+
+            i = end + 1;
+            return matched != negate;
+        }
+
+        bool MatchComponent(std::string_view pattern, std::string_view text)
+        {
+            // Iterative wildcard matching, backtracking to the last star on mismatch
+            std::size_t p = 0, t = 0;
+            std::size_t star = std::string_view::npos, star_t = 0;
+
+            while (t < text.size())
+            {
+                if (p < pattern.size() && pattern[p] == '*')
+                {
+                    star = p++;
+                    star_t = t;
+                    continue;
+                }
+
+                if (auto next = p; p < pattern.size() && MatchChar(pattern, next, text[t]))
+                {
+                    p = next;
+                    t++;
+                    continue;
+                }
+
+                if (star == std::string_view::npos)
+                    return false;
+
+                p = star + 1;
+                t = ++star_t;
+            }
+
+            while (p < pattern.size() && pattern[p] == '*')
+                p++;
+
+            return p == pattern.size();
+        }
+
+        std::vector<std::string_view> SplitPath(std::string_view path)
+        {
+            std::vector<std::string_view> result;
+
+            while (!path.empty())
+            {
+                auto slash = path.find('/');
+                auto component = path.substr(0, slash);
+
+                if (!component.empty())
+                    result.push_back(component);
+
+                if (slash == std::string_view::npos)
+                    break;
+
+                path.remove_prefix(slash + 1);
+            }
+
+            return result;
+        }
+
+        bool MatchComponents(const std::vector<std::string> &pattern, std::size_t i,
+                             const std::vector<std::string_view> &path, std::size_t j, bool prefix_only)
+        {
+            for (; i < pattern.size(); i++, j++)
+            {
+                // With prefix_only set, running out of path means the pattern could still match something below it
+                if (j == path.size())
+                    return prefix_only;
+
+                if (pattern[i] == "**")
+                {
+                    for (auto k = j; k <= path.size(); k++)
+                        if (MatchComponents(pattern, i + 1, path, k, prefix_only))
+                            return true;
+
+                    return false;
+                }
+
+                if (!MatchComponent(pattern[i], path[j]))
+                    return false;
+            }
+
+            // The pattern matched one of the path's parent directories, which covers everything inside it
+            return j == path.size() || prefix_only;
+        }
+    } // namespace
+
+    void PathPatternSet::Add(std::string_view pattern)
+    {
+        Glob glob;
+
+        if (!pattern.empty() && pattern.back() == '/')
+        {
+            glob.directory_only = true;
+            pattern.remove_suffix(1);
+        }
+
+        // Like in .gitignore, a slash anywhere but at the end anchors the pattern to the target directory
+        glob.anchored = pattern.find('/') != std::string_view::npos;
+
+        auto components = SplitPath(pattern);
+
+        if (components.empty())
+            return;
+
+        auto has_globs = false;
+
+        for (auto &component : components)
+        {
+            has_globs |= IsGlobComponent(component);
+            glob.components.emplace_back(component);
+        }
+
+        if (!has_globs)
+        {
+            std::string key;
+
+            for (auto &component : components)
+            {
+                if (!key.empty())
+                    key += '/';
+
+                key += component;
+            }
+
+            if (glob.directory_only)
+                key += '/';
+
+            (glob.anchored ? mLiteralPaths : mLiteralNames).insert(std::move(key));
+            return;
+        }
+
+        mGlobs.emplace_back(std::move(glob));
+    }
+
+    bool PathPatternSet::Matches(std::string_view path, bool is_directory) const
+    {
+        auto slash = path.rfind('/');
+        auto name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+
+        if (!mLiteralPaths.empty() || !mLiteralNames.empty())
+        {
+            std::string key{path};
+
+            if (mLiteralPaths.count(key))
+                return true;
+
+            if (mLiteralNames.count(std::string{name}))
+                return true;
+
+            if (is_directory)
+            {
+                key += '/';
+
+                if (mLiteralPaths.count(key))
+                    return true;
+
+                if (mLiteralNames.count(std::string{name} + '/'))
+                    return true;
+            }
+        }
+
+        if (mGlobs.empty())
+            return false;
+
+        auto components = SplitPath(path);
+
+        for (auto &glob : mGlobs)
+        {
+            if (glob.directory_only && !is_directory)
+                continue;
+
+            if (!glob.anchored)
+            {
+                if (MatchComponent(glob.components.front(), name))
+                    return true;
+            }
+            else if (MatchComponents(glob.components, 0, components, 0, false))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool PathPatternSet::CanMatchBelow(std::string_view dir) const
+    {
+        if (!mLiteralNames.empty())
+            return true;
+
+        for (auto &glob : mGlobs)
+            if (!glob.anchored)
+                return true;
+
+        std::string prefix{dir};
+        prefix += '/';
+
+        for (auto &path : mLiteralPaths)
+            if (path.compare(0, prefix.size(), prefix) == 0)
+                return true;
+
+        if (mGlobs.empty())
+            return false;
+
+        auto components = SplitPath(dir);
+
+        for (auto &glob : mGlobs)
+            if (MatchComponents(glob.components, 0, components, 0, true))
+                return true;
+
+        return false;
+    }
+
+    SourceFilter::SourceFilter(const Target &target)
+    {
+        auto add_patterns = [&target](PathPatternSet &set, const char *key) {
+            auto node = target.config.search(key);
+
+            if (!node)
+                return;
+
+            if (node->is_scalar())
+                set.Add(node->scalar());
+            else
+                for (const auto &pattern : *node)
+                    set.Add(pattern.scalar());
+        };
+
+        add_patterns(mExclude, "source-exclude");
+        add_patterns(mInclude, "source-include");
+    }
+
+    SourceFilter::State SourceFilter::Evaluate(const State &parent, std::string_view path, bool is_directory) const
+    {
+        State state;
+
+        state.included = parent.included || mInclude.Matches(path, is_directory);
+        state.excluded = !state.included && (parent.excluded || mExclude.Matches(path, is_directory));
+
+        return state;
+    }
+} // namespace re
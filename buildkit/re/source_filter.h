@@ -0,0 +1,137 @@
+/**
+ * @file re/source_filter.h
+ * @brief Gitignore-style source tree filtering
+ */
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace re
+{
+    class Target;
+
+    /**
+     * @brief A compiled set of gitignore-style path patterns.
+     *
+     * Patterns are matched against '/'-separated paths relative to the target directory:
+     *  - `name` (no slash) matches a file or directory with that name at any depth
+     *  - `dir/name` and `/name` are anchored to the target directory
+     *  - `*` and `?` match within a single path component, `[abc]` matches a character class
+     *  - `**` matches any number of path components
+     *  - a trailing `/` only matches directories
+     *
+     * Wildcard-free patterns (the vast majority in practice) are looked up by hash; only real globs go through the
+     * component-wise matcher.
+     */
+    class PathPatternSet
+    {
+    public:
+        /**
+         * @brief Compiles a pattern and adds it to the set.
+         *
+         * @param pattern The pattern to add
+         */
+        void Add(std::string_view pattern);
+
+        /**
+         * @brief Checks whether a path matches any of the patterns.
+         *
+         * @param path The relative path to check
+         * @param is_directory Whether the path is a directory
+         *
+         * @return true If the path matches
+         */
+        bool Matches(std::string_view path, bool is_directory) const;
+
+        /**
+         * @brief Checks whether any of the patterns could match a path located inside a directory.
+         *
+         * @param dir The relative directory path to check
+         *
+         * @return true If a path inside the directory could match
+         */
+        bool CanMatchBelow(std::string_view dir) const;
+
+        bool IsEmpty() const
+        {
+            return mLiteralPaths.empty() && mLiteralNames.empty() && mGlobs.empty();
+        }
+
+    private:
+        struct Glob
+        {
+            std::vector<std::string> components;
+
+            bool anchored = false;
+            bool directory_only = false;
+        };
+
+        // Directory-only literals are stored with their trailing slash
+        std::unordered_set<std::string> mLiteralPaths;
+        std::unordered_set<std::string> mLiteralNames;
+
+        std::vector<Glob> mGlobs;
+    };
+
+    /**
+     * @brief Decides which entries of a target's directory tree are loaded as sources.
+     *
+     * Built from the target's `source-exclude` and `source-include` pattern lists. Paths matching an include pattern
+     * (or inside an included directory) are always kept; otherwise, paths matching an exclude pattern (or inside an
+     * excluded directory) are skipped.
+     */
+    class SourceFilter
+    {
+    public:
+        /**
+         * @brief The filtering state inherited from a path's parent directories.
+         */
+        struct State
+        {
+            bool excluded = false;
+            bool included = false;
+        };
+
+        /**
+         * @brief Construct a new SourceFilter object from a target's config.
+         *
+         * @param target The target to use
+         */
+        explicit SourceFilter(const Target &target);
+
+        bool IsEmpty() const
+        {
+            return mExclude.IsEmpty();
+        }
+
+        /**
+         * @brief Computes the filtering state of a directory entry.
+         *
+         * @param parent The state of the entry's parent directory
+         * @param path The entry's relative path
+         * @param is_directory Whether the entry is a directory
+         *
+         * @return State The entry's state
+         */
+        State Evaluate(const State &parent, std::string_view path, bool is_directory) const;
+
+        /**
+         * @brief Checks whether an excluded directory can be skipped without walking it.
+         *
+         * @param path The directory's relative path
+         *
+         * @return true If nothing inside the directory can be included back
+         */
+        bool CanPrune(std::string_view path) const
+        {
+            return !mInclude.CanMatchBelow(path);
+        }
+
+    private:
+        PathPatternSet mExclude;
+        PathPatternSet mInclude;
+    };
+} // namespace re
@@ -0,0 +1,268 @@
+#include "source_tree_scanner.h"
+
+#include <re/debug.h>
+
+#include <futile/futile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace re
+{
+    namespace
+    {
+        std::atomic<std::size_t> gSourceScanThreadCount{0};
+
+        // Sources are loaded for the main tree and then for every dependency: spawning a pool each time adds up
+        std::mutex gScanPoolMutex;
+        std::unique_ptr<WorkStealingPool> gScanPool;
+
+        WorkStealingPool &GetScanPool()
+        {
+            std::size_t num_threads = gSourceScanThreadCount;
+
+            if (num_threads == 0)
+                num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+            if (!gScanPool || gScanPool->GetThreadCount() != num_threads)
+                gScanPool = std::make_unique<WorkStealingPool>(num_threads);
+
+            return *gScanPool;
+        }
+
+        std::string JoinRelativePath(const std::string &parent, const std::string &name)
+        {
+            return parent.empty() ? name : parent + "/" + name;
+        }
+    } // namespace
+
+    SourceTreeScanner::SourceTreeScanner(bool defer_child_targets) : mDeferChildTargets{defer_child_targets}
+    {
+    }
+
+    void SourceTreeScanner::Scan(Target &target, const fs::path &path)
+    {
+        if (target.GetCfgEntry<bool>("disable-source-tree-load").value_or(false))
+            return;
+
+        std::lock_guard lock{gScanPoolMutex};
+        mPool = &GetScanPool();
+
+        auto root = CreateTargetNode(target);
+        root->path = path;
+
+        mPool->Submit([this, &root, &path] { ScanDirectory(*root, EnumerateDirectory(path)); });
+        mPool->Wait();
+
+        MergeNode(target, *root);
+    }
+
+    std::unique_ptr<SourceTreeScanner::ScanNode> SourceTreeScanner::CreateTargetNode(Target &target)
+    {
+        auto node = std::make_unique<ScanNode>();
+
+        node->path = target.path;
+        node->owner = &target;
+
+        auto filter = std::make_unique<SourceFilter>(target);
+
+        if (!filter->IsEmpty())
+        {
+            node->filter = filter.get();
+            node->owned_filter = std::move(filter);
+        }
+
+        return node;
+    }
+
+    void SourceTreeScanner::ScanDirectory(ScanNode &node, DirListing listing)
+    {
+        RE_TRACE(" [DBG] Traversing '{}'\n", node.path.u8string());
+
+        node.stamp = MakeDirectoryStamp(node.path, listing);
+
+        std::vector<DirEntry *> entries;
+        entries.reserve(listing.entries.size());
+
+        for (auto &entry : listing.entries)
+            if (entry.name.front() != '.')
+                entries.push_back(&entry);
+
+        std::sort(entries.begin(), entries.end(),
+                  [](const DirEntry *a, const DirEntry *b) { return a->name < b->name; });
+
+        node.items.reserve(entries.size());
+
+        for (auto entry : entries)
+        {
+            if (entry->type == DirEntryType::Other)
+                continue;
+
+            auto is_directory = entry->type == DirEntryType::Directory;
+
+            auto entry_path = node.path / fs::u8path(entry->name);
+            auto relative_path = JoinRelativePath(node.relative_path, entry->name);
+
+            SourceFilter::State filter_state;
+
+            if (node.filter)
+            {
+                filter_state = node.filter->Evaluate(node.filter_state, relative_path, is_directory);
+
+                // Excluded directories are skipped before even looking inside, unless something in them is included
+                if (filter_state.excluded && (!is_directory || node.filter->CanPrune(relative_path)))
+                {
+                    auto &item = node.items.emplace_back();
+
+                    item.kind = ScanItem::Kind::Excluded;
+                    item.path = std::move(entry_path);
+                    continue;
+                }
+            }
+
+            auto &item = node.items.emplace_back();
+
+            item.path = std::move(entry_path);
+            item.relative_path = std::move(relative_path);
+
+            if (is_directory)
+            {
+                // Whether this is a plain directory, an ignored one or a child target is only known once it's listed
+                item.kind = ScanItem::Kind::Directory;
+                item.filter_state = filter_state;
+            }
+            else
+                item.kind = ScanItem::Kind::File;
+        }
+
+        // The item list must not change size past this point: the tasks below hold references into it.
+        for (auto &item : node.items)
+            if (item.kind == ScanItem::Kind::Directory)
+                mPool->Submit([this, &item, &node] { VisitDirectory(item, node); });
+    }
+
+    void SourceTreeScanner::VisitDirectory(ScanItem &item, const ScanNode &parent)
+    {
+        auto ignore_marker = item.path / ".re-ignore-this";
+
+        // Ignored directories (like build outputs) can be huge, so the marker is probed for before listing anything
+        if (GetFileStatus(ignore_marker).exists)
+        {
+            item.kind = ScanItem::Kind::Ignored;
+
+            // Stamp the marker rather than the directory: ignored directories change all the time, while the marker
+            // only matters when it goes away.
+            auto data = futile::open(ignore_marker).read();
+
+            item.stamps.push_back(MakeFileStamp(ignore_marker, HashFileContents({data.data(), data.size()})));
+            return;
+        }
+
+        // The target config comes from the directory's own listing instead of being probed for separately
+        auto listing = EnumerateDirectory(item.path);
+
+        if (listing.has_target_config)
+        {
+            // Deferred targets are never walked, so only direct children of the scanned target end up here
+            if (mDeferChildTargets)
+            {
+                item.kind = ScanItem::Kind::DeferredTarget;
+                return;
+            }
+
+            item.kind = ScanItem::Kind::ChildTarget;
+            LoadChildTarget(item, parent.owner, std::move(listing));
+            return;
+        }
+
+        item.node = std::make_unique<ScanNode>();
+
+        item.node->path = item.path;
+        item.node->owner = parent.owner;
+
+        item.node->relative_path = std::move(item.relative_path);
+
+        if (parent.filter)
+        {
+            item.node->filter = parent.filter;
+            item.node->filter_state = item.filter_state;
+        }
+
+        ScanDirectory(*item.node, std::move(listing));
+    }
+
+    void SourceTreeScanner::LoadChildTarget(ScanItem &item, Target *parent, DirListing listing)
+    {
+        // The target would otherwise list its directory again to look for config partitions
+        auto target = std::make_unique<Target>(item.path, parent, listing);
+
+        if (!target->GetCfgEntry<bool>("enabled").value_or(true))
+        {
+            item.stamps = std::move(target->load_stamps);
+            return;
+        }
+
+        target->LoadDependencies();
+        target->LoadMiscConfig();
+
+        if (!target->GetCfgEntry<bool>("disable-source-tree-load").value_or(false))
+        {
+            item.node = CreateTargetNode(*target);
+            ScanDirectory(*item.node, std::move(listing));
+        }
+
+        item.target = std::move(target);
+    }
+
+    void SourceTreeScanner::MergeNode(Target &target, ScanNode &node)
+    {
+        // The target's own directory has already been stamped by its constructor
+        if (node.path != target.path)
+            target.load_stamps.push_back(node.stamp);
+
+        for (auto &item : node.items)
+        {
+            switch (item.kind)
+            {
+            case ScanItem::Kind::Ignored:
+                target.load_stamps.insert(target.load_stamps.end(), item.stamps.begin(), item.stamps.end());
+                break;
+            case ScanItem::Kind::Excluded:
+                target.excluded_paths.emplace_back(std::move(item.path));
+                break;
+            case ScanItem::Kind::File:
+                target.sources.emplace_back(target.MakeSourceFile(item.path, item.relative_path));
+                break;
+            case ScanItem::Kind::Directory:
+                MergeNode(target, *item.node);
+                break;
+            case ScanItem::Kind::ChildTarget:
+                if (item.target)
+                {
+                    if (item.node)
+                        MergeNode(*item.target, *item.node);
+
+                    target.children.emplace_back(std::move(item.target));
+                }
+                else
+                    target.load_stamps.insert(target.load_stamps.end(), item.stamps.begin(), item.stamps.end());
+                break;
+            case ScanItem::Kind::DeferredTarget:
+                target.deferred_children.emplace_back(std::move(item.path));
+                break;
+            }
+        }
+    }
+
+    void SetSourceScanThreadCount(std::size_t count)
+    {
+        gSourceScanThreadCount = count;
+    }
+
+    std::size_t GetSourceScanThreadCount()
+    {
+        return gSourceScanThreadCount;
+    }
+} // namespace re
@@ -0,0 +1,133 @@
+#pragma once
+#include <re/dir_enumerator.h>
+#include <re/fs.h>
+#include <re/source_filter.h>
+#include <re/target.h>
+#include <re/work_stealing_pool.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief Walks a target's directory tree in parallel, loading its sources and nested child targets.
+     *
+     * Subdirectories and child target configs are spread across a WorkStealingPool. Every directory's entries are
+     * sorted by name before being merged back into the targets, so the resulting Target::sources and
+     * Target::children lists do not depend on thread scheduling or on the filesystem's own enumeration order.
+     */
+    class SourceTreeScanner
+    {
+    public:
+        /**
+         * @brief Construct a new SourceTreeScanner object.
+         *
+         * @param defer_child_targets Record child target directories in Target::deferred_children instead of
+         *                            loading them
+         */
+        explicit SourceTreeScanner(bool defer_child_targets = false);
+
+        /**
+         * @brief Loads the sources and child targets of a target from the specified directory.
+         *
+         * Child targets get their dependencies and misc config loaded and their own source trees scanned as part
+         * of the same walk.
+         *
+         * All scanners share a single process-wide pool (sized by SetSourceScanThreadCount), so scans from different
+         * threads run one after another. Scan() must not be called from within a scan.
+         *
+         * @param target The target to load sources into
+         * @param path The directory to scan
+         */
+        void Scan(Target &target, const fs::path &path);
+
+    private:
+        struct ScanNode;
+
+        /**
+         * @brief A single directory entry found while scanning, kept in a stable order for merging.
+         */
+        struct ScanItem
+        {
+            enum class Kind
+            {
+                File,
+                Directory,
+                ChildTarget,
+                DeferredTarget,
+                Ignored,
+                Excluded
+            };
+
+            Kind kind;
+
+            fs::path path;
+            std::string relative_path;
+
+            std::unique_ptr<Target> target;
+            std::unique_ptr<ScanNode> node;
+
+            /**
+             * @brief Stamps of ignored directories and disabled child targets, kept so that their changes are noticed.
+             */
+            std::vector<FileStamp> stamps;
+
+            SourceFilter::State filter_state;
+        };
+
+        struct ScanNode
+        {
+            fs::path path;
+            Target *owner;
+
+            /**
+             * @brief The node's path relative to its owner's directory, '/'-separated.
+             */
+            std::string relative_path;
+
+            /**
+             * @brief The owner's source filter (null if the owner has no exclude patterns).
+             */
+            const SourceFilter *filter = nullptr;
+            SourceFilter::State filter_state;
+
+            /**
+             * @brief Set for nodes scanning a target's own directory.
+             */
+            std::unique_ptr<SourceFilter> owned_filter;
+
+            FileStamp stamp;
+
+            std::vector<ScanItem> items;
+        };
+
+        WorkStealingPool *mPool = nullptr;
+        bool mDeferChildTargets;
+
+        static std::unique_ptr<ScanNode> CreateTargetNode(Target &target);
+
+        void ScanDirectory(ScanNode &node, DirListing listing);
+        void VisitDirectory(ScanItem &item, const ScanNode &parent);
+        void LoadChildTarget(ScanItem &item, Target *parent, DirListing listing);
+
+        static void MergeNode(Target &target, ScanNode &node);
+    };
+
+    /**
+     * @brief Sets the number of threads used by Target::LoadSourceTree.
+     *
+     * The shared scan pool is recreated with the new size before the next scan.
+     *
+     * @param count The thread count (0 means one per hardware thread)
+     */
+    void SetSourceScanThreadCount(std::size_t count);
+
+    /**
+     * @brief Gets the number of threads used by Target::LoadSourceTree.
+     *
+     * @return std::size_t The thread count (0 means one per hardware thread)
+     */
+    std::size_t GetSourceScanThreadCount();
+} // namespace re
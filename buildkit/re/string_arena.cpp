@@ -0,0 +1,43 @@
+#include "string_arena.h"
+
+#include <cstring>
+
+namespace re
+{
+    std::string_view StringArena::Intern(std::string_view str)
+    {
+        if (auto it = mStrings.find(str); it != mStrings.end())
+            return *it;
+
+        char *data;
+
+        if (str.size() > kBlockSize / 4)
+        {
+            // Large strings get a block of their own so that they don't waste the rest of the current one
+            auto &block = mBlocks.emplace_back(std::make_unique<char[]>(str.size()));
+            data = block.get();
+
+            // Keep bump-allocating from the previous block
+            if (mBlocks.size() > 1)
+                std::swap(mBlocks.back(), mBlocks[mBlocks.size() - 2]);
+        }
+        else
+        {
+            if (kBlockSize - mBlockUsed < str.size())
+            {
+                mBlocks.emplace_back(std::make_unique<char[]>(kBlockSize));
+                mBlockUsed = 0;
+            }
+
+            data = mBlocks.back().get() + mBlockUsed;
+            mBlockUsed += str.size();
+        }
+
+        std::memcpy(data, str.data(), str.size());
+
+        std::string_view result{data, str.size()};
+        mStrings.insert(result);
+
+        return result;
+    }
+} // namespace re
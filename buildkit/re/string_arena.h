@@ -0,0 +1,56 @@
+/**
+ * @file re/string_arena.h
+ * @brief Interned string storage
+ */
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief An append-only store of interned strings.
+     *
+     * Strings are copied into large shared blocks instead of getting a heap allocation each, and equal strings are
+     * only stored once. Views returned by Intern() stay valid for the arena's whole lifetime.
+     *
+     * The arena is not thread-safe.
+     */
+    class StringArena
+    {
+    public:
+        StringArena() = default;
+
+        StringArena(const StringArena &) = delete;
+        StringArena &operator=(const StringArena &) = delete;
+
+        /**
+         * @brief Interns a string.
+         *
+         * @param str The string to intern
+         *
+         * @return std::string_view A view of the interned copy
+         */
+        std::string_view Intern(std::string_view str);
+
+        /**
+         * @brief Gets the number of distinct strings in the arena.
+         */
+        std::size_t GetSize() const
+        {
+            return mStrings.size();
+        }
+
+    private:
+        static constexpr std::size_t kBlockSize = 16 * 1024;
+
+        std::vector<std::unique_ptr<char[]>> mBlocks;
+        std::size_t mBlockUsed = kBlockSize;
+
+        std::unordered_set<std::string_view> mStrings;
+    };
+} // namespace re
@@ -2,13 +2,18 @@
 
 #include <magic_enum/magic_enum.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <mutex>
+#include <unordered_map>
 #include <re/fs.h>
 
 #include <regex>
 
 #include <re/debug.h>
+#include <re/source_tree_scanner.h>
 #include <re/yaml_merge.h>
+#include <re/yaml_parse_cache.h>
 
 #include <ulib/string.h>
 #include <futile/futile.h>
@@ -54,7 +59,154 @@ namespace re
         }
     }
 
+    namespace
+    {
+        std::mutex gSourceExtensionsMutex;
+        StringArena gSourceExtensionArena;
+
+        std::vector<std::string_view> gSourceExtensions{std::string_view{}};
+        std::unordered_map<std::string_view, SourceExtensionId> gSourceExtensionIds{{std::string_view{}, 0}};
+    } // namespace
+
+    SourceExtensionId GetSourceExtensionId(std::string_view extension)
+    {
+        std::lock_guard lock{gSourceExtensionsMutex};
+
+        if (auto it = gSourceExtensionIds.find(extension); it != gSourceExtensionIds.end())
+            return it->second;
+
+        auto id = static_cast<SourceExtensionId>(gSourceExtensions.size());
+        auto interned = gSourceExtensionArena.Intern(extension);
+
+        gSourceExtensions.push_back(interned);
+        gSourceExtensionIds.emplace(interned, id);
+
+        return id;
+    }
+
+    std::string_view GetSourceExtension(SourceExtensionId id)
+    {
+        std::lock_guard lock{gSourceExtensionsMutex};
+        return gSourceExtensions.at(id);
+    }
+
+    FileStamp MakeFileStamp(const fs::path &path, std::uint64_t hash)
+    {
+        FileStamp stamp;
+
+        stamp.path = path;
+        stamp.hash = hash;
+
+        auto status = GetFileStatus(path);
+
+        if (!status.exists)
+            return stamp;
+
+        stamp.directory = status.directory;
+        stamp.mtime = status.mtime;
+        stamp.size = status.size;
+
+        return stamp;
+    }
+
+    std::uint64_t HashFileContents(std::string_view data)
+    {
+        // FNV-1a: the value ends up on disk, so it has to be stable between runs and builds
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+
+        for (auto c : data)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash ? hash : 1;
+    }
+
+    std::uint64_t HashDirectoryListing(const DirListing &listing)
+    {
+        std::vector<std::string> keys;
+        keys.reserve(listing.entries.size());
+
+        for (auto &entry : listing.entries)
+        {
+            if (entry.name.empty() || (entry.name.front() == '.' && entry.name != ".re-ignore-this"))
+                continue;
+
+            auto &key = keys.emplace_back(entry.name);
+
+            if (entry.type == DirEntryType::Directory)
+                key += '/';
+        }
+
+        std::sort(keys.begin(), keys.end());
+
+        std::string data;
+
+        for (auto &key : keys)
+        {
+            data += key;
+            data += '\n';
+        }
+
+        return HashFileContents(data);
+    }
+
+    std::uint64_t HashDirectoryListing(const fs::path &path)
+    {
+        return HashDirectoryListing(EnumerateDirectory(path));
+    }
+
+    FileStamp MakeDirectoryStamp(const fs::path &path, const DirListing &listing)
+    {
+        FileStamp stamp;
+
+        stamp.path = path;
+        stamp.directory = true;
+        stamp.mtime = listing.mtime;
+        stamp.hash = HashDirectoryListing(listing);
+
+        return stamp;
+    }
+
+    bool RefreshFileStamp(FileStamp &stamp)
+    {
+        auto current = MakeFileStamp(stamp.path);
+
+        if (current.mtime == 0 || current.directory != stamp.directory)
+            return false;
+
+        if (current.mtime == stamp.mtime && current.size == stamp.size)
+            return true;
+
+        if (stamp.hash == 0)
+            return false;
+
+        if (stamp.directory)
+        {
+            if (HashDirectoryListing(stamp.path) != stamp.hash)
+                return false;
+        }
+        else
+        {
+            auto data = futile::open(stamp.path).read();
+
+            if (HashFileContents({data.data(), data.size()}) != stamp.hash)
+                return false;
+        }
+
+        stamp.mtime = current.mtime;
+        stamp.size = current.size;
+
+        return true;
+    }
+
     Target::Target(const fs::path &dir_path, Target *pParent)
+        : Target(dir_path, pParent, EnumerateDirectory(dir_path))
+    {
+    }
+
+    Target::Target(const fs::path &dir_path, Target *pParent, const DirListing &listing)
     {
         path = fs::canonical(dir_path);
         parent = pParent;
@@ -64,21 +216,33 @@ namespace re
         RE_TRACE(" ***** LOADING TARGET: path = {}\n", path.generic_u8string());
 
         config_path = path / kTargetConfigFilename;
-        config = ulib::yaml::parse(futile::open(config_path).read());
 
-        // Load all config partitions
+        auto config_stamp = MakeFileStamp(config_path);
+        auto config_data = futile::open(config_path).read();
+
+        config_stamp.hash = HashFileContents({config_data.data(), config_data.size()});
+        load_stamps.push_back(std::move(config_stamp));
+
+        config = YamlParseCache::Get().Parse({config_data.data(), config_data.size()});
 
-        for (auto &entry : fs::directory_iterator{path})
+        // Load all config partitions: the listing already has them, so there's no need for another directory pass
+        for (auto &partition : listing.partitions)
         {
-            ulib::string name = entry.path().filename().u8string();
+            auto partition_path = path / fs::u8path(partition);
 
-            if (name.ends_with(".re.yml"))
-            {
-                auto merge_c = ulib::yaml::parse(futile::open(entry.path()).read());
-                MergeYamlNode(config, merge_c);
-            }
+            auto stamp = MakeFileStamp(partition_path);
+            auto data = futile::open(partition_path).read();
+
+            stamp.hash = HashFileContents({data.data(), data.size()});
+            load_stamps.push_back(std::move(stamp));
+
+            auto merge_c = YamlParseCache::Get().Parse({data.data(), data.size()});
+            MergeYamlNode(config, merge_c);
         }
 
+        // The listing's mtime was taken before its entries were read, so concurrent changes are never missed
+        load_stamps.push_back(MakeDirectoryStamp(path, listing));
+
         name = GetCfgEntry<std::string>("name").value_or(path.filename().u8string());
 
         /*
@@ -106,6 +270,25 @@ namespace re
         this->module = name;
     }
 
+    SourceFile Target::MakeSourceFile(const fs::path &path, std::string_view relative_path)
+    {
+        SourceFile source;
+
+        source.path = path;
+        source.relative_path = source_arena->Intern(relative_path);
+
+        auto ext = path.extension().u8string();
+        source.SetExtension(ext.empty() ? ext : ext.substr(1));
+
+        return source;
+    }
+
+    void Target::RelocateSource(SourceFile &source, const fs::path &new_path)
+    {
+        source.path = new_path;
+        source.relative_path = source_arena->Intern(new_path.lexically_relative(path).generic_u8string());
+    }
+
     void Target::LoadBaseData()
     {
         auto type_str = GetCfgEntryOrThrow<std::string>("type", "target type not specified");
@@ -217,56 +400,13 @@ namespace re
         */
     }
 
-    void Target::LoadSourceTree(fs::path path)
+    void Target::LoadSourceTree(fs::path path, bool defer_child_targets)
     {
-        if (GetCfgEntry<bool>("disable-source-tree-load").value_or(false))
-            return;
-
         if (path.empty())
             path = this->path;
 
-        // fmt::print(" [DBG] Traversing '{}'\n", path.u8string());
-
-        // rpnint" -- DEBUG: Traversing '%s' srcmodpath='%s'\n", fspath.string().c_str(), src_module_path.c_str());
-
-        for (auto &entry : fs::directory_iterator{path})
-        {
-            auto filename = entry.path().filename().u8string();
-            if (filename.front() == '.')
-                continue;
-
-            if (entry.is_directory())
-            {
-                if (fs::exists(entry.path() / ".re-ignore-this"))
-                    continue;
-
-                if (DoesDirContainTarget(entry.path()))
-                {
-                    auto target = std::make_unique<Target>(entry.path(), this);
-
-                    if (target->GetCfgEntry<bool>("enabled").value_or(true))
-                    {
-                        target->LoadDependencies();
-                        target->LoadMiscConfig();
-                        target->LoadSourceTree();
-
-                        children.emplace_back(std::move(target));
-                    }
-                }
-                else
-                    LoadSourceTree(entry.path());
-            }
-
-            if (entry.is_regular_file())
-            {
-                auto ext = entry.path().extension().u8string();
-
-                if (ext.size() > 0)
-                    ext = ext.substr(1);
-
-                sources.push_back(SourceFile{entry.path(), ext});
-            }
-        }
+        SourceTreeScanner scanner{defer_child_targets};
+        scanner.Scan(*this, path);
     }
 
     void Target::CreateEmptyTarget(const fs::path &path, TargetType type, std::string_view name)
@@ -295,7 +435,20 @@ namespace re
         else if (key == "module")
             return module;
 
-        auto used_config = resolved_config.is_map() ? resolved_config : config;
+        if (var_index)
+        {
+            auto it = var_index->entries.find(std::string_view{key.data(), key.size()});
+
+            if (it == var_index->entries.end())
+                return GetInheritedVar(key);
+
+            if (it->second.kind == TargetVarIndex::EntryKind::Value)
+                return std::string{it->second.value};
+            else if (it->second.kind == TargetVarIndex::EntryKind::NotScalar)
+                return std::nullopt;
+        }
+
+        const auto &used_config = resolved_config.is_map() ? resolved_config : config;
         auto vars = used_config.search("vars");
 
         if (auto var = vars ? vars->search(key) : nullptr)
@@ -319,7 +472,15 @@ namespace re
             // fmt::print("found in config with entry='{}'", entry.value());
             return *entry;
         }
-        else if (auto var = parent ? parent->GetVar(key) : std::nullopt)
+        else
+        {
+            return GetInheritedVar(key);
+        }
+    }
+
+    std::optional<ulib::string> Target::GetInheritedVar(ulib::string_view key) const
+    {
+        if (auto var = parent ? parent->GetVar(key) : std::nullopt)
         {
             // fmt::print("forward to parent ");
             return var;
@@ -336,6 +497,56 @@ namespace re
         }
     }
 
+    void Target::BuildVarIndex()
+    {
+        auto index = std::make_shared<TargetVarIndex>();
+
+        // Added in the order GetVar() searches the configs in, so that the first entry for a key wins
+        auto add = [&index](const TargetConfig &cfg, TargetVarIndex::EntryKind non_scalar_kind) {
+            if (!cfg.is_map())
+                return;
+
+            for (const auto &kv : cfg.items())
+            {
+                auto name = kv.name();
+                std::string_view key{name.data(), name.size()};
+
+                if (index->entries.find(key) != index->entries.end())
+                    continue;
+
+                TargetVarIndex::Entry entry{non_scalar_kind, {}};
+
+                if (kv.value().is_scalar())
+                {
+                    auto value = kv.value().scalar();
+
+                    entry.kind = TargetVarIndex::EntryKind::Value;
+                    entry.value = index->arena.Intern({value.data(), value.size()});
+                }
+
+                index->entries.emplace(index->arena.Intern(key), entry);
+            }
+        };
+
+        const auto &used_config = resolved_config.is_map() ? resolved_config : config;
+
+        if (auto vars = used_config.search("vars"))
+            add(*vars, TargetVarIndex::EntryKind::NotScalar);
+
+        add(used_config, TargetVarIndex::EntryKind::NotScalar);
+
+        // GetCfgEntry() would fail to convert non-scalars: those lookups keep doing exactly that
+        for (const Target *target = this; target; target = target->parent)
+            add(target->config, TargetVarIndex::EntryKind::Unindexed);
+
+        var_index = std::move(index);
+    }
+
+    void Target::InvalidateVarIndex()
+    {
+        var_index.reset();
+    }
+
     std::pair<const LocalVarScope &, VarContext &> Target::GetBuildVarScope() const
     {
         if (build_var_scope)
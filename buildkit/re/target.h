@@ -9,13 +9,18 @@
  */
 
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 
+#include <re/dir_enumerator.h>
 #include <re/error.h>
 #include <re/fs.h>
+#include <re/string_arena.h>
 #include <re/vars.h>
 
 #include <yaml-cpp/yaml.h>
@@ -97,6 +102,33 @@ namespace re
         NonRecursive
     };
 
+    /**
+     * @brief An interned source file extension. Equal extensions always get equal IDs within a process.
+     */
+    using SourceExtensionId = std::uint32_t;
+
+    /**
+     * @brief Interns a source file extension.
+     *
+     * This function is thread-safe.
+     *
+     * @param extension The extension, without the leading period
+     *
+     * @return SourceExtensionId The extension's ID (0 for an empty extension)
+     */
+    SourceExtensionId GetSourceExtensionId(std::string_view extension);
+
+    /**
+     * @brief Gets an interned source file extension by its ID.
+     *
+     * This function is thread-safe. The returned view stays valid for the lifetime of the process.
+     *
+     * @param id The extension's ID
+     *
+     * @return std::string_view The extension, without the leading period
+     */
+    std::string_view GetSourceExtension(SourceExtensionId id);
+
     /**
      * @brief A single source file loaded in a Target.
      */
@@ -108,11 +140,131 @@ namespace re
         fs::path path;
 
         /**
-         * @brief The source file's extension (for convenience)
+         * @brief The source file's '/'-separated path relative to its target's directory.
+         *
+         * Interned in the owning target's Target::source_arena and computed once when the source is loaded.
+         */
+        std::string_view relative_path;
+
+        /**
+         * @brief The source file's extension (for convenience), interned for the lifetime of the process.
+         */
+        std::string_view extension;
+
+        /**
+         * @brief The ID of the source file's extension, for quick comparisons.
+         */
+        SourceExtensionId extension_id = 0;
+
+        /**
+         * @brief Changes the source file's extension.
+         *
+         * @param ext The new extension, without the leading period
+         */
+        void SetExtension(std::string_view ext)
+        {
+            extension_id = GetSourceExtensionId(ext);
+            extension = GetSourceExtension(extension_id);
+        }
+    };
+
+    /**
+     * @brief The observed state of a file or directory that went into loading a Target.
+     *
+     * Stamps are used to tell whether data loaded from the filesystem (configs, source lists) is still up to date
+     * without re-reading it.
+     */
+    struct FileStamp
+    {
+        /**
+         * @brief The file's absolute path.
+         */
+        fs::path path;
+
+        /**
+         * @brief Whether the path is a directory.
          */
-        std::string extension;
+        bool directory = false;
+
+        /**
+         * @brief The file's last write time (0 if the file does not exist).
+         */
+        std::int64_t mtime = 0;
+
+        /**
+         * @brief The file's size (always 0 for directories).
+         */
+        std::uint64_t size = 0;
+
+        /**
+         * @brief A hash of the file's contents or the directory's listing (0 if not tracked).
+         *
+         * This allows touched but otherwise unchanged files to still be considered up to date.
+         */
+        std::uint64_t hash = 0;
     };
 
+    /**
+     * @brief Takes a stamp of a file or directory's current state.
+     *
+     * @param path The path to stamp
+     * @param hash The hash of the file's contents, if known
+     *
+     * @return FileStamp The resulting stamp
+     */
+    FileStamp MakeFileStamp(const fs::path &path, std::uint64_t hash = 0);
+
+    /**
+     * @brief Hashes file contents for use in FileStamp::hash.
+     *
+     * @param data The file's contents
+     *
+     * @return std::uint64_t The resulting hash (never 0)
+     */
+    std::uint64_t HashFileContents(std::string_view data);
+
+    /**
+     * @brief Hashes a directory listing for use in FileStamp::hash.
+     *
+     * Only entries that can affect target loading are tracked: dotfiles other than `.re-ignore-this` are not.
+     *
+     * @param listing The directory's listing
+     *
+     * @return std::uint64_t The resulting hash (never 0)
+     */
+    std::uint64_t HashDirectoryListing(const DirListing &listing);
+
+    /**
+     * @brief Lists a directory and hashes its listing for use in FileStamp::hash.
+     *
+     * @param path The directory's path
+     *
+     * @return std::uint64_t The resulting hash (never 0)
+     */
+    std::uint64_t HashDirectoryListing(const fs::path &path);
+
+    /**
+     * @brief Makes a directory's stamp out of its listing, without touching the filesystem again.
+     *
+     * @param path The directory's path
+     * @param listing The directory's listing
+     *
+     * @return FileStamp The resulting stamp
+     */
+    FileStamp MakeDirectoryStamp(const fs::path &path, const DirListing &listing);
+
+    /**
+     * @brief Checks whether a file or directory still matches a previously taken stamp.
+     *
+     * If the modification time has changed but the contents (or the tracked directory entries) are still the same,
+     * the stamp is updated in place and considered up to date.
+     *
+     * @param stamp The stamp to check
+     *
+     * @return true If the file is unchanged
+     */
+    bool RefreshFileStamp(FileStamp &stamp);
+
     /**
      * @brief The kind of a dependency's version specification.
      */
@@ -449,6 +601,74 @@ namespace re
 
     struct ITargetFeature;
 
+    /**
+     * @brief A flat index of the variables a target's configs define, built once so that looking one up is a single
+     * hash probe instead of a walk through several YAML maps.
+     */
+    struct TargetVarIndex
+    {
+        enum class EntryKind
+        {
+            /**
+             * @brief A scalar value.
+             */
+            Value,
+
+            /**
+             * @brief A non-scalar config entry: looking it up yields nothing.
+             */
+            NotScalar,
+
+            /**
+             * @brief A non-scalar entry in a config that is only searched as a last resort: the lookup has to go
+             * through the configs themselves.
+             */
+            Unindexed
+        };
+
+        struct Entry
+        {
+            EntryKind kind;
+            std::string_view value;
+        };
+
+        /**
+         * @brief Storage for the entries' keys and values.
+         */
+        StringArena arena;
+
+        std::unordered_map<std::string_view, Entry> entries;
+    };
+
+    /**
+     * @brief A target's config flattened for a set of conditions, merged with its parents' configs the same way.
+     *
+     * Filled in by GetResolvedTargetCfg(): children use their parent's merged config as a base instead of flattening
+     * the whole hierarchy again.
+     */
+    struct TargetCfgMemo
+    {
+        /**
+         * @brief The target's own config, flattened.
+         */
+        TargetConfig flat;
+
+        /**
+         * @brief The flattened configs of the target and all its parents, merged from the top down.
+         */
+        TargetConfig merged;
+
+        /**
+         * @brief The parent the config was merged with.
+         */
+        const Target *parent = nullptr;
+
+        /**
+         * @brief The InvalidateResolvedTargetCfgCache() generation the memo belongs to.
+         */
+        std::uint64_t generation = 0;
+    };
+
     /**
      * @brief A single buildable target for the Re build system.
      *
@@ -479,6 +699,15 @@ namespace re
          */
         Target(const fs::path &dir_path, Target *pParent = nullptr);
 
+        /**
+         * @brief Construct a new Target object from a directory that has already been listed.
+         *
+         * @param dir_path The directory to load the target config from.
+         * @param pParent The target's parent (null if no parent)
+         * @param listing The directory's listing, used to find config partitions
+         */
+        Target(const fs::path &dir_path, Target *pParent, const DirListing &listing);
+
         /**
          * @brief Construct a new Target object from a virtual FS path (which may or may not contain a real target)
          * and the target's core properties
@@ -548,17 +777,36 @@ namespace re
          */
         std::vector<SourceFile> sources;
 
+        /**
+         * @brief Storage for the relative paths of the target's sources.
+         *
+         * Shared between copies of the target, since their sources point into it.
+         */
+        std::shared_ptr<StringArena> source_arena = std::make_shared<StringArena>();
+
         /**
          * @brief A list of the target's unused source files, replaced during the build
          * by source translation or other means.
          */
         std::vector<SourceFile> unused_sources;
 
+        /**
+         * @brief Files and directories skipped while loading the source tree because of `source-exclude` patterns.
+         */
+        std::vector<fs::path> excluded_paths;
+
         /**
          * @brief A list of the target's child targets.
          */
         std::vector<std::unique_ptr<Target>> children;
 
+        /**
+         * @brief Directories of child targets that were found but not loaded yet.
+         *
+         * Only filled in if the source tree was loaded with deferred child targets. BuildEnv loads them on demand.
+         */
+        std::vector<fs::path> deferred_children;
+
         /**
          * @brief A path to the target's config file.
          */
@@ -569,6 +817,13 @@ namespace re
          */
         TargetConfig config;
 
+        /**
+         * @brief Stamps of every config file and directory read while loading this target and its sources.
+         *
+         * Directories belonging to child targets are tracked by the children themselves.
+         */
+        std::vector<FileStamp> load_stamps;
+
         /**
          * @brief The target's "flat" config representation.
          *
@@ -577,6 +832,19 @@ namespace re
          */
         TargetConfig resolved_config{ulib::yaml::value_t::null};
 
+        /**
+         * @brief An index of the variables defined in this target's resolved config and the configs of its parents.
+         *
+         * Built by BuildVarIndex() once the configs are final. Shared between copies of the target, as it never
+         * changes once built.
+         */
+        std::shared_ptr<const TargetVarIndex> var_index;
+
+        /**
+         * @brief Flattened and merged configs of this target, keyed by the conditions they were resolved for.
+         */
+        mutable std::unordered_map<std::string, TargetCfgMemo> resolved_config_memos;
+
         /**
          * @brief A set of targets that depend on this target.
          */
@@ -619,6 +887,24 @@ namespace re
 
         std::optional<ulib::string> GetVar(ulib::string_view key) const;
 
+        /**
+         * @brief Indexes the variables defined in the target's configs, making GetVar() a single hash probe for them.
+         *
+         * Has to be called again whenever this target's configs or the configs of its parents change: until then,
+         * GetVar() would return outdated values.
+         */
+        void BuildVarIndex();
+
+        /**
+         * @brief Drops the variable index, making GetVar() search the configs directly until it is built again.
+         */
+        void InvalidateVarIndex();
+
+        /**
+         * @brief Looks up a variable in the target's parent and its parent variable scope.
+         */
+        std::optional<ulib::string> GetInheritedVar(ulib::string_view key) const;
+
         std::pair<const LocalVarScope &, VarContext &> GetBuildVarScope() const;
 
         TargetDependency *GetUsedDependency(ulib::string_view name) const;
@@ -642,13 +928,6 @@ namespace re
                 return nullptr;
         }
 
-        /*
-        // Contains the entire flattened dependency cache for this target in the order {children}..{dependencies
-        recursively}..{itself}.
-        // This is mainly a convenience for language providers so that the whole dependency cache doesn't have to be
-        rebuilt every time. std::vector<Target*> flat_deps_cache;
-        */
-
         //////////////////////////////////////////////////////////////
 
         /**
@@ -736,10 +1015,32 @@ namespace re
          * @brief Recursively loads the target's sources from the specified directory.
          *
          * The recursive search stops looking further if a directory contains a file named `.re-ignore-this`.
+         * Directories are scanned in parallel by a SourceTreeScanner (see SetSourceScanThreadCount), with sources
+         * and children sorted by path within each directory.
          *
          * @param path The path to search.
+         * @param defer_child_targets Only record the directories of child targets in deferred_children instead of
+         *                            loading them.
+         */
+        void LoadSourceTree(fs::path path = "", bool defer_child_targets = false);
+
+        /**
+         * @brief Creates a source file belonging to this target.
+         *
+         * @param path The source's absolute path
+         * @param relative_path The source's '/'-separated path relative to the target directory
+         *
+         * @return SourceFile The new source file
+         */
+        SourceFile MakeSourceFile(const fs::path &path, std::string_view relative_path);
+
+        /**
+         * @brief Points one of this target's source files to a different file, like a translated version of it.
+         *
+         * @param source The source file to update
+         * @param new_path The new absolute path
          */
-        void LoadSourceTree(fs::path path = "");
+        void RelocateSource(SourceFile &source, const fs::path &new_path);
 
         /**
          * @brief Creates an empty target configuration file at the specified path.
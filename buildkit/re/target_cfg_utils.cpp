@@ -6,15 +6,125 @@
 // #include <boost/algorithm/string.hpp>
 #include <ulib/format.h>
 #include <ulib/string.h>
+
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <vector>
 
 
 namespace re
 {
+    namespace
+    {
+        /**
+         * @brief A conditional config key like `platform.windows|linux` or `config.!debug`, parsed once.
+         *
+         * Categories can't contain periods: everything after the first one is the list of supported values.
+         */
+        class ConfigSelector
+        {
+        public:
+            explicit ConfigSelector(std::string_view key) : mKey{key}
+            {
+                std::string_view text = mKey;
+                auto dot = text.find('.');
+
+                if (dot == text.npos)
+                    return;
+
+                mCategory = std::string{text.substr(0, dot)};
+
+                auto raw = text.substr(dot + 1);
+
+                if (raw == "any")
+                {
+                    mAny = true;
+                    return;
+                }
+
+                while (!raw.empty())
+                {
+                    auto alternative = raw.substr(0, raw.find('|'));
+                    raw.remove_prefix(std::min(alternative.size() + 1, raw.size()));
+
+                    if (!alternative.empty())
+                        mAlternatives.push_back({std::string{alternative}, std::string{alternative} + "."});
+                }
+            }
+
+            // Selector caches are keyed by views of the selector's own key
+            ConfigSelector(const ConfigSelector &) = delete;
+            ConfigSelector &operator=(const ConfigSelector &) = delete;
+
+            const std::string &GetKey() const
+            {
+                return mKey;
+            }
+
+            const std::string &GetCategory() const
+            {
+                return mCategory;
+            }
+
+            bool Matches(std::string_view value) const
+            {
+                if (mAny)
+                    return true;
+
+                for (auto &[alternative, prefix] : mAlternatives)
+                {
+                    // `windows` also matches more specific values like `windows.uwp`
+                    if (value == alternative || value.substr(0, prefix.size()) == prefix)
+                        return true;
+
+                    if (alternative.front() == '!' && std::string_view{alternative}.substr(1) != value)
+                        return true;
+                }
+
+                return false;
+            }
+
+        private:
+            struct Alternative
+            {
+                std::string value;
+                std::string prefix;
+            };
+
+            std::string mKey;
+            std::string mCategory;
+
+            bool mAny = false;
+            std::vector<Alternative> mAlternatives;
+        };
+
+        std::shared_ptr<const ConfigSelector> GetConfigSelector(std::string_view key)
+        {
+            // Keys with periods in them that aren't selectors (file names, for one) shouldn't pile up forever
+            constexpr std::size_t kMaxCachedSelectors = 64 * 1024;
+
+            // Keys never change once a config is parsed, so each one only gets compiled once per thread
+            thread_local std::unordered_map<std::string_view, std::shared_ptr<const ConfigSelector>> cache;
+
+            if (auto it = cache.find(key); it != cache.end())
+                return it->second;
+
+            if (cache.size() >= kMaxCachedSelectors)
+                cache.clear();
+
+            auto selector = std::make_shared<const ConfigSelector>(key);
+            cache.emplace(selector->GetKey(), selector);
+
+            return selector;
+        }
+    } // namespace
+
     TargetConfig GetFlatResolvedTargetCfg(const TargetConfig &cfg,
                                           const std::unordered_map<std::string, std::string> &mappings)
     {
-        // recurse the ky
         auto result = cfg;
 
         if (cfg.is_map())
@@ -22,126 +132,150 @@ namespace re
             for (const auto &kv : cfg.items())
             {
                 ulib::string_view key = kv.name();
+                std::string_view key_view{key.data(), key.size()};
 
-                for (const auto &[category, value] : mappings)
-                {
-                    if (key.find(category + ".") == 0)
-                    {
-                        ulib::string_view raw = key.substr(category.size() + 1);
-                        ulib::list<ulib::string> categories = raw.split("|");
-
-                        bool supported = (raw == "any");
-
-                        for (auto &supported_category : categories)
-                        {
-                            RE_TRACE("{}.{}\n", category, supported_category);
+                // Plain keys are the vast majority
+                if (key_view.find('.') == key_view.npos)
+                    continue;
 
-                            if (supported)
-                                break;
+                auto selector = GetConfigSelector(key_view);
+                auto mapping = mappings.find(selector->GetCategory());
 
-                            supported |= (value == supported_category ||
-                                          ulib::string{value}.starts_with(supported_category + "."));
+                if (mapping == mappings.end())
+                    continue;
 
-                            if (supported_category.front() == '!')
-                            {
-                                RE_TRACE("    Negation: value={}\n", (supported_category != value.substr(1)));
-                                supported |= (supported_category.substr(1) != value);
-                            }
-                        }
+                auto &[category, value] = *mapping;
 
-                        if (supported)
-                        {
-                            if (kv.value().is_scalar() && kv.value().scalar() == "unsupported")
-                                RE_THROW Exception("unsupported {} '{}'", category, value);
-
-                            auto cloned = GetFlatResolvedTargetCfg(kv.value(), mappings);
+                if (selector->Matches(value))
+                {
+                    RE_TRACE("{} matches {}\n", key_view, value);
 
-                            if (cloned.is_map())
-                            {
-                                for (auto& inner_kv : cloned.items())
-                                    inner_kv.value() = GetFlatResolvedTargetCfg(inner_kv.value(), mappings);
-                            }
+                    if (kv.value().is_scalar() && kv.value().scalar() == "unsupported")
+                        RE_THROW Exception("unsupported {} '{}'", category, value);
 
-                            MergeYamlNode(result, cloned);
-                        }
+                    auto cloned = GetFlatResolvedTargetCfg(kv.value(), mappings);
 
-                        if (result.is_map())
-                            result.remove(key);
-                        break;
+                    if (cloned.is_map())
+                    {
+                        for (auto &inner_kv : cloned.items())
+                            inner_kv.value() = GetFlatResolvedTargetCfg(inner_kv.value(), mappings);
                     }
+
+                    MergeYamlNode(result, cloned);
                 }
+
+                if (result.is_map())
+                    result.remove(key);
             }
         }
 
         return result;
     }
 
-    TargetConfig GetResolvedTargetCfg(const Target &leaf, const std::unordered_map<std::string, std::string> &mappings)
+    namespace
     {
-        auto p = leaf.parent;
+        std::atomic<std::uint64_t> gResolvedCfgGeneration{1};
 
-        auto leaf_cfg = GetFlatResolvedTargetCfg(leaf.config, mappings);
+        // Mappings are unordered: the key has to be the same for equal ones
+        std::string GetMappingsKey(const std::unordered_map<std::string, std::string> &mappings)
+        {
+            std::vector<std::pair<std::string_view, std::string_view>> sorted{mappings.begin(), mappings.end()};
+            std::sort(sorted.begin(), sorted.end());
 
-        // Deps and uses are automatically recursed by Target facilities:
-        // copying parent deps and uses into children would lead to a performance impact due to redundant regex parsing
-        auto top_deps = leaf_cfg["deps"];
-        // auto top_uses = Clone(leaf_cfg["uses"]);
+            std::string key;
 
-        auto top_actions = leaf_cfg["actions"];
-        auto top_tasks = leaf_cfg["tasks"];
+            for (auto &[category, value] : sorted)
+            {
+                key += category;
+                key += '=';
+                key += value;
+                key += '\n';
+            }
 
-        std::vector<const Target *> genealogy = {&leaf};
+            return key;
+        }
 
-        while (p)
+        const TargetCfgMemo *FindCfgMemo(const Target &target, const std::string &key, std::uint64_t generation)
         {
-            genealogy.insert(genealogy.begin(), p);
-            if (std::find(genealogy.begin(), genealogy.end(), p->parent) != genealogy.end())
-            {
-                std::system("pause");
+            auto it = target.resolved_config_memos.find(key);
 
-                if (p->parent)
-                {
-                    fmt::print("p->name: {}\n", p->name);
-                    fmt::print("p->path: {}\n", p->path.generic_string());
-                    fmt::print("p->module: {}\n", p->module);
-                    fmt::print("p->type: {}\n", TargetTypeToString(p->type));
+            if (it == target.resolved_config_memos.end())
+                return nullptr;
 
-                    // fmt::print("p->parent->name: {}\n", p->parent->name);
-                    // fmt::print("p->parent->path: {}\n", p->parent->path.generic_string());
-                    // fmt::print("p->parent->module: {}\n", p->parent->module);
-                    // fmt::print("p->parent->type: {}\n", TargetTypeToString(p->parent->type));
+            auto &memo = it->second;
 
-                    // fmt::print("p->parent->resolved_config:\n");
-                    // std::cout << p->parent->resolved_config << std::endl;
+            if (memo.generation != generation || memo.parent != target.parent)
+                return nullptr;
 
-                    // fmt::print("p->parent->config:\n");
-                    // std::cout << p->parent->config << std::endl;
+            return &memo;
+        }
 
-                }
+        const TargetCfgMemo &GetCfgMemo(const Target &leaf,
+                                        const std::unordered_map<std::string, std::string> &mappings)
+        {
+            auto key = GetMappingsKey(mappings);
+            auto generation = gResolvedCfgGeneration.load();
+
+            if (auto memo = FindCfgMemo(leaf, key, generation))
+                return *memo;
+
+            // Going up until a parent that already has its config merged: everything below it has to be merged now
+            std::vector<const Target *> genealogy;
+            const TargetCfgMemo *base = nullptr;
 
-                break;
+            for (auto p = &leaf; p; p = p->parent)
+            {
+                if (std::find(genealogy.begin(), genealogy.end(), p) != genealogy.end())
+                    RE_THROW TargetConfigException(&leaf, "target '{}' is its own parent", p->module);
+
+                if (p != &leaf && (base = FindCfgMemo(*p, key, generation)))
+                    break;
+
+                genealogy.push_back(p);
             }
-                
 
-            p = p->parent;
-        }
+            const TargetCfgMemo *result = nullptr;
 
-    
+            for (auto it = genealogy.rbegin(); it != genealogy.rend(); ++it)
+            {
+                auto &target = **it;
+                auto &memo = target.resolved_config_memos[key];
 
+                memo.flat = GetFlatResolvedTargetCfg(target.config, mappings);
+                memo.merged = base ? base->merged : TargetConfig{ulib::yaml::value_t::map};
+                memo.parent = target.parent;
+                memo.generation = generation;
 
-        TargetConfig result{ulib::yaml::value_t::map};
+                MergeYamlNode(memo.merged, memo.flat);
 
-        for (auto &target : genealogy)
-            MergeYamlNode(result, GetFlatResolvedTargetCfg(target->config, mappings));
+                base = result = &memo;
+            }
+
+            return *result;
+        }
+    } // namespace
+
+    TargetConfig GetResolvedTargetCfg(const Target &leaf, const std::unordered_map<std::string, std::string> &mappings)
+    {
+        auto &memo = GetCfgMemo(leaf, mappings);
+        auto result = memo.merged;
 
         // Everything is always inherited from the core config target in the root target
         if (leaf.parent &&
             (!leaf.parent->config.search("is-core-config") || leaf.parent->config["is-core-config"].get<bool>() != true))
         {
-            result["deps"] = top_deps;
+            // Deps and uses are automatically recursed by Target facilities:
+            // copying parent deps and uses into children would lead to a performance impact due to redundant regex
+            // parsing
+            auto get_own = [&memo](const char *key) {
+                auto node = memo.flat.search(key);
+                return node ? *node : TargetConfig{ulib::yaml::value_t::null};
+            };
+
+            result["deps"] = get_own("deps");
             // result["uses"] = top_uses;
-            result["actions"] = top_actions;
-            result["tasks"] = top_tasks;
+            result["actions"] = get_own("actions");
+            result["tasks"] = get_own("tasks");
         }
 
         result["is-core-config"] = false;
@@ -155,4 +289,9 @@ namespace re
 
         return result;
     }
+
+    void InvalidateResolvedTargetCfgCache()
+    {
+        gResolvedCfgGeneration++;
+    }
 } // namespace re
@@ -5,5 +5,16 @@ namespace re
 {
 	TargetConfig GetFlatResolvedTargetCfg(const TargetConfig& cfg, const std::unordered_map<std::string, std::string>& mappings);
 
+	/**
+	 * @brief Flattens a target's config and merges it with the flattened configs of all its parents.
+	 *
+	 * Merged configs are memoized per target and set of mappings, so targets sharing parents only flatten them once.
+	 */
 	TargetConfig GetResolvedTargetCfg(const Target& leaf, const std::unordered_map<std::string, std::string>& mappings);
+
+	/**
+	 * @brief Drops all the configs memoized by GetResolvedTargetCfg(). Has to be called whenever the config of
+	 * a loaded target changes.
+	 */
+	void InvalidateResolvedTargetCfgCache();
 }
@@ -0,0 +1,354 @@
+#include "target_graph_snapshot.h"
+
+#include <re/binary_stream.h>
+#include <re/debug.h>
+#include <re/version.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace re
+{
+    namespace
+    {
+        constexpr char kSnapshotMagic[] = {'R', 'E', 'G', 'S'};
+        constexpr std::uint64_t kSnapshotFormatVersion = 4;
+
+        void WriteFileStamp(BinaryWriter &writer, const FileStamp &stamp)
+        {
+            writer.WritePath(stamp.path);
+            writer.WriteU8(stamp.directory);
+            writer.WriteU64(stamp.mtime);
+            writer.WriteU64(stamp.size);
+            writer.WriteU64(stamp.hash);
+        }
+
+        FileStamp ReadFileStamp(BinaryReader &reader)
+        {
+            FileStamp stamp;
+
+            stamp.path = reader.ReadPath();
+            stamp.directory = reader.ReadU8() != 0;
+            stamp.mtime = static_cast<std::int64_t>(reader.ReadU64());
+            stamp.size = reader.ReadU64();
+            stamp.hash = reader.ReadU64();
+
+            return stamp;
+        }
+
+        void WriteDependency(BinaryWriter &writer, const TargetDependency &dep)
+        {
+            writer.WriteString(dep.raw);
+            writer.WriteString(dep.ns);
+            writer.WriteString(dep.name);
+            writer.WriteString(dep.version);
+            writer.WriteU8(static_cast<std::uint8_t>(dep.version_kind));
+            writer.WriteString(dep.version_kind_str);
+
+            writer.WriteU64(dep.filters.size());
+
+            for (const auto &filter : dep.filters)
+                writer.WriteString(filter);
+
+            writer.WriteYaml(dep.extra_config);
+            writer.WriteU64(dep.extra_config_hash);
+            writer.WriteU64(dep.extra_config_data_hash);
+        }
+
+        TargetDependency ReadDependency(BinaryReader &reader)
+        {
+            TargetDependency dep;
+
+            dep.raw = reader.ReadString();
+            dep.ns = reader.ReadString();
+            dep.name = reader.ReadString();
+            dep.version = reader.ReadString();
+            dep.version_kind = static_cast<DependencyVersionKind>(reader.ReadU8());
+            dep.version_kind_str = reader.ReadString();
+
+            for (auto count = reader.ReadU64(); count > 0; count--)
+            {
+                ulib::string filter = reader.ReadString();
+                dep.filters.push_back(filter);
+            }
+
+            dep.extra_config = reader.ReadYaml();
+            dep.extra_config_hash = reader.ReadU64();
+            dep.extra_config_data_hash = reader.ReadU64();
+
+            if (dep.version_kind != DependencyVersionKind::RawTag)
+                dep.version_sv = semverpp::version{std::string(dep.version)};
+
+            return dep;
+        }
+
+        void WriteTarget(BinaryWriter &writer, const Target &target)
+        {
+            writer.WritePath(target.path);
+            writer.WritePath(target.config_path);
+            writer.WriteString(target.name);
+            writer.WriteString(target.module);
+            writer.WriteU8(static_cast<std::uint8_t>(target.type));
+            writer.WriteYaml(target.config);
+
+            writer.WriteU64(target.load_stamps.size());
+
+            for (const auto &stamp : target.load_stamps)
+                WriteFileStamp(writer, stamp);
+
+            writer.WriteU64(target.dependencies.size());
+
+            for (const auto &dep : target.dependencies)
+                WriteDependency(writer, dep);
+
+            writer.WriteU64(target.sources.size());
+
+            for (const auto &source : target.sources)
+            {
+                writer.WritePath(source.path);
+                writer.WriteString(source.relative_path);
+                writer.WriteString(source.extension);
+            }
+
+            writer.WriteU64(target.excluded_paths.size());
+
+            for (const auto &path : target.excluded_paths)
+                writer.WritePath(path);
+
+            writer.WriteU64(target.children.size());
+
+            for (const auto &child : target.children)
+                WriteTarget(writer, *child);
+        }
+    } // namespace
+
+    void TargetGraphSnapshot::Save(const Target &target, const fs::path &path)
+    {
+        BinaryWriter writer;
+
+        writer.WriteRaw(kSnapshotMagic, sizeof kSnapshotMagic);
+        writer.WriteU64(kSnapshotFormatVersion);
+        writer.WriteString(GetBuildRevision());
+
+        WriteTarget(writer, target);
+
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+
+        // Write to a temporary file first so that an interrupted run never leaves a half-written snapshot behind
+        auto temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+
+            if (!file.good())
+                return;
+
+            file.write(writer.GetData().data(), writer.GetData().size());
+
+            if (!file.good())
+                return;
+        }
+
+        fs::rename(temp_path, path, ec);
+    }
+
+    bool TargetGraphSnapshot::Load(const fs::path &path)
+    {
+        mRoot = nullptr;
+
+        std::ifstream file{path, std::ios::binary};
+
+        if (!file.good())
+            return false;
+
+        std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+        try
+        {
+            BinaryReader reader{data, "target graph snapshot"};
+
+            char magic[sizeof kSnapshotMagic];
+            reader.ReadRaw(magic, sizeof magic);
+
+            if (std::memcmp(magic, kSnapshotMagic, sizeof magic) != 0)
+                return false;
+
+            if (reader.ReadU64() != kSnapshotFormatVersion)
+                return false;
+
+            // Snapshots embed hashes and enum values that are only meaningful to the exact Re build that wrote them
+            if (reader.ReadString() != GetBuildRevision())
+                return false;
+
+            auto read_node = [&reader](auto &self, Node &node) -> void {
+                node.path = reader.ReadPath();
+                node.config_path = reader.ReadPath();
+                node.name = reader.ReadString();
+                node.module = reader.ReadString();
+                node.type = static_cast<TargetType>(reader.ReadU8());
+                node.config = reader.ReadYaml();
+
+                for (auto count = reader.ReadU64(); count > 0; count--)
+                    node.stamps.emplace_back(ReadFileStamp(reader));
+
+                for (auto count = reader.ReadU64(); count > 0; count--)
+                    node.dependencies.emplace_back(ReadDependency(reader));
+
+                for (auto count = reader.ReadU64(); count > 0; count--)
+                {
+                    auto &source = node.sources.emplace_back();
+
+                    source.path = reader.ReadPath();
+                    source.relative_path = node.source_arena->Intern(reader.ReadString());
+                    source.SetExtension(reader.ReadString());
+                }
+
+                for (auto count = reader.ReadU64(); count > 0; count--)
+                    node.excluded_paths.emplace_back(reader.ReadPath());
+
+                for (auto count = reader.ReadU64(); count > 0; count--)
+                    self(self, node.children.emplace_back());
+            };
+
+            auto root = std::make_unique<Node>();
+            read_node(read_node, *root);
+
+            if (!reader.IsAtEnd())
+                return false;
+
+            mRoot = std::move(root);
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            // A corrupt snapshot is no different from a missing one
+            return false;
+        }
+    }
+
+    std::unique_ptr<Target> TargetGraphSnapshot::Rehydrate(const fs::path &path, Target *pParent)
+    {
+        mReloadedCount = 0;
+        mRefreshedStamps = false;
+
+        std::error_code ec;
+        auto canonical_path = fs::canonical(path, ec);
+
+        if (!mRoot || ec || mRoot->path != canonical_path)
+            return nullptr;
+
+        ValidateNode(*mRoot);
+
+        if (mRoot->state != NodeState::Clean)
+            return nullptr;
+
+        auto target = RestoreNode(*mRoot);
+
+        target->parent = pParent;
+        target->root = target.get();
+        target->root_path = target->path;
+
+        RehydrateChildren(*mRoot, *target);
+        return target;
+    }
+
+    void TargetGraphSnapshot::ValidateNode(Node &node)
+    {
+        for (auto &stamp : node.stamps)
+        {
+            auto mtime = stamp.mtime;
+
+            if (RefreshFileStamp(stamp))
+            {
+                if (stamp.mtime != mtime)
+                    mRefreshedStamps = true;
+            }
+            else
+            {
+                RE_TRACE(" [DBG] Snapshot: '{}' changed, reloading '{}'\n", stamp.path.u8string(), node.module);
+
+                // The whole subtree gets reloaded, no point in checking the children
+                node.state = NodeState::Dirty;
+                return;
+            }
+        }
+
+        for (auto &child : node.children)
+        {
+            ValidateNode(child);
+
+            // Dirty children are reloaded in place, but ones that are not targets anymore change our own source tree
+            if (child.state == NodeState::Dirty &&
+                (!DoesDirContainTarget(child.path) || fs::exists(child.path / ".re-ignore-this")))
+            {
+                child.state = NodeState::Gone;
+                node.state = NodeState::Dirty;
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<Target> TargetGraphSnapshot::RestoreNode(Node &node)
+    {
+        auto target = std::make_unique<Target>();
+
+        target->path = std::move(node.path);
+        target->config_path = std::move(node.config_path);
+        target->name = std::move(node.name);
+        target->module = std::move(node.module);
+        target->type = node.type;
+        target->config = std::move(node.config);
+        target->load_stamps = std::move(node.stamps);
+        target->dependencies = std::move(node.dependencies);
+        target->source_arena = std::move(node.source_arena);
+        target->sources = std::move(node.sources);
+        target->excluded_paths = std::move(node.excluded_paths);
+
+        return target;
+    }
+
+    void TargetGraphSnapshot::RehydrateChildren(Node &node, Target &target)
+    {
+        for (auto &child : node.children)
+        {
+            if (child.state == NodeState::Clean)
+            {
+                auto restored = RestoreNode(child);
+
+                restored->parent = &target;
+                restored->root = target.root;
+                restored->root_path = target.root_path;
+
+                RehydrateChildren(child, *restored);
+                target.children.emplace_back(std::move(restored));
+            }
+            else if (auto reloaded = ReloadNode(child, &target))
+                target.children.emplace_back(std::move(reloaded));
+        }
+    }
+
+    std::unique_ptr<Target> TargetGraphSnapshot::ReloadNode(Node &node, Target *pParent)
+    {
+        mReloadedCount++;
+
+        auto target = std::make_unique<Target>(node.path, pParent);
+
+        // Keep watching disabled targets so that re-enabling them is noticed
+        if (!target->GetCfgEntry<bool>("enabled").value_or(true))
+        {
+            pParent->load_stamps.insert(pParent->load_stamps.end(), target->load_stamps.begin(),
+                                        target->load_stamps.end());
+            return nullptr;
+        }
+
+        target->LoadDependencies();
+        target->LoadMiscConfig();
+        target->LoadSourceTree();
+
+        return target;
+    }
+} // namespace re
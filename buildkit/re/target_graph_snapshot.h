@@ -0,0 +1,128 @@
+/**
+ * @file re/target_graph_snapshot.h
+ * @brief Persistent snapshots of loaded target hierarchies
+ */
+
+#pragma once
+#include "target.h"
+
+#include <re/fs.h>
+
+#include <memory>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief A binary snapshot of a fully loaded root target hierarchy.
+     *
+     * The snapshot stores everything BuildEnv::LoadTarget produces (configs, parsed dependencies, source lists and
+     * child targets) along with the stamps of all files and directories that went into it. Rehydrating a snapshot
+     * only re-reads the targets whose stamps no longer match, so no-op runs skip YAML parsing and directory walks
+     * entirely.
+     */
+    class TargetGraphSnapshot
+    {
+    public:
+        /**
+         * @brief Gets the snapshot file path for a root target.
+         *
+         * @param root_path The root target's path
+         * @return fs::path The snapshot's path
+         */
+        static fs::path GetSnapshotPath(const fs::path &root_path)
+        {
+            return root_path / ".re-cache" / "graph.bin";
+        }
+
+        /**
+         * @brief Saves a loaded target hierarchy into a snapshot file.
+         *
+         * This must be called before the targets are resolved or built - those stages modify target configs.
+         *
+         * @param target The root target to save
+         * @param path The snapshot file path
+         */
+        static void Save(const Target &target, const fs::path &path);
+
+        /**
+         * @brief Loads a snapshot file.
+         *
+         * @param path The snapshot file path
+         * @return true If the snapshot exists and was written by this exact Re build
+         */
+        bool Load(const fs::path &path);
+
+        /**
+         * @brief Recreates the root target hierarchy from the snapshot, reloading any targets that changed on disk.
+         *
+         * The resulting target is in the same state BuildEnv::LoadTarget would leave it in right after loading its
+         * source tree.
+         *
+         * @param path The root target's path
+         * @param pParent The root target's parent
+         *
+         * @return std::unique_ptr<Target> The root target, or nullptr if the root target itself has changed and has
+         * to be loaded normally
+         */
+        std::unique_ptr<Target> Rehydrate(const fs::path &path, Target *pParent);
+
+        /**
+         * @brief Gets the number of targets reloaded from disk during the last Rehydrate() call.
+         */
+        std::size_t GetReloadedCount() const
+        {
+            return mReloadedCount;
+        }
+
+        /**
+         * @brief Checks whether the last Rehydrate() call changed anything that should be saved back.
+         *
+         * This is the case if any targets were reloaded or if touched but otherwise unchanged files had their stamps
+         * refreshed.
+         */
+        bool IsModified() const
+        {
+            return mReloadedCount > 0 || mRefreshedStamps;
+        }
+
+    private:
+        enum class NodeState
+        {
+            Clean,
+            Dirty,
+            Gone
+        };
+
+        struct Node
+        {
+            fs::path path;
+            fs::path config_path;
+
+            std::string name;
+            std::string module;
+            TargetType type;
+
+            TargetConfig config;
+
+            std::vector<FileStamp> stamps;
+            std::vector<TargetDependency> dependencies;
+            std::shared_ptr<StringArena> source_arena = std::make_shared<StringArena>();
+            std::vector<SourceFile> sources;
+            std::vector<fs::path> excluded_paths;
+            std::vector<Node> children;
+
+            NodeState state = NodeState::Clean;
+        };
+
+        std::unique_ptr<Node> mRoot;
+        std::size_t mReloadedCount = 0;
+        bool mRefreshedStamps = false;
+
+        void ValidateNode(Node &node);
+        static std::unique_ptr<Target> RestoreNode(Node &node);
+
+        void RehydrateChildren(Node &node, Target &target);
+        std::unique_ptr<Target> ReloadNode(Node &node, Target *pParent);
+    };
+} // namespace re
@@ -2,8 +2,12 @@
 #include <re/fs.h>
 #include <re/target.h>
 
+#include <future>
+
 namespace re
 {
+    class DepFetchScheduler;
+
     struct ITargetLoadMiddleware
     {
         virtual ~ITargetLoadMiddleware() = default;
@@ -15,5 +19,26 @@ namespace re
             const Target* ancestor,
             const TargetDependency* dep_source
         ) = 0;
+
+        /**
+         * @brief Starts the expensive part of loading a target (like generating a foreign project's build files) on
+         * the scheduler, so that it runs concurrently for several targets before they are actually loaded.
+         *
+         * @param path The target path
+         * @param ancestor The target's "ancestor" target responsible for it (can be nullptr)
+         * @param dep_source The target's "source" dependency which caused it to be loaded (can be nullptr)
+         * @param scheduler The scheduler to run the work on
+         *
+         * @return std::shared_future<void> The scheduled work, or an invalid future if there is nothing to do
+         */
+        virtual std::shared_future<void> PrepareTargetLoadAsync(
+            const fs::path& path,
+            const Target* ancestor,
+            const TargetDependency* dep_source,
+            DepFetchScheduler& scheduler
+        )
+        {
+            return {};
+        }
     };
 }
@@ -23,6 +23,18 @@ namespace re
 			const TargetDependency* dep_source = nullptr
 		) = 0;
 
+		// Starts whatever can be done ahead of LoadFreeTarget for this path (like configuring a foreign project) on the
+		// scheduler. Returns an invalid future if there is nothing to do.
+		virtual std::shared_future<void> PrepareFreeTargetAsync(
+			const fs::path& path,
+			const Target* ancestor,
+			const TargetDependency* dep_source,
+			DepFetchScheduler& scheduler
+		)
+		{
+			return {};
+		}
+
 		virtual Target* GetCoreTarget() = 0;
 		virtual void RegisterLocalTarget(Target* pTarget) = 0;
 		virtual IDepResolver* GetDepResolver(ulib::string_view name) = 0;
@@ -1,90 +1,420 @@
 #include "vars.h"
 
-#include <boost/xpressive/xpressive.hpp>
+#include <charconv>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace re
 {
     namespace
     {
-        // \$\{(?:(\w+?):\s*)?([A-Za-z\-\_0-9]*)(?:\s*\|\s*\s*(?:\$(\w+?):\s*)?(.+?)?)?\}
+        bool IsSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+        }
 
-        const auto kOuterVarRegex = boost::xpressive::sregex::compile(R"(\$\{(.*?)\})");
-        const auto kVarRegex = boost::xpressive::sregex::compile(R"((?:([^:|]+)?:\s*)?([^|\s]*)(?:\s*\|\s*(.*))?)");
+        std::string_view SkipSpaces(std::string_view text)
+        {
+            while (!text.empty() && IsSpace(text.front()))
+                text.remove_prefix(1);
+
+            return text;
+        }
 
-        ulib::string GetVarValue(const VarContext &ctx, ulib::string_view original, ulib::string_view var,
-                                ulib::string_view default_namespace)
+        // The part of a `${ns: key | fallback}` reference between the braces. A fallback starting with '$' is another
+        // reference, which makes fallbacks chain.
+        struct VarReference
         {
-            ulib::string ns = default_namespace;
-            ulib::string key = "";
-            ulib::string fallback = "";
+            // Invalid references only fail when they are reached, as fallbacks may never be
+            bool valid = false;
 
-            boost::xpressive::smatch match;
+            std::optional<std::string> ns;
+            std::string key;
 
-            std::string vvv{var};
-            if (!boost::xpressive::regex_match(vvv, match, kVarRegex))
-                RE_THROW VarSubstitutionException("invalid variable definition\n    in string '{}'", original);
+            std::string fallback;
+            std::unique_ptr<VarReference> fallback_ref;
+        };
 
-            //////////////////////////////////////
+        VarReference ParseVarReference(std::string_view text)
+        {
+            VarReference ref;
+
+            // Namespaces can contain anything but colons and pipes, keys can't contain spaces and pipes
+            auto colon = text.find(':');
 
-            if (match[1])
-                ns = match[1].str();
+            if (colon != text.npos && colon < text.find('|'))
+            {
+                if (colon > 0)
+                    ref.ns = std::string{text.substr(0, colon)};
 
-            if (match[2])
-                key = match[2].str();
-            else
-                RE_THROW VarSubstitutionException("variable name not specified\n    in string '{}'", original);
+                text = SkipSpaces(text.substr(colon + 1));
+            }
 
-            if (match[3])
-                fallback = match[3].str();
+            auto key_end = std::min(text.find('|'), text.size());
 
-            //////////////////////////////////////
+            for (std::size_t i = 0; i < key_end; i++)
+                if (IsSpace(text[i]))
+                    key_end = i;
 
-            auto it = ctx.find(ns);
+            ref.key = std::string{text.substr(0, key_end)};
+            text = text.substr(key_end);
 
-            if (it == ctx.end())
+            // Anything after the key has to be a fallback, including trailing whitespace
+            if (!text.empty())
             {
-                ulib::string namespaces;
+                text = SkipSpaces(text);
 
-                for (auto &[key, _] : ctx)
-                    namespaces += ulib::format("\n    {}", key);
+                if (text.empty() || text.front() != '|')
+                    return ref;
 
-                RE_THROW VarSubstitutionException(
-                    "var namespace '{}' not found\n    in string '{}'\n\n    Available namespaces:{}", ns, original,
-                    namespaces);
+                text = SkipSpaces(text.substr(1));
+                ref.fallback = std::string{text};
+
+                if (!ref.fallback.empty() && ref.fallback.front() == '$')
+                    ref.fallback_ref = std::make_unique<VarReference>(ParseVarReference(text.substr(1)));
             }
 
-            //////////////////////////////////////
+            ref.valid = true;
+            return ref;
+        }
+
+        /**
+         * @brief A string split into literal parts and variable references once, so that substituting it doesn't
+         * involve any parsing.
+         */
+        class VarTemplate
+        {
+        public:
+            explicit VarTemplate(std::string_view source) : mSource{source}
+            {
+                std::string_view text = mSource;
+
+                std::size_t literal_start = 0;
+                std::size_t pos = 0;
+
+                while ((pos = text.find("${", pos)) != text.npos)
+                {
+                    // References end at the first closing brace
+                    auto end = text.find('}', pos + 2);
+
+                    if (end == text.npos)
+                        break;
+
+                    if (pos > literal_start)
+                        mTokens.push_back({text.substr(literal_start, pos - literal_start), nullptr});
+
+                    auto &ref = mReferences.emplace_back(ParseVarReference(text.substr(pos + 2, end - pos - 2)));
+                    mTokens.push_back({{}, &ref});
+
+                    pos = literal_start = end + 1;
+                }
+
+                if (literal_start < text.size())
+                    mTokens.push_back({text.substr(literal_start), nullptr});
+            }
+
+            // Tokens point into the template itself
+            VarTemplate(const VarTemplate &) = delete;
+            VarTemplate &operator=(const VarTemplate &) = delete;
+
+            const std::string &GetSource() const
+            {
+                return mSource;
+            }
+
+            std::string Substitute(const VarContext &ctx, std::string_view default_namespace) const;
+
+        private:
+            struct Token
+            {
+                std::string_view literal;
+                const VarReference *ref;
+            };
+
+            std::string mSource;
+
+            std::vector<Token> mTokens;
+            std::deque<VarReference> mReferences;
+
+            std::string GetValue(const VarContext &ctx, const VarReference &ref,
+                                 const std::string &default_namespace) const;
+        };
+
+        std::string VarTemplate::Substitute(const VarContext &ctx, std::string_view default_namespace) const
+        {
+            std::string ns{default_namespace};
+            std::string result;
 
-            if (auto var = it->second->GetVar(key))
+            for (auto &token : mTokens)
             {
-                return VarSubstitute(ctx, *var, default_namespace);
+                if (token.ref)
+                    result += GetValue(ctx, *token.ref, ns);
+                else
+                    result += token.literal;
             }
-            else
+
+            return result;
+        }
+
+        std::string VarTemplate::GetValue(const VarContext &ctx, const VarReference &ref,
+                                          const std::string &default_namespace) const
+        {
+            for (auto current = &ref;; current = current->fallback_ref.get())
             {
-                if (!fallback.empty())
+                if (!current->valid)
+                    RE_THROW VarSubstitutionException("invalid variable definition\n    in string '{}'", mSource);
+
+                auto &ns = current->ns ? *current->ns : default_namespace;
+                auto var_ns = ctx.GetNamespace(ns);
+
+                if (!var_ns)
                 {
-                    if (fallback.front() == '$')
-                        return GetVarValue(ctx, original, fallback.substr(1), default_namespace);
-                    else
-                        return fallback;
+                    ulib::string namespaces;
+
+                    for (auto &name : ctx.GetNamespaceNames())
+                        namespaces += ulib::format("\n    {}", name);
+
+                    RE_THROW VarSubstitutionException(
+                        "var namespace '{}' not found\n    in string '{}'\n\n    Available namespaces:{}", ns, mSource,
+                        namespaces);
                 }
-                else
-                    RE_THROW VarSubstitutionException("variable '{}:{}' not defined\n    in string '{}'", ns, key,
-                                                      original);
+
+                if (auto var = var_ns->GetVar(current->key))
+                    return VarSubstitute(ctx, *var, default_namespace);
+
+                if (current->fallback.empty())
+                    RE_THROW VarSubstitutionException("variable '{}:{}' not defined\n    in string '{}'", ns,
+                                                      current->key, mSource);
+
+                if (!current->fallback_ref)
+                    return current->fallback;
             }
         }
+
+        std::shared_ptr<const VarTemplate> GetVarTemplate(std::string_view str)
+        {
+            // Too many distinct strings mean they aren't coming from configs: those just get compiled again
+            constexpr std::size_t kMaxCachedTemplates = 64 * 1024;
+
+            // Substitution happens on the source scanning and fetch threads as well: each one gets its own cache.
+            // Templates are shared so that clearing the cache doesn't destroy those in the middle of a substitution.
+            thread_local std::unordered_map<std::string_view, std::shared_ptr<const VarTemplate>> cache;
+
+            if (auto it = cache.find(str); it != cache.end())
+                return it->second;
+
+            if (cache.size() >= kMaxCachedTemplates)
+                cache.clear();
+
+            auto result = std::make_shared<const VarTemplate>(str);
+            cache.emplace(result->GetSource(), result);
+
+            return result;
+        }
     } // namespace
 
+    struct VarContext::Layer
+    {
+        std::shared_ptr<const Layer> base;
+
+        std::unordered_map<std::string, const IVarNamespace *> namespaces;
+        std::unordered_map<std::string, NamespaceResolver> resolvers;
+
+        std::size_t depth = 0;
+    };
+
+    VarContext::VarContext(const VarContext &other) : mBase{other.GetSnapshot()}
+    {
+    }
+
+    VarContext &VarContext::operator=(const VarContext &other)
+    {
+        if (this == &other)
+            return *this;
+
+        auto base = other.GetSnapshot();
+
+        mBase = std::move(base);
+        mNamespaces.clear();
+        mResolvers.clear();
+
+        InvalidateSnapshot();
+        return *this;
+    }
+
+    const IVarNamespace *VarContext::GetNamespace(const std::string &name) const
+    {
+        auto find_resolved = [&name](auto &resolvers) -> std::optional<const IVarNamespace *> {
+            for (auto &[prefix, resolver] : resolvers)
+                if (name.size() >= prefix.size() && name.compare(0, prefix.size(), prefix) == 0)
+                    return resolver(ulib::string_view{name.data() + prefix.size(), name.size() - prefix.size()});
+
+            return std::nullopt;
+        };
+
+        if (auto it = mNamespaces.find(name); it != mNamespaces.end())
+            return it->second;
+
+        for (auto layer = mBase.get(); layer; layer = layer->base.get())
+            if (auto it = layer->namespaces.find(name); it != layer->namespaces.end())
+                return it->second;
+
+        if (auto ns = find_resolved(mResolvers))
+            return *ns;
+
+        for (auto layer = mBase.get(); layer; layer = layer->base.get())
+            if (auto ns = find_resolved(layer->resolvers))
+                return *ns;
+
+        return nullptr;
+    }
+
+    void VarContext::SetNamespace(const std::string &name, const IVarNamespace *ns)
+    {
+        mNamespaces[name] = ns;
+        InvalidateSnapshot();
+    }
+
+    void VarContext::RemoveNamespace(const std::string &name)
+    {
+        bool in_base = false;
+
+        for (auto layer = mBase.get(); layer && !in_base; layer = layer->base.get())
+            in_base = layer->namespaces.count(name) != 0;
+
+        if (in_base)
+            mNamespaces[name] = nullptr;
+        else
+            mNamespaces.erase(name);
+
+        InvalidateSnapshot();
+    }
+
+    void VarContext::SetNamespaceResolver(const std::string &prefix, NamespaceResolver resolver)
+    {
+        mResolvers[prefix] = std::move(resolver);
+        InvalidateSnapshot();
+    }
+
+    std::vector<std::string> VarContext::GetNamespaceNames() const
+    {
+        // Upper layers shadow lower ones
+        std::map<std::string, bool> visible;
+
+        auto collect = [&visible](auto &namespaces, auto &resolvers) {
+            for (auto &[name, ns] : namespaces)
+                visible.emplace(name, ns != nullptr);
+
+            for (auto &[prefix, _] : resolvers)
+                visible.emplace(prefix + "*", true);
+        };
+
+        collect(mNamespaces, mResolvers);
+
+        for (auto layer = mBase.get(); layer; layer = layer->base.get())
+            collect(layer->namespaces, layer->resolvers);
+
+        std::vector<std::string> result;
+
+        for (auto &[name, is_visible] : visible)
+            if (is_visible)
+                result.push_back(name);
+
+        return result;
+    }
+
+    std::shared_ptr<const VarContext::Layer> VarContext::GetSnapshot() const
+    {
+        // Contexts copied from copies make the chain deeper: once it gets too long, lookups are made flat again
+        constexpr std::size_t kMaxDepth = 8;
+
+        std::lock_guard lock{mSnapshotMutex};
+
+        if (mSnapshot)
+            return mSnapshot;
+
+        // Nothing changed on top of the base: copies can share it directly
+        if (mBase && mNamespaces.empty() && mResolvers.empty())
+            return mSnapshot = mBase;
+
+        auto layer = std::make_shared<Layer>();
+
+        if (mBase && mBase->depth + 1 >= kMaxDepth)
+        {
+            std::vector<const Layer *> layers;
+
+            for (auto base = mBase.get(); base; base = base->base.get())
+                layers.push_back(base);
+
+            // Applied bottom to top, so that upper layers overwrite lower ones
+            for (auto it = layers.rbegin(); it != layers.rend(); ++it)
+            {
+                for (auto &[name, ns] : (*it)->namespaces)
+                    layer->namespaces[name] = ns;
+
+                for (auto &[prefix, resolver] : (*it)->resolvers)
+                    layer->resolvers[prefix] = resolver;
+            }
+
+            for (auto &[name, ns] : mNamespaces)
+                layer->namespaces[name] = ns;
+
+            for (auto &[prefix, resolver] : mResolvers)
+                layer->resolvers[prefix] = resolver;
+
+            // Nothing below the flattened layer can be shadowed anymore
+            for (auto it = layer->namespaces.begin(); it != layer->namespaces.end();)
+                it = it->second ? std::next(it) : layer->namespaces.erase(it);
+        }
+        else
+        {
+            layer->base = mBase;
+            layer->namespaces = mNamespaces;
+            layer->resolvers = mResolvers;
+            layer->depth = mBase ? mBase->depth + 1 : 0;
+        }
+
+        return mSnapshot = std::move(layer);
+    }
+
+    void VarContext::InvalidateSnapshot()
+    {
+        std::lock_guard lock{mSnapshotMutex};
+        mSnapshot.reset();
+    }
+
+    std::int64_t ParseIntegerVar(ulib::string_view name, ulib::string_view value, std::int64_t min, std::int64_t max)
+    {
+        std::string_view text{value.data(), value.size()};
+        std::int64_t result = 0;
+
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), result);
+
+        if (text.empty() || ec != std::errc{} || end != text.data() + text.size() || result < min || result > max)
+        {
+            if (max == std::numeric_limits<std::int64_t>::max())
+                RE_THROW Exception("Invalid value '{}' for variable '{}': expected an integer of at least {}", text,
+                                   name, min);
+
+            RE_THROW Exception("Invalid value '{}' for variable '{}': expected an integer from {} to {}", text, name,
+                               min, max);
+        }
+
+        return result;
+    }
+
     ulib::string VarSubstitute(const VarContext &ctx, ulib::string_view str, ulib::string_view default_namespace)
     {
-        using namespace boost::xpressive;
+        std::string_view text{str.data(), str.size()};
+
+        // Most strings don't reference anything
+        if (text.find("${") == text.npos)
+            return ulib::string{str};
 
-        return regex_replace(
-            std::string{str}, kOuterVarRegex,
-            [&str, &ctx, &default_namespace](const smatch &match) {
-                return GetVarValue(ctx, str, match[1].str(), default_namespace);
-            },
-            regex_constants::match_any);
+        std::string_view ns{default_namespace.data(), default_namespace.size()};
+        return GetVarTemplate(text)->Substitute(ctx, ns);
     }
 
     LocalVarScope::LocalVarScope(VarContext *context, ulib::string_view alias, const IVarNamespace *parent,
@@ -112,13 +442,13 @@ namespace re
     {
         if (mContext)
         {
-            mContext->erase(mLocalName);
+            mContext->RemoveNamespace(mLocalName);
 
             if (!mAlias.empty())
-                mContext->erase(mAlias);
+                mContext->RemoveNamespace(mAlias);
 
             if (!mParentAlias.empty())
-                mContext->erase(mParentAlias);
+                mContext->RemoveNamespace(mParentAlias);
         }
     }
 
@@ -133,7 +463,7 @@ namespace re
     void LocalVarScope::AddNamespace(ulib::string_view name, IVarNamespace *ns)
     {
         // fmt::print(" * [{}] Adding var namespace '{}'\n", mLocalName, name);
-        (*mContext)[name] = ns;
+        mContext->SetNamespace(name, ns);
     }
 
     void LocalVarScope::SetVar(ulib::string_view key, std::string value)
@@ -170,13 +500,13 @@ namespace re
 
         if (mContext)
         {
-            (*mContext)[mLocalName] = this;
+            mContext->SetNamespace(mLocalName, this);
 
             if (!mAlias.empty())
-                (*mContext)[mAlias] = this;
+                mContext->SetNamespace(mAlias, this);
 
             if (!mParentAlias.empty())
-                (*mContext)[mParentAlias] = mParent;
+                mContext->SetNamespace(mParentAlias, mParent);
         }
 
         // if (mParent)
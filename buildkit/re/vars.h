@@ -1,9 +1,15 @@
 #pragma once
 #include <unordered_map>
 
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "error.h"
 
@@ -16,7 +22,61 @@ namespace re
         virtual std::optional<ulib::string> GetVar(ulib::string_view key) const = 0;
     };
 
-    using VarContext = std::unordered_map<std::string, const IVarNamespace *>;
+    /**
+     * @brief The variable namespaces available to substitutions, by name.
+     *
+     * Copying a context is cheap: the copy shares everything the original had at that moment as an immutable layer and
+     * only stores its own changes on top of it. Per-target contexts are small overlays over the global one this way.
+     */
+    class VarContext
+    {
+    public:
+        /**
+         * @brief Resolves a namespace on demand, taking the part of its name after the prefix it was registered with.
+         * Returns nullptr if there is no such namespace.
+         */
+        using NamespaceResolver = std::function<const IVarNamespace *(ulib::string_view name)>;
+
+        VarContext() = default;
+
+        VarContext(const VarContext &other);
+        VarContext &operator=(const VarContext &other);
+
+        const IVarNamespace *GetNamespace(const std::string &name) const;
+
+        void SetNamespace(const std::string &name, const IVarNamespace *ns);
+
+        void RemoveNamespace(const std::string &name);
+
+        /**
+         * @brief Makes every namespace whose name starts with `prefix` resolve through a function when it is first
+         * looked up, so that large families of namespaces (like `target/<module>`) never have to be populated.
+         *
+         * Namespaces set explicitly take precedence over resolvers.
+         */
+        void SetNamespaceResolver(const std::string &prefix, NamespaceResolver resolver);
+
+        /**
+         * @brief Lists the namespaces for diagnostics. Resolvers are listed as `<prefix>*`.
+         */
+        std::vector<std::string> GetNamespaceNames() const;
+
+    private:
+        struct Layer;
+
+        std::shared_ptr<const Layer> mBase;
+
+        // Removed namespaces are kept as nullptr when a layer below still has them
+        std::unordered_map<std::string, const IVarNamespace *> mNamespaces;
+        std::unordered_map<std::string, NamespaceResolver> mResolvers;
+
+        // What copies get as their base: it stays valid until this context changes
+        mutable std::mutex mSnapshotMutex;
+        mutable std::shared_ptr<const Layer> mSnapshot;
+
+        std::shared_ptr<const Layer> GetSnapshot() const;
+        void InvalidateSnapshot();
+    };
 
     class VarSubstitutionException : public Exception
     {
@@ -30,6 +90,21 @@ namespace re
 
     ulib::string VarSubstitute(const VarContext &ctx, ulib::string_view str, ulib::string_view default_namespace = "");
 
+    /**
+     * @brief Parses the value of a numeric variable, like a thread count or a timeout.
+     *
+     * @param name The variable's name, for the error message
+     * @param value The variable's value
+     * @param min The smallest value allowed
+     * @param max The largest value allowed
+     *
+     * @throws Exception Thrown if the value isn't an integer or falls outside of [min, max].
+     *
+     * @return std::int64_t The parsed value
+     */
+    std::int64_t ParseIntegerVar(ulib::string_view name, ulib::string_view value, std::int64_t min,
+                                 std::int64_t max = std::numeric_limits<std::int64_t>::max());
+
     class LocalVarScope : public IVarNamespace
     {
     public:
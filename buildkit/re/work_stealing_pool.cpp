@@ -0,0 +1,168 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace re
+{
+    namespace
+    {
+        thread_local const WorkStealingPool *tCurrentPool = nullptr;
+        thread_local std::size_t tCurrentWorker = 0;
+    } // namespace
+
+    WorkStealingPool::WorkStealingPool(std::size_t num_threads)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        mWorkers.reserve(num_threads);
+
+        for (std::size_t i = 0; i < num_threads; i++)
+            mWorkers.emplace_back(std::make_unique<Worker>());
+
+        // Only start the threads once every worker slot exists so that stealing never sees a partial vector
+        for (std::size_t i = 0; i < num_threads; i++)
+            mWorkers[i]->thread = std::thread{&WorkStealingPool::WorkerMain, this, i};
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        {
+            std::lock_guard lock{mMutex};
+            mStopping = true;
+        }
+
+        mWorkAvailable.notify_all();
+
+        for (auto &worker : mWorkers)
+            if (worker->thread.joinable())
+                worker->thread.join();
+    }
+
+    void WorkStealingPool::Submit(Task task)
+    {
+        // Tasks spawned by a worker stay on that worker's deque; outside submissions are spread round-robin.
+        std::size_t index = (tCurrentPool == this) ? tCurrentWorker : (mNextWorker++ % mWorkers.size());
+
+        mPending++;
+
+        {
+            // The count has to go up along with the push: a worker could otherwise take the task and decrement it
+            // first, leaving idle workers spinning on a wrapped-around count
+            std::lock_guard lock{mMutex};
+
+            auto &worker = *mWorkers[index];
+            std::lock_guard worker_lock{worker.mutex};
+
+            worker.tasks.emplace_back(std::move(task));
+            mQueued++;
+        }
+
+        mWorkAvailable.notify_one();
+    }
+
+    void WorkStealingPool::Wait()
+    {
+        std::unique_lock lock{mMutex};
+        mAllDone.wait(lock, [this] { return mPending == 0; });
+
+        if (mError)
+        {
+            auto error = std::exchange(mError, nullptr);
+            mFailed = false;
+
+            std::rethrow_exception(error);
+        }
+    }
+
+    void WorkStealingPool::WorkerMain(std::size_t index)
+    {
+        tCurrentPool = this;
+        tCurrentWorker = index;
+
+        while (true)
+        {
+            Task task;
+
+            if (TryPop(index, task) || TrySteal(index, task))
+            {
+                {
+                    std::lock_guard lock{mMutex};
+                    mQueued--;
+                }
+
+                // Once something has failed there is no point in finishing the rest of the work.
+                if (!mFailed)
+                {
+                    try
+                    {
+                        task();
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard lock{mMutex};
+
+                        if (!mError)
+                            mError = std::current_exception();
+
+                        mFailed = true;
+                    }
+                }
+
+                FinishTask();
+                continue;
+            }
+
+            std::unique_lock lock{mMutex};
+            mWorkAvailable.wait(lock, [this] { return mStopping || mQueued > 0; });
+
+            if (mStopping)
+                return;
+        }
+    }
+
+    bool WorkStealingPool::TryPop(std::size_t index, Task &out)
+    {
+        auto &worker = *mWorkers[index];
+        std::lock_guard lock{worker.mutex};
+
+        if (worker.tasks.empty())
+            return false;
+
+        // LIFO for our own work keeps depth-first traversals cache-friendly
+        out = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+
+        return true;
+    }
+
+    bool WorkStealingPool::TrySteal(std::size_t index, Task &out)
+    {
+        for (std::size_t i = 1; i < mWorkers.size(); i++)
+        {
+            auto &victim = *mWorkers[(index + i) % mWorkers.size()];
+            std::lock_guard lock{victim.mutex};
+
+            if (victim.tasks.empty())
+                continue;
+
+            // FIFO when stealing: the oldest tasks tend to be the largest chunks of work
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void WorkStealingPool::FinishTask()
+    {
+        if (--mPending == 0)
+        {
+            std::lock_guard lock{mMutex};
+            mAllDone.notify_all();
+        }
+    }
+} // namespace re
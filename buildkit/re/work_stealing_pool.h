@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace re
+{
+    /**
+     * @brief A fixed-size thread pool where every worker owns a task deque and idle workers steal from the others.
+     *
+     * Tasks submitted from within a worker go to that worker's own deque, which keeps recursive workloads (like
+     * directory walks) local to a thread until someone else runs out of work.
+     */
+    class WorkStealingPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        /**
+         * @brief Construct a new WorkStealingPool object.
+         *
+         * @param num_threads The number of worker threads to spawn (0 means one per hardware thread)
+         */
+        explicit WorkStealingPool(std::size_t num_threads = 0);
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        ~WorkStealingPool();
+
+        /**
+         * @brief Schedules a task to be run on one of the worker threads.
+         *
+         * @param task The task to run
+         */
+        void Submit(Task task);
+
+        /**
+         * @brief Blocks until every submitted task (including ones submitted by other tasks) has finished.
+         *
+         * If any task threw an exception, the remaining queued tasks are discarded and the first exception is
+         * rethrown here.
+         */
+        void Wait();
+
+        /**
+         * @brief Gets the number of worker threads in this pool.
+         */
+        std::size_t GetThreadCount() const
+        {
+            return mWorkers.size();
+        }
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+
+        std::mutex mMutex;
+        std::condition_variable mWorkAvailable;
+        std::condition_variable mAllDone;
+
+        std::atomic<std::size_t> mPending{0};
+        std::atomic<std::size_t> mNextWorker{0};
+
+        std::exception_ptr mError;
+        std::atomic<bool> mFailed{false};
+
+        std::size_t mQueued = 0;
+        bool mStopping = false;
+
+        void WorkerMain(std::size_t index);
+
+        bool TryPop(std::size_t index, Task &out);
+        bool TrySteal(std::size_t index, Task &out);
+
+        void FinishTask();
+    };
+} // namespace re
@@ -0,0 +1,215 @@
+#include "yaml_parse_cache.h"
+
+#include <re/binary_stream.h>
+#include <re/target.h>
+#include <re/version.h>
+
+#include <fmt/format.h>
+#include <futile/futile.h>
+
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace re
+{
+    namespace
+    {
+        constexpr char kYamlCacheMagic[] = {'R', 'E', 'Y', 'C'};
+        constexpr std::uint64_t kYamlCacheFormatVersion = 1;
+
+        // Documents not used by the current run are only kept on disk while the cache stays below this size
+        constexpr std::size_t kMaxStoredEntries = 4096;
+    } // namespace
+
+    YamlParseCache &YamlParseCache::Get()
+    {
+        static YamlParseCache instance;
+        return instance;
+    }
+
+    ulib::yaml YamlParseCache::Parse(std::string_view text)
+    {
+        auto hash = HashFileContents(text);
+
+        {
+            std::lock_guard lock{mMutex};
+
+            auto it = mEntries.find(hash);
+
+            if (it != mEntries.end() && it->second.size == text.size())
+            {
+                auto &entry = it->second;
+
+                if (!entry.node)
+                {
+                    try
+                    {
+                        BinaryReader reader{entry.serialized, "YAML parse cache"};
+                        entry.node = std::make_unique<ulib::yaml>(reader.ReadYaml());
+                    }
+                    catch (const std::exception &)
+                    {
+                        mEntries.erase(it);
+                        it = mEntries.end();
+                    }
+                }
+
+                if (it != mEntries.end())
+                {
+                    entry.used = true;
+                    return *entry.node;
+                }
+            }
+        }
+
+        // Parse outside of the lock: targets are loaded from multiple threads
+        auto node = ulib::yaml::parse(text);
+
+        std::lock_guard lock{mMutex};
+
+        auto &entry = mEntries[hash];
+
+        entry.size = text.size();
+        entry.serialized = {};
+        entry.node = std::make_unique<ulib::yaml>(node);
+        entry.used = true;
+
+        mModified = true;
+
+        return node;
+    }
+
+    ulib::yaml YamlParseCache::ParseFile(const fs::path &path)
+    {
+        auto data = futile::open(path).read();
+        return Parse({data.data(), data.size()});
+    }
+
+    void YamlParseCache::SetStoragePath(const fs::path &path)
+    {
+        std::lock_guard lock{mMutex};
+
+        if (mStoragePath == path)
+            return;
+
+        mStoragePath = path;
+
+        std::ifstream file{path, std::ios::binary};
+
+        if (!file.good())
+            return;
+
+        // Entries loaded from disk point into this buffer, which is why it's kept around for the cache's lifetime
+        auto &data =
+            mStorageBuffers.emplace_back(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+        std::unordered_map<std::uint64_t, Entry> entries;
+
+        try
+        {
+            BinaryReader reader{data, "YAML parse cache"};
+
+            char magic[sizeof kYamlCacheMagic];
+            reader.ReadRaw(magic, sizeof magic);
+
+            if (std::memcmp(magic, kYamlCacheMagic, sizeof magic) != 0)
+                return;
+
+            if (reader.ReadU64() != kYamlCacheFormatVersion)
+                return;
+
+            if (reader.ReadString() != GetBuildRevision())
+                return;
+
+            for (auto count = reader.ReadU64(); count > 0; count--)
+            {
+                auto hash = reader.ReadU64();
+
+                Entry entry;
+                entry.size = reader.ReadU64();
+
+                auto length = reader.ReadU64();
+                entry.serialized = reader.ReadView(length);
+
+                entries.emplace(hash, std::move(entry));
+            }
+        }
+        catch (const std::exception &)
+        {
+            return;
+        }
+
+        for (auto &[hash, entry] : entries)
+            if (!mEntries.count(hash))
+                mEntries.emplace(hash, std::move(entry));
+    }
+
+    void YamlParseCache::Save()
+    {
+        std::lock_guard lock{mMutex};
+
+        if (!mModified || mStoragePath.empty())
+            return;
+
+        BinaryWriter writer;
+
+        writer.WriteRaw(kYamlCacheMagic, sizeof kYamlCacheMagic);
+        writer.WriteU64(kYamlCacheFormatVersion);
+        writer.WriteString(GetBuildRevision());
+
+        std::size_t count = 0;
+
+        for (auto &[hash, entry] : mEntries)
+            if (entry.used || count < kMaxStoredEntries)
+                count++;
+
+        writer.WriteU64(count);
+
+        std::size_t written = 0;
+
+        for (auto &[hash, entry] : mEntries)
+        {
+            if (!entry.used && written >= kMaxStoredEntries)
+                continue;
+
+            BinaryWriter node_writer;
+
+            if (entry.node)
+                node_writer.WriteYaml(*entry.node);
+            else
+                node_writer.WriteRaw(entry.serialized.data(), entry.serialized.size());
+
+            writer.WriteU64(hash);
+            writer.WriteU64(entry.size);
+            writer.WriteString(node_writer.GetData());
+
+            written++;
+        }
+
+        std::error_code ec;
+        fs::create_directories(mStoragePath.parent_path(), ec);
+
+        // Several Re processes might share the cache: write to a temporary file and atomically replace the old one
+        auto temp_path = mStoragePath;
+        temp_path += fmt::format(".{:x}.tmp", std::random_device{}());
+
+        {
+            std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+
+            if (!file.good())
+                return;
+
+            file.write(writer.GetData().data(), writer.GetData().size());
+
+            if (!file.good())
+                return;
+        }
+
+        fs::rename(temp_path, mStoragePath, ec);
+
+        if (ec)
+            fs::remove(temp_path, ec);
+        else
+            mModified = false;
+    }
+} // namespace re
@@ -0,0 +1,87 @@
+/**
+ * @file re/yaml_parse_cache.h
+ * @brief Content-addressed cache of parsed YAML documents
+ */
+
+#pragma once
+#include <re/fs.h>
+
+#include <ulib/yaml.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace re
+{
+    /**
+     * @brief A process-wide cache of parsed YAML documents keyed by the hash of their text.
+     *
+     * Target configs, partitions, `with:` includes and C++ environments all go through this cache, so a file shared
+     * by many targets is only parsed once. The cache can also be persisted to disk in a compact binary form, which
+     * means that unchanged files are never parsed again on the same machine.
+     *
+     * All methods are thread-safe.
+     */
+    class YamlParseCache
+    {
+    public:
+        /**
+         * @brief Gets the process-wide cache instance.
+         */
+        static YamlParseCache &Get();
+
+        /**
+         * @brief Parses a YAML document or returns a copy of the cached result.
+         *
+         * @param text The document's text
+         * @return ulib::yaml The parsed document, safe to modify
+         */
+        ulib::yaml Parse(std::string_view text);
+
+        /**
+         * @brief Reads and parses a YAML file or returns a copy of the cached result.
+         *
+         * @param path The file to parse
+         * @return ulib::yaml The parsed document, safe to modify
+         */
+        ulib::yaml ParseFile(const fs::path &path);
+
+        /**
+         * @brief Enables persisting the cache in the specified file, loading any entries it already has.
+         *
+         * Invalid or outdated cache files are silently ignored.
+         *
+         * @param path The cache file's path
+         */
+        void SetStoragePath(const fs::path &path);
+
+        /**
+         * @brief Writes the cache to its storage file if any new documents have been parsed since it was loaded.
+         */
+        void Save();
+
+    private:
+        struct Entry
+        {
+            std::uint64_t size = 0;
+
+            // Entries loaded from disk stay serialized until first used
+            std::string_view serialized;
+            std::unique_ptr<ulib::yaml> node;
+
+            bool used = false;
+        };
+
+        std::mutex mMutex;
+        std::unordered_map<std::uint64_t, Entry> mEntries;
+
+        fs::path mStoragePath;
+        std::list<std::string> mStorageBuffers;
+        bool mModified = false;
+    };
+} // namespace re
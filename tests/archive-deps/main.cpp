@@ -0,0 +1,285 @@
+/**
+ * @file tests/archive-deps/main.cpp
+ * @brief Resolves archive dependencies served by a local HTTP server and checks what ends up in the cache
+ */
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+#include <re/deps/archive_dep_resolver.h>
+#include <re/deps_version_cache.h>
+#include <re/process_util.h>
+#include <re/target.h>
+
+#include <fmt/format.h>
+
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = re::fs;
+
+namespace
+{
+    class TestOutput : public re::IUserOutput
+    {
+    public:
+        void DoPrint(re::UserOutputLevel level, fmt::text_style style, std::string_view text) override
+        {
+            if (level <= re::UserOutputLevel::Warn)
+                fmt::print("{}", text);
+        }
+    };
+
+    // Loads free targets straight from their directories, the way BuildEnv does without middlewares
+    class TestLoader : public re::ITargetLoader
+    {
+    public:
+        std::unique_ptr<re::Target> LoadFreeTarget(const fs::path &path, const re::Target *ancestor,
+                                                   const re::TargetDependency *dep_source) override
+        {
+            return std::make_unique<re::Target>(path);
+        }
+
+        re::Target *GetCoreTarget() override
+        {
+            return nullptr;
+        }
+
+        void RegisterLocalTarget(re::Target *pTarget) override
+        {
+        }
+
+        re::IDepResolver *GetDepResolver(ulib::string_view name) override
+        {
+            return nullptr;
+        }
+    };
+
+    // Serves in-memory files over HTTP on 127.0.0.1, on whatever port is free
+    class TestServer
+    {
+    public:
+        TestServer()
+        {
+            mServer.Get(R"(/(.+))", [this](const httplib::Request &request, httplib::Response &response) {
+                std::lock_guard lock{mMutex};
+
+                if (auto it = mFiles.find(request.matches[1].str()); it != mFiles.end())
+                    response.set_content(it->second, "application/octet-stream");
+                else
+                    response.status = 404;
+            });
+
+            mPort = mServer.bind_to_any_port("127.0.0.1");
+            mThread = std::thread{[this] { mServer.listen_after_bind(); }};
+        }
+
+        ~TestServer()
+        {
+            mServer.stop();
+            mThread.join();
+        }
+
+        void SetFile(const std::string &name, std::string data)
+        {
+            std::lock_guard lock{mMutex};
+            mFiles[name] = std::move(data);
+        }
+
+        std::string GetUrl(const std::string &name) const
+        {
+            return fmt::format("http://127.0.0.1:{}/{}", mPort, name);
+        }
+
+    private:
+        httplib::Server mServer;
+        std::thread mThread;
+        int mPort = 0;
+
+        std::mutex mMutex;
+        std::unordered_map<std::string, std::string> mFiles;
+    };
+
+    int gFailures = 0;
+
+    void Check(bool condition, const char *expr, int line)
+    {
+        if (condition)
+            return;
+
+        fmt::print(stderr, "FAILED (line {}): {}\n", line, expr);
+        gFailures++;
+    }
+
+#define CHECK(expr) Check((expr), #expr, __LINE__)
+
+    void WriteFile(const fs::path &path, std::string_view data)
+    {
+        fs::create_directories(path.parent_path());
+
+        std::ofstream file{path, std::ios::binary};
+        file << data;
+    }
+
+    std::string ReadFile(const fs::path &path)
+    {
+        std::ifstream file{path, std::ios::binary};
+        return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    }
+
+    // Packs `<dir>/<root>` the way release tarballs are: a single top-level directory holding everything
+    std::string MakeArchive(const fs::path &dir, const std::string &root, std::string_view version)
+    {
+        WriteFile(dir / root / "re.yml", "type: static-library\nname: lib\n");
+        WriteFile(dir / root / "lib.h", fmt::format("#define LIB_VERSION \"{}\"\n", version));
+        WriteFile(dir / root / "sub" / "re.yml", "type: static-library\nname: sub\n");
+        WriteFile(dir / root / "sub" / "sub.h", "#pragma once\n");
+
+        auto archive_path = dir / (root + ".tar.gz");
+
+        ulib::list<ulib::string> cmdline = {"cmake", "-E", "tar", "czf"};
+        cmdline.emplace_back(archive_path.u8string());
+        cmdline.emplace_back(root);
+
+        re::RunProcessOrThrow("cmake", {}, cmdline, false, true, dir);
+
+        return ReadFile(archive_path);
+    }
+
+    bool HasTemporaryEntries(const fs::path &cache_dir)
+    {
+        for (auto &entry : fs::directory_iterator{cache_dir})
+            if (entry.path().filename().u8string().rfind(".tmp-", 0) == 0)
+                return true;
+
+        return false;
+    }
+
+    re::TargetDependency ParseDependency(const re::Target &project, const std::string &str)
+    {
+        return re::ParseTargetDependency(ulib::string{str}, &project);
+    }
+
+    template <class F>
+    std::string GetErrorMessage(F &&f)
+    {
+        try
+        {
+            f();
+        }
+        catch (const re::TargetDependencyException &e)
+        {
+            return e.what();
+        }
+
+        return {};
+    }
+} // namespace
+
+int main()
+{
+    auto dir = fs::temp_directory_path() / fmt::format("re-archive-deps-test-{:x}", std::random_device{}());
+    auto cache_dir = dir / "project" / ".re-cache" / "archives";
+
+    fs::create_directories(dir / "project");
+
+    TestOutput out;
+    TestLoader loader;
+    TestServer server;
+
+    server.SetFile("lib.tar.gz", MakeArchive(dir / "packages", "lib-1.0", "1.0"));
+
+    re::Target project{dir / "project", "archive-deps-test", re::TargetType::Project,
+                       re::TargetConfig{ulib::yaml::value_t::map}};
+
+    project.root_path = dir / "project";
+    project.build_var_scope.emplace(&project.local_var_ctx, "build");
+
+    project.build_var_scope->SetVar("arch", "x64");
+    project.build_var_scope->SetVar("platform", "test");
+    project.build_var_scope->SetVar("configuration", "release");
+    project.build_var_scope->SetVar("auto-load-uncached-deps", "true");
+
+    auto url = server.GetUrl("lib.tar.gz");
+    auto dep = ParseDependency(project, "archive:" + url);
+
+    re::DepsVersionCache cache;
+
+    // The first download pins the archive's hash, and the single top-level directory becomes the package root
+    {
+        re::ArchiveDepResolver resolver{&loader, &out};
+
+        auto target = resolver.ResolveTargetDependency(project, dep, &cache);
+        auto hash = cache.GetLockedHash(dep);
+
+        CHECK(hash.has_value());
+        CHECK(target && hash && fs::equivalent(target->path, cache_dir / *hash));
+        CHECK(hash && fs::exists(cache_dir / *hash / "lib.h"));
+        CHECK(hash && !fs::exists(cache_dir / *hash / "lib-1.0"));
+        CHECK(!HasTemporaryEntries(cache_dir));
+    }
+
+    auto hash = cache.GetLockedHash(dep).value_or("");
+
+    // Cutouts load a subdirectory of the extracted archive as the package
+    {
+        re::ArchiveDepResolver resolver{&loader, &out};
+
+        auto cutout_dep = ParseDependency(project, "archive:" + url + " [/sub]");
+        auto target = resolver.ResolveTargetDependency(project, cutout_dep, &cache);
+
+        CHECK(target && fs::equivalent(target->path, cache_dir / hash / "sub"));
+        CHECK(target && target->name == "sub");
+    }
+
+    // Cutouts can't point outside of the extracted archive
+    for (auto filter : {"[/../project]", "[/sub/../../..]", "[//etc]"})
+    {
+        re::ArchiveDepResolver resolver{&loader, &out};
+
+        auto cutout_dep = ParseDependency(project, fmt::format("archive:{} {}", url, filter));
+        auto message = GetErrorMessage([&] { resolver.ResolveTargetDependency(project, cutout_dep, &cache); });
+
+        CHECK(message.find("points outside of the archive") != std::string::npos);
+    }
+
+    // A pinned archive that's already extracted is never downloaded again
+    {
+        re::ArchiveDepResolver resolver{&loader, &out};
+
+        server.SetFile("lib.tar.gz", "not an archive");
+
+        CHECK(resolver.ResolveTargetDependency(project, dep, &cache) != nullptr);
+        CHECK(cache.GetLockedHash(dep) == hash);
+    }
+
+    // Once it has to be downloaded again, anything that doesn't match the pinned hash is rejected
+    {
+        re::ArchiveDepResolver resolver{&loader, &out};
+
+        fs::remove_all(cache_dir / hash);
+        server.SetFile("lib.tar.gz", MakeArchive(dir / "packages", "lib-1.1", "1.1"));
+
+        auto message = GetErrorMessage([&] { resolver.ResolveTargetDependency(project, dep, &cache); });
+
+        CHECK(message.find("SHA-256 mismatch") != std::string::npos);
+        CHECK(cache.GetLockedHash(dep) == hash);
+        CHECK(!fs::exists(cache_dir / hash));
+        CHECK(!HasTemporaryEntries(cache_dir));
+    }
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+
+    if (gFailures)
+    {
+        fmt::print(stderr, "{} check(s) failed\n", gFailures);
+        return 1;
+    }
+
+    fmt::print("All archive dependency checks passed\n");
+    return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file tests/vars-bench/main.cpp
+ * @brief Checks VarSubstitute against the regex-based implementation it replaced and compares their speed
+ *
+ * Usage: vars-bench [seed] [fuzz-iterations] [bench-iterations]
+ */
+
+#include <re/vars.h>
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // What VarSubstitute used to do, as the reference for its results: the same two regexes, matched on every call.
+    // `[\s\S]` stands in for the '.' of the original (boost::xpressive) patterns, which matched newlines as well.
+    namespace reference
+    {
+        const std::regex kOuterVarRegex{R"(\$\{([\s\S]*?)\})"};
+        const std::regex kVarRegex{R"((?:([^:|]+)?:\s*)?([^|\s]*)(?:\s*\|\s*([\s\S]*))?)"};
+
+        std::string Substitute(const re::VarContext &ctx, const std::string &str, const std::string &default_namespace);
+
+        std::string GetVarValue(const re::VarContext &ctx, const std::string &original, const std::string &var,
+                                const std::string &default_namespace)
+        {
+            std::smatch match;
+
+            if (!std::regex_match(var, match, kVarRegex))
+                RE_THROW re::VarSubstitutionException("invalid variable definition\n    in string '{}'", original);
+
+            auto ns = match[1].matched ? match[1].str() : default_namespace;
+            auto key = match[2].str();
+            auto fallback = match[3].str();
+
+            auto var_ns = ctx.GetNamespace(ns);
+
+            if (!var_ns)
+            {
+                ulib::string namespaces;
+
+                for (auto &name : ctx.GetNamespaceNames())
+                    namespaces += ulib::format("\n    {}", name);
+
+                RE_THROW re::VarSubstitutionException(
+                    "var namespace '{}' not found\n    in string '{}'\n\n    Available namespaces:{}", ns, original,
+                    namespaces);
+            }
+
+            if (auto value = var_ns->GetVar(key))
+            {
+                std::string value_str = *value;
+                return Substitute(ctx, value_str, default_namespace);
+            }
+
+            if (fallback.empty())
+                RE_THROW re::VarSubstitutionException("variable '{}:{}' not defined\n    in string '{}'", ns, key,
+                                                      original);
+
+            if (fallback.front() == '$')
+                return GetVarValue(ctx, original, fallback.substr(1), default_namespace);
+
+            return fallback;
+        }
+
+        std::string Substitute(const re::VarContext &ctx, const std::string &str, const std::string &default_namespace)
+        {
+            std::string result;
+            auto last = str.cbegin();
+
+            for (auto it = std::sregex_iterator{str.begin(), str.end(), kOuterVarRegex}; it != std::sregex_iterator{};
+                 ++it)
+            {
+                result.append(last, (*it)[0].first);
+                result += GetVarValue(ctx, str, (*it)[1].str(), default_namespace);
+
+                last = (*it)[0].second;
+            }
+
+            result.append(last, str.cend());
+            return result;
+        }
+    } // namespace reference
+
+    struct Result
+    {
+        bool ok = false;
+        std::string text;
+
+        bool operator==(const Result &other) const
+        {
+            return ok == other.ok && text == other.text;
+        }
+
+        bool operator!=(const Result &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    template <class F>
+    Result Run(F &&f)
+    {
+        try
+        {
+            return {true, f()};
+        }
+        catch (const re::VarSubstitutionException &e)
+        {
+            return {false, e.what()};
+        }
+    }
+
+    Result SubstituteNew(const re::VarContext &ctx, const std::string &str)
+    {
+        return Run([&] {
+            std::string result = re::VarSubstitute(ctx, ulib::string{str}, "re");
+            return result;
+        });
+    }
+
+    Result SubstituteReference(const re::VarContext &ctx, const std::string &str)
+    {
+        return Run([&] { return reference::Substitute(ctx, str, "re"); });
+    }
+
+    // Random strings made of reference syntax fragments: most of them are broken in some interesting way
+    std::vector<std::string> MakeFuzzInputs(unsigned seed, std::size_t count)
+    {
+        const std::vector<std::string> atoms = {"${", "}", ":",  "|",  " ", "$", "a", "b",
+                                                "x",  "re", "build", "\n", "\t", "c", "lit"};
+
+        std::mt19937 rng{seed};
+        std::vector<std::string> inputs;
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto &input = inputs.emplace_back();
+            auto length = rng() % 24;
+
+            for (std::size_t j = 0; j < length; j++)
+                input += atoms[rng() % atoms.size()];
+        }
+
+        return inputs;
+    }
+
+    template <class F>
+    double MeasureNanoseconds(const std::vector<std::string> &inputs, std::size_t iterations, F &&substitute)
+    {
+        std::size_t total_size = 0;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < iterations; i++)
+            for (auto &input : inputs)
+                total_size += substitute(input).text.size();
+
+        auto end = std::chrono::steady_clock::now();
+
+        // Keeps the substitutions from being optimized out
+        if (total_size == 0)
+            fmt::print("");
+
+        return std::chrono::duration<double, std::nano>(end - start).count() / (inputs.size() * iterations);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto seed = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 10)) : 42u;
+    auto fuzz_iterations = argc > 2 ? std::size_t(std::strtoull(argv[2], nullptr, 10)) : std::size_t{200000};
+    auto bench_iterations = argc > 3 ? std::size_t(std::strtoull(argv[3], nullptr, 10)) : std::size_t{20000};
+
+    re::VarContext ctx;
+
+    re::LocalVarScope scope{&ctx, "re"};
+    re::LocalVarScope build{&ctx, "build", &scope};
+
+    scope.SetVar("a", "A");
+    scope.SetVar("b", "${a}x");
+    scope.SetVar("", "EMPTY");
+    scope.SetVar("re", "R ${build:a | lit}");
+    build.SetVar("x", "X${a}");
+
+    std::size_t differences = 0;
+
+    for (auto &input : MakeFuzzInputs(seed, fuzz_iterations))
+    {
+        auto expected = SubstituteReference(ctx, input);
+        auto actual = SubstituteNew(ctx, input);
+
+        if (actual == expected)
+            continue;
+
+        if (differences++ < 10)
+            fmt::print("Difference for {:?}:\n  reference: {} {:?}\n  current:   {} {:?}\n", input, expected.ok,
+                       expected.text, actual.ok, actual.text);
+    }
+
+    fmt::print("{} fuzzed strings (seed {}), {} difference(s)\n", fuzz_iterations, seed, differences);
+
+    // What flags and paths in target configs typically look like
+    const std::vector<std::string> bench_inputs = {"-I${re:a}/include", "${b} ${build:x} plain", "no vars at all here",
+                                                   "${c | $a} ${c | fallback}", "${build:a | lit}/${re}"};
+
+    auto reference_ns = MeasureNanoseconds(bench_inputs, bench_iterations,
+                                           [&](auto &input) { return SubstituteReference(ctx, input); });
+    auto current_ns = MeasureNanoseconds(bench_inputs, bench_iterations,
+                                         [&](auto &input) { return SubstituteNew(ctx, input); });
+
+    fmt::print("reference: {:.1f} ns/substitution\n", reference_ns);
+    fmt::print("current:   {:.1f} ns/substitution ({:.1f}x)\n", current_ns, reference_ns / current_ns);
+
+    return differences == 0 ? 0 : 1;
+}
@@ -2,6 +2,7 @@
 
 #include "re/error.h"
 #include <filesystem>
+#include <re/build/build_watcher.h>
 #include <re/build/default_build_context.h>
 #include <re/build/ninja_gen.h>
 
@@ -131,6 +132,9 @@ int main(int argc, const char **argv)
 
         std::unordered_map<std::string, std::string> target_cfg_overrides;
 
+        // Kept around for contexts created after the command line is parsed, like the ones 're watch' reloads
+        std::vector<std::pair<std::string, std::string>> cli_vars;
+
         // TODO: Add error handling to variable parsing
         for (auto it = args.begin(); it != args.end();)
         {
@@ -159,6 +163,7 @@ int main(int argc, const char **argv)
                 auto &value = *(it + 1);
 
                 context.SetVar(key.data(), value.data());
+                cli_vars.emplace_back(key.data(), value.data());
                 it = args.erase(it, it + 2);
             }
             else if (it->find(kDefaultPrefix) == 0)
@@ -169,6 +174,7 @@ int main(int argc, const char **argv)
                 // context.Info({}, "setting var {} to {} ({})\n", key, value, kDefaultPrefix);
 
                 context.SetVar(key.data(), value.data());
+                cli_vars.emplace_back(key.data(), value.data());
 
                 it = args.erase(it, it + 2);
             }
@@ -247,12 +253,13 @@ int main(int argc, const char **argv)
 
             ulib::list<ulib::string> parts = ulib::split(*filter, ".");
 
+            auto env = context.GetBuildEnv();
             auto temp = root;
 
             for (auto &part : parts)
             {
                 if (!part.empty())
-                    temp = temp->FindChild(part);
+                    temp = env->FindOrLoadChild(*temp, part);
 
                 if (!temp)
                     throw re::TargetBuildException(root, "unresolved partial build filter '{}' for '{}'", *filter,
@@ -263,6 +270,9 @@ int main(int argc, const char **argv)
                 throw re::TargetBuildException(root, "unresolved partial dependency filter '{}' for '{}'", *filter,
                                                root->module);
 
+            // The root target might have been loaded lazily: the built target always needs its full subtree
+            env->LoadDeferredSubtree(*temp);
+
             context.Info(fg(fmt::color::blue_violet) | fmt::emphasis::bold,
                          "\n ! Partial build - Processing target '{}'\n\n", temp->module);
 
@@ -284,7 +294,7 @@ int main(int argc, const char **argv)
 
             context.SetVar("building-sources", "true");
 
-            auto &target = context.LoadTarget(path);
+            auto &target = context.LoadTarget(path, partial_build_filter.has_value());
             apply_cfg_overrides(&target);
 
             auto maybe_partial_build = handle_partial_build(&target, partial_build_filter);
@@ -380,7 +390,7 @@ int main(int argc, const char **argv)
 
             context.SetVar("building-sources", "true");
 
-            auto &target = context.LoadTarget(path);
+            auto &target = context.LoadTarget(path, partial_build_filter.has_value());
             apply_cfg_overrides(&target);
 
             auto maybe_partial_build = handle_partial_build(&target, partial_build_filter);
@@ -388,7 +398,7 @@ int main(int argc, const char **argv)
             auto desc = context.GenerateBuildDescForTarget(target, maybe_partial_build);
             auto env = context.GetBuildEnv();
 
-            auto deps = env->GetSingleTargetDepSet(desc.pBuildTarget);
+            auto &deps = desc.closure;
 
             auto action_type = args[2];
 
@@ -671,7 +681,7 @@ int main(int argc, const char **argv)
             context.LoadCachedParams(path);
             context.UpdateOutputSettings();
 
-            auto &target = context.LoadTarget(path);
+            auto &target = context.LoadTarget(path, partial_build_filter.has_value());
             apply_cfg_overrides(&target);
 
             auto maybe_partial_build = handle_partial_build(&target, partial_build_filter);
@@ -684,6 +694,57 @@ int main(int argc, const char **argv)
             auto working_dir = context.GetVar("working-dir").value_or(".");
             return re::RunProcessOrThrow("tool", "", run_args, true, false, working_dir);
         }
+        else if (args[1] == "watch" || args[1] == "w")
+        {
+            init_re_env();
+
+            auto path = context.GetVar(kBuildPathVar).value_or(".");
+
+            auto loader = [&](re::NinjaBuildDesc &desc) {
+                // Every reload starts over with a fresh context, set up just like the one 're build' would use
+                auto watch_context = std::make_unique<re::DefaultBuildContext>();
+
+                watch_context->SetVar("configuration", "release");
+
+                for (auto &[key, value] : cli_vars)
+                    watch_context->SetVar(key, value);
+
+                watch_context->UpdateOutputSettings();
+
+#ifdef WIN32
+                SetupMsvcEnv(*watch_context);
+#endif
+
+                watch_context->LoadDefaultEnvironment(re::GetReDataPath(), re::GetReDynamicDataPath());
+
+                watch_context->LoadCachedParams(path);
+                watch_context->UpdateOutputSettings();
+
+                watch_context->SetVar("building-sources", "true");
+
+                std::optional<std::string> filter = partial_build_filter;
+
+                if (args.size() > 2)
+                    filter = std::string{args[2]};
+
+                auto &target = watch_context->LoadTarget(path, filter.has_value());
+                apply_cfg_overrides(&target);
+
+                auto maybe_partial_build = handle_partial_build(&target, filter);
+
+                desc = watch_context->GenerateBuildDescForTarget(target, maybe_partial_build);
+                return watch_context;
+            };
+
+            re::BuildWatcher watcher{&context, path, loader};
+
+            if (auto delay = context.GetVar("watch-debounce-ms"))
+                watcher.SetDebounceDelay(std::chrono::milliseconds{std::stoul(*delay)});
+
+            watcher.SetCancelObsoleteBuilds(context.GetVar("watch-cancel-builds").value_or("true") == "true");
+
+            return watcher.Run();
+        }
         else if (args[1] == "upgrade")
         {
             init_re_env();
@@ -698,6 +759,9 @@ int main(int argc, const char **argv)
 
             context.SetVar("clean-deps-cache", "true");
 
+            // List every remote again, all at once while the dependencies are fetched
+            context.SetVar("git-tag-index-ttl", "0");
+
             if (re::fs::exists(lock_path))
                 re::fs::remove(lock_path);
 
@@ -715,14 +779,14 @@ int main(int argc, const char **argv)
 
             context.SetVar("building-sources", "true");
 
-            auto root = &context.LoadTarget(path);
-            apply_cfg_overrides(root);
-
             std::size_t partial_paths_offset = 1;
 
             if (args.size() > 1 && (args[1] == "build" || args[1] == "b"))
                 partial_paths_offset++;
 
+            auto root = &context.LoadTarget(path, partial_build_filter || args.size() > partial_paths_offset);
+            apply_cfg_overrides(root);
+
             if (args.size() > partial_paths_offset)
             {
                 if (!context.GetVar("no-meta"))